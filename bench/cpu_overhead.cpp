@@ -0,0 +1,97 @@
+// Reports the CPU time spent per observation on drawing and on the area stage for a growing number of scene objects, at a small render size so
+// the GPU work stays negligible. Needs a Vulkan device. Usage: cpu_overhead [observations]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../src/compute/area.h"
+#include "../src/logger.h"
+#include "../src/render/materials/material_base.h"
+#include "../src/render/render.h"
+#include "room_scene.h"
+
+namespace {
+typedef std::chrono::high_resolution_clock Clock;
+
+/// CPU time of all threads of the process
+double cpu_microseconds(std::clock_t begin, std::clock_t end)
+{
+  return 1.0e6 * static_cast<double>(end - begin) / CLOCKS_PER_SEC;
+}
+
+double microseconds(Clock::duration d)
+{
+  return std::chrono::duration<double, std::micro>(d).count();
+}
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+  auto logger = quavis::UseLogger::create_logger();
+  logger->set_level(spdlog::level::warn);
+
+  const size_t n_observations = argc > 1 ? std::stoul(argv[1]) : 500;
+  const auto eyes             = bench::room_eyes();
+
+  std::printf("%8s %14s %14s %14s\n", "objects", "draw cpu us", "area cpu us", "wall us");
+  for (int n = 1; n <= 16384; n *= 8) {
+    quavis::Render render(glm::ivec2(64, 64));
+    render.set_target_layout(quavis::TargetLayout::DISTANCE);
+
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    bench::room_mesh(positions, indices);
+    std::vector<float> vertex_data(positions.size() / 3 * 4, 1.0f);
+    auto room = std::make_shared<quavis::DrawableGeometry>(std::move(positions), std::move(vertex_data), std::move(indices));
+    render.add_static_scene_object(std::make_shared<quavis::SceneObject>(room, std::make_shared<quavis::MaterialBase>()));
+
+    // small boxes on a grid filling the room, each one a scene object of its own
+    const auto material = std::make_shared<quavis::MaterialBase>();
+    const int side      = static_cast<int>(std::ceil(std::cbrt(static_cast<double>(n))));
+    const glm::vec3 step((bench::room_max - bench::room_min) / static_cast<float>(side + 1));
+    for (int i = 0; i < n; i++) {
+      const glm::vec3 cell(static_cast<float>(i % side + 1), static_cast<float>(i / side % side + 1), static_cast<float>(i / side / side + 1));
+      const auto model = glm::scale(glm::translate(glm::mat4(1), bench::room_min + cell * step), glm::vec3(0.05f));
+      render.add_static_scene_object(std::make_shared<quavis::SceneObject>(quavis::DrawableGeometry::create_unit_cube(), material, model));
+    }
+
+    std::vector<quavis::Observation> observations;
+    for (size_t i = 0; i < n_observations; i++) {
+      observations.push_back(quavis::Observation{glm::vec3(eyes[i % eyes.size()]), glm::vec3(1.0f, 0.0f, 0.0f), 180.0f, {}, {}, {}});
+    }
+    render.add_observations(std::move(observations));
+
+    quavis::ComputeArea area(render.get_device(), render.get_render_size(), render.get_shader_defines());
+
+    // the first draw creates the pipelines and uploads the scene, the first computations record their commands
+    for (size_t i = 0; i < 2; i++) {
+      auto image = render.draw(i);
+      area.compute(image, image);
+    }
+
+    double draw_time = 0.0, area_time = 0.0;
+    const auto start = Clock::now();
+    for (size_t i = 0; i < n_observations; i++) {
+      const auto c0 = std::clock();
+      auto image    = render.draw(i);
+      const auto c1 = std::clock();
+      area.compute(image, image);
+      const auto c2 = std::clock();
+
+      draw_time += cpu_microseconds(c0, c1);
+      area_time += cpu_microseconds(c1, c2);
+    }
+    const double wall_time = microseconds(Clock::now() - start);
+
+    std::printf("%8d %14.1f %14.1f %14.1f\n", n, draw_time / n_observations, area_time / n_observations, wall_time / n_observations);
+  }
+
+  return 0;
+}
@@ -0,0 +1,133 @@
+// Compares the accuracy of the area and volume computations of the cube map and the octahedral projection against their texel count. The scene
+// is a box shaped room with a window, for which area and volume are known exactly (see room_scene.h). Directions and weights are the ones used by
+// the renderer and the compute shaders (see src/compute/area.cpp and src/render/materials/material_base.cpp). The errors are the mean absolute
+// relative errors over several observation points.
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "room_scene.h"
+
+namespace {
+
+struct Estimate {
+  glm::dvec3 eye;
+  double area   = 0.0;
+  double volume = 0.0;
+
+  void add(const glm::dvec3 &direction, double weight)
+  {
+    const double r = bench::cast(eye, glm::normalize(direction));
+    area += r > 0.0 ? weight : 0.0;
+    volume += r * r * r * weight / 3.0;
+  }
+};
+
+/// exact solid angle of the triangle a, a + e1, a + e2 seen from the origin
+double triangle_solid_angle(const glm::dvec3 &a, const glm::dvec3 &e1, const glm::dvec3 &e2)
+{
+  const glm::dvec3 b = a + e1;
+  const glm::dvec3 c = a + e2;
+  const double la    = glm::length(a);
+  const double lb    = glm::length(b);
+  const double lc    = glm::length(c);
+  return 2.0 * std::atan2(std::abs(glm::dot(a, glm::cross(e1, e2))), la * lb * lc + glm::dot(a, b) * lc + glm::dot(a, c) * lb + glm::dot(b, c) * la);
+}
+
+/// cube faces as rendered (+x, -x, +y, -y, +z, -z), texture coordinates grow along right and down
+Estimate estimate_cube(const glm::dvec3 &eye, int n)
+{
+  const glm::dvec3 forward[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+  const glm::dvec3 right[6]   = {{0, 1, 0}, {0, -1, 0}, {-1, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, 1, 0}};
+  const glm::dvec3 down[6]    = {{0, 0, -1}, {0, 0, -1}, {0, 0, -1}, {0, 0, -1}, {1, 0, 0}, {-1, 0, 0}};
+
+  Estimate e;
+  e.eye = eye;
+  for (int f = 0; f < 6; f++) {
+    for (int j = 0; j < n; j++) {
+      for (int i = 0; i < n; i++) {
+        // rasterized at the texel center, weighted with the exact solid angle of the texel as in the compute shaders
+        const double u = 2.0 * (i + 0.5) / n - 1.0;
+        const double v = 2.0 * (j + 0.5) / n - 1.0;
+
+        const glm::dvec3 a(2.0 * i / n - 1.0, 2.0 * j / n - 1.0, 1.0);
+        const glm::dvec3 du(2.0 / n, 0.0, 0.0);
+        const glm::dvec3 dv(0.0, 2.0 / n, 0.0);
+        const double weight = triangle_solid_angle(a, du, du + dv) + triangle_solid_angle(a, du + dv, dv);
+        e.add(forward[f] + u * right[f] + v * down[f], weight);
+      }
+    }
+  }
+  return e;
+}
+
+/// point on the octahedron at the octahedral map coordinates (u, v)
+glm::dvec3 octahedron_point(double u, double v)
+{
+  glm::dvec3 p(u, v, 1.0 - std::abs(u) - std::abs(v));
+  if (p.z < 0.0) {
+    // lower hemisphere, folded into the corners
+    p = glm::dvec3(std::copysign(1.0 - std::abs(v), u), std::copysign(1.0 - std::abs(u), v), p.z);
+  }
+  return p;
+}
+
+Estimate estimate_octahedral(const glm::dvec3 &eye, int n)
+{
+  Estimate e;
+  e.eye = eye;
+  for (int j = 0; j < n; j++) {
+    for (int i = 0; i < n; i++) {
+      const double u0 = 2.0 * i / n - 1.0;
+      const double v0 = 2.0 * j / n - 1.0;
+      const double u1 = u0 + 2.0 / n;
+      const double v1 = v0 + 2.0 / n;
+
+      // the texel split along the diagonal parallel to the folding edge of its quadrant
+      const auto p00 = octahedron_point(u0, v0);
+      const auto p10 = octahedron_point(u1, v0);
+      const auto p01 = octahedron_point(u0, v1);
+      const auto p11 = octahedron_point(u1, v1);
+      const double weight = (u0 + u1 > 0.0) == (v0 + v1 > 0.0)
+                              ? triangle_solid_angle(p10, p01 - p10, p00 - p10) + triangle_solid_angle(p10, p11 - p10, p01 - p10)
+                              : triangle_solid_angle(p00, p10 - p00, p11 - p00) + triangle_solid_angle(p00, p11 - p00, p01 - p00);
+
+      e.add(octahedron_point(0.5 * (u0 + u1), 0.5 * (v0 + v1)), weight);
+    }
+  }
+  return e;
+}
+
+/// prints the mean absolute relative errors of estimate over the observation points
+template <class F>
+void print_errors(const char *name, int n, int texels, const std::vector<glm::dvec3> &eyes, F estimate)
+{
+  double area_error   = 0.0;
+  double volume_error = 0.0;
+  for (const auto &eye : eyes) {
+    const auto e = estimate(eye, n);
+    area_error += std::abs(e.area - bench::exact_area(eye)) / bench::exact_area(eye) / eyes.size();
+    volume_error += std::abs(e.volume - bench::exact_volume(eye)) / bench::exact_volume(eye) / eyes.size();
+  }
+  std::printf("%-11s %6d %9d %11.4f%% %11.4f%%\n", name, n, texels, 100.0 * area_error, 100.0 * volume_error);
+}
+
+}  // namespace
+
+int main()
+{
+  const auto eyes = bench::room_eyes();
+
+  std::printf("%-11s %6s %9s %12s %12s\n", "projection", "size", "texels", "area error", "volume error");
+  for (int n = 16; n <= 1024; n *= 2) {
+    print_errors("cube", n, 6 * n * n, eyes, estimate_cube);
+  }
+  for (int n = 32; n <= 2048; n *= 2) {
+    print_errors("octahedral", n, n * n, eyes, estimate_octahedral);
+  }
+
+  return 0;
+}
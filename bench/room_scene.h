@@ -0,0 +1,163 @@
+// The analytic scene of the benchmarks: a box shaped room with a window, for which the area (solid angle) and the volume seen from an observation
+// point inside are known exactly, and the sky luminance seen through the window to the precision of a fine quadrature.
+
+#ifndef QUAVIS_BENCH_ROOM_SCENE
+#define QUAVIS_BENCH_ROOM_SCENE
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+namespace bench {
+
+/// the room, the window is an opening in the wall x = room_max.x
+const glm::vec3 room_min(-2.0f, -1.5f, -1.2f);
+const glm::vec3 room_max(3.0f, 2.5f, 1.6f);
+const glm::vec2 window_min(-0.5f, -0.2f);  // y, z
+const glm::vec2 window_max(1.0f, 0.9f);
+
+/// vertices of the wall with the window at the end of room_mesh
+const uint32_t window_wall_vertices = 16;
+
+/// observation points inside the room
+inline std::vector<glm::dvec3> room_eyes()
+{
+  return {{0.0, 0.0, 0.0}, {0.37, -0.21, 0.13}, {-1.1, 1.3, -0.4}, {2.2, 0.6, 0.5}, {-0.7, -0.9, 1.1}};
+}
+
+/// distance to the room from eye along the unit direction d, 0 if the ray leaves through the window
+inline double cast(const glm::dvec3 &eye, const glm::dvec3 &d)
+{
+  double t = 1e30;
+  int axis = 0;
+  for (int a = 0; a < 3; a++) {
+    if (d[a] == 0.0) continue;
+    const double ta = ((d[a] > 0.0 ? room_max[a] : room_min[a]) - eye[a]) / d[a];
+    if (ta < t) {
+      t    = ta;
+      axis = a;
+    }
+  }
+
+  const glm::dvec3 p = eye + d * t;
+  if (axis == 0 && d.x > 0.0 && p.y > window_min.x && p.y < window_max.x && p.z > window_min.y && p.z < window_max.y) return 0.0;
+  return t;
+}
+
+/// exact solid angle of the rectangle from r0 to r1 (y, z) on the wall x = room_max.x seen from eye
+inline double wall_solid_angle(const glm::dvec3 &eye, const glm::dvec2 &r0, const glm::dvec2 &r1)
+{
+  const double h = room_max.x - eye.x;
+  auto corner    = [h](double a, double b) { return std::atan(a * b / (h * std::sqrt(a * a + b * b + h * h))); };
+
+  const glm::dvec2 w0 = r0 - glm::dvec2(eye.y, eye.z);
+  const glm::dvec2 w1 = r1 - glm::dvec2(eye.y, eye.z);
+  return corner(w1.x, w1.y) - corner(w0.x, w1.y) - corner(w1.x, w0.y) + corner(w0.x, w0.y);
+}
+
+/// exact solid angle of the walls seen from eye
+inline double exact_area(const glm::dvec3 &eye)
+{
+  return 4.0 * glm::pi<double>() - wall_solid_angle(eye, glm::dvec2(window_min), glm::dvec2(window_max));
+}
+
+/// exact solid angle of the wall with the window seen from eye, without the window
+inline double exact_window_wall_area(const glm::dvec3 &eye)
+{
+  return wall_solid_angle(eye, glm::dvec2(room_min.y, room_min.z), glm::dvec2(room_max.y, room_max.z)) -
+         wall_solid_angle(eye, glm::dvec2(window_min), glm::dvec2(window_max));
+}
+
+/// luminance of the CIE clear sky in the direction d (x east, z up), 0 below the horizon. The constants and the formula of the sun stages
+inline double sky_luminance(const glm::dvec3 &d, double sun_azimuth, double sun_altitude, double zenith_luminance)
+{
+  const double pi       = glm::pi<double>();
+  const double altitude = std::asin(d.z / glm::length(d));
+  if (altitude <= 0.0) return 0.0;
+
+  const double z    = pi / 2.0 - altitude;
+  const double z_s  = pi / 2.0 - sun_altitude;
+  const double phi0 = 1.0 - std::exp(-0.25);
+  const double fzs  = 1.0 + 16.0 * (std::exp(-3.0 * z_s) - std::exp(-3.0 * pi / 2.0)) + 0.3 * std::pow(std::cos(z_s), 2.0);
+
+  const double cos_chi = std::cos(z_s) * std::cos(z) + std::sin(z_s) * std::sin(z) * std::cos(std::abs(std::atan2(d.y, d.x) - sun_azimuth));
+  const double chi     = std::acos(std::max(-1.0, std::min(1.0, cos_chi)));
+  const double fchi    = 1.0 + 16.0 * (std::exp(-3.0 * chi) - std::exp(-3.0 * pi / 2.0)) + 0.3 * std::pow(std::cos(chi), 2.0);
+  const double phiz    = 1.0 - std::exp(-0.25 / z);
+  return std::max(0.0, fchi * phiz / (fzs * phi0) * zenith_luminance);
+}
+
+/// sky luminance seen from eye through the window, integrated over the solid angle of the window above the horizon (midpoint rule with
+/// steps x steps points, the window is split at the height of the eye)
+inline double exact_sky(const glm::dvec3 &eye, double sun_azimuth, double sun_altitude, double zenith_luminance, int steps = 1024)
+{
+  const double h       = room_max.x - eye.x;
+  const glm::dvec2 w0  = glm::dvec2(window_min) - glm::dvec2(eye.y, eye.z);
+  const glm::dvec2 w1  = glm::dvec2(window_max) - glm::dvec2(eye.y, eye.z);
+  const double z0      = std::max(w0.y, 0.0);
+  if (w1.y <= z0) return 0.0;
+
+  const double dy = (w1.x - w0.x) / steps;
+  const double dz = (w1.y - z0) / steps;
+  double sum      = 0.0;
+  for (int j = 0; j < steps; j++) {
+    for (int i = 0; i < steps; i++) {
+      const glm::dvec3 d(h, w0.x + (i + 0.5) * dy, z0 + (j + 0.5) * dz);
+      const double r = glm::length(d);
+      sum += sky_luminance(d, sun_azimuth, sun_altitude, zenith_luminance) * h / (r * r * r) * dy * dz;
+    }
+  }
+  return sum;
+}
+
+/// exact volume enclosed by the walls and the window seen from eye (the window closes the volume with the pyramid to the eye cut off)
+inline double exact_volume(const glm::dvec3 &eye)
+{
+  const double h = room_max.x - eye.x;
+
+  const glm::dvec2 w0 = glm::dvec2(window_min) - glm::dvec2(eye.y, eye.z);
+  const glm::dvec2 w1 = glm::dvec2(window_max) - glm::dvec2(eye.y, eye.z);
+  const glm::dvec3 size(room_max - room_min);
+  return size.x * size.y * size.z - (w1.x - w0.x) * (w1.y - w0.y) * h / 3.0;
+}
+
+/// triangles of the walls (flat x, y, z positions), the wall x = room_max.x is split into 4 rectangles around the window, which are the last
+/// window_wall_vertices vertices
+inline void room_mesh(std::vector<float> &positions, std::vector<uint32_t> &indices)
+{
+  auto add_rectangle = [&](const glm::vec3 &corner, const glm::vec3 &a, const glm::vec3 &b) {
+    const auto first = static_cast<uint32_t>(positions.size() / 3);
+    for (const auto &p : {corner, corner + a, corner + a + b, corner + b}) {
+      positions.insert(positions.end(), {p.x, p.y, p.z});
+    }
+    indices.insert(indices.end(), {first, first + 1, first + 2, first, first + 2, first + 3});
+  };
+
+  const glm::vec3 size = room_max - room_min;
+  const glm::vec3 dx(size.x, 0.0f, 0.0f);
+  const glm::vec3 dy(0.0f, size.y, 0.0f);
+  const glm::vec3 dz(0.0f, 0.0f, size.z);
+
+  add_rectangle(room_min, dy, dz);
+  add_rectangle(room_min, dx, dz);
+  add_rectangle(room_min + dy, dx, dz);
+  add_rectangle(room_min, dx, dy);
+  add_rectangle(room_min + dz, dx, dy);
+
+  // window wall
+  const float x = room_max.x;
+  add_rectangle(glm::vec3(x, room_min.y, room_min.z), glm::vec3(0.0f, window_min.x - room_min.y, 0.0f), dz);
+  add_rectangle(glm::vec3(x, window_max.x, room_min.z), glm::vec3(0.0f, room_max.y - window_max.x, 0.0f), dz);
+  add_rectangle(glm::vec3(x, window_min.x, room_min.z), glm::vec3(0.0f, window_max.x - window_min.x, 0.0f),
+                glm::vec3(0.0f, 0.0f, window_min.y - room_min.z));
+  add_rectangle(glm::vec3(x, window_min.x, window_max.y), glm::vec3(0.0f, window_max.x - window_min.x, 0.0f),
+                glm::vec3(0.0f, 0.0f, room_max.z - window_max.y));
+}
+}  // namespace bench
+
+#endif
@@ -0,0 +1,90 @@
+// Compares the sky matrix product of SkyMatrix::integrate on one thread and on all cores with a plain triple loop, for random visible sky patches
+// and a year of hourly skies. CPU only. Usage: sky_matrix [observations] [timesteps]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/compute/sky_matrix.h"
+
+namespace {
+typedef std::chrono::high_resolution_clock Clock;
+
+double seconds(Clock::duration d)
+{
+  return std::chrono::duration<double>(d).count();
+}
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+  const size_t observations = argc > 1 ? std::stoul(argv[1]) : 2000;
+  const size_t timesteps    = argc > 2 ? std::stoul(argv[2]) : 8760;
+  const size_t patches      = quavis::SkyMatrix::PATCHES;
+
+  std::mt19937 random(42);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::vector<float> azimuths, altitudes, zenith_luminances;
+  for (size_t t = 0; t < timesteps; t++) {
+    azimuths.push_back(unit(random) * 6.2831853f);
+    altitudes.push_back((unit(random) - 0.3f) * 1.5f);
+    zenith_luminances.push_back(1000.0f + 9000.0f * unit(random));
+  }
+  std::vector<float> visibility(observations * patches);
+  for (auto &v : visibility) v = 0.05f * unit(random);
+
+  auto begin = Clock::now();
+  const quavis::SkyMatrix sky_matrix(azimuths, altitudes, zenith_luminances);
+  const double setup = seconds(Clock::now() - begin);
+
+  begin                 = Clock::now();
+  const auto luminances = sky_matrix.integrate(visibility, 1);
+  const double single   = seconds(Clock::now() - begin);
+
+  const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  begin                = Clock::now();
+  sky_matrix.integrate(visibility, threads);
+  const double parallel = seconds(Clock::now() - begin);
+
+  // the luminance per patch is the product with the visible sky of a single patch
+  std::vector<float> matrix(patches * timesteps);
+  for (size_t p = 0; p < patches; p++) {
+    std::vector<float> unit_patch(patches, 0.0f);
+    unit_patch[p]  = 1.0f;
+    const auto row = sky_matrix.integrate(unit_patch);
+    std::copy(row.begin(), row.end(), matrix.begin() + p * timesteps);
+  }
+
+  begin = Clock::now();
+  std::vector<float> reference(observations * timesteps, 0.0f);
+  for (size_t i = 0; i < observations; i++) {
+    for (size_t t = 0; t < timesteps; t++) {
+      float sum = 0.0f;
+      for (size_t p = 0; p < patches; p++) {
+        sum += visibility[i * patches + p] * matrix[p * timesteps + t];
+      }
+      reference[i * timesteps + t] = sum;
+    }
+  }
+  const double naive = seconds(Clock::now() - begin);
+
+  double error = 0.0;
+  for (size_t k = 0; k < reference.size(); k++) {
+    error = std::max(error, std::abs(static_cast<double>(luminances[k] - reference[k])) / (std::abs(reference[k]) + 1.0e-3));
+  }
+
+  const double flops = 2.0 * static_cast<double>(observations * timesteps * patches);
+  std::printf("%zu observations x %zu patches x %zu time steps, sky matrix %.3f s\n", observations, patches, timesteps, setup);
+  std::printf("%-24s %10s %10s\n", "", "seconds", "GFLOPS");
+  std::printf("%-24s %10.3f %10.2f\n", "naive, 1 thread", naive, flops / naive * 1.0e-9);
+  std::printf("%-24s %10.3f %10.2f\n", "integrate, 1 thread", single, flops / single * 1.0e-9);
+  const std::string label = "integrate, " + std::to_string(threads) + " threads";
+  std::printf("%-24s %10.3f %10.2f\n", label.c_str(), parallel, flops / parallel * 1.0e-9);
+  std::printf("largest relative difference %.2e\n", error);
+  return 0;
+}
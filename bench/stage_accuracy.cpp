@@ -0,0 +1,135 @@
+// Sweeps the render size and reports the error and the time per observation of the GPU area, volume, groups and sun stages on the analytic
+// room scene (see room_scene.h). The groups and sun stages need the cube projection. Needs a Vulkan device.
+// Usage: stage_accuracy [cube|octahedral] [samples]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "../src/compute/area.h"
+#include "../src/compute/groups.h"
+#include "../src/compute/sun.h"
+#include "../src/compute/volume.h"
+#include "../src/logger.h"
+#include "../src/render/materials/material_base.h"
+#include "../src/render/render.h"
+#include "room_scene.h"
+
+namespace {
+typedef std::chrono::high_resolution_clock Clock;
+
+double milliseconds(Clock::duration d)
+{
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+// the sun in front of the window (radians) and the zenith luminance
+const float sun_azimuth      = 0.3f;
+const float sun_altitude     = 0.5f;
+const float zenith_luminance = 1000.0f;
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+  auto logger = quavis::UseLogger::create_logger();
+  logger->set_level(spdlog::level::warn);
+
+  const auto projection  = argc > 1 && std::string(argv[1]) == "octahedral" ? quavis::Projection::OCTAHEDRAL : quavis::Projection::CUBE;
+  const uint32_t samples = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 1;
+  const auto eyes        = bench::room_eyes();
+  const bool cube        = projection == quavis::Projection::CUBE;
+
+  std::vector<double> exact_sky;
+  for (const auto &eye : eyes) {
+    exact_sky.push_back(bench::exact_sky(eye, sun_azimuth, sun_altitude, zenith_luminance));
+  }
+
+  std::printf("%6s %10s %12s %10s %12s %10s %12s %10s %12s %10s\n", "size", "render ms", "area error", "area ms", "volume error", "volume ms",
+              "groups error", "groups ms", "sun error", "sun ms");
+  for (int n = 32; n <= 1024; n *= 2) {
+    quavis::Render render(glm::ivec2(n, n), 0, projection);
+    render.set_samples(samples);
+    render.set_target_layout(cube ? quavis::TargetLayout::RED_DISTANCE : quavis::TargetLayout::DISTANCE);
+
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    bench::room_mesh(positions, indices);
+    // group 1 are the walls without the window, group 2 is the wall with the window (the red channel of the vertex data)
+    std::vector<float> vertex_data(positions.size() / 3 * 4, 1.0f);
+    for (size_t i = vertex_data.size() - 4 * bench::window_wall_vertices; i < vertex_data.size(); i += 4) {
+      vertex_data[i] = 2.0f;
+    }
+    auto geometry = std::make_shared<quavis::DrawableGeometry>(std::move(positions), std::move(vertex_data), std::move(indices));
+    render.add_static_scene_object(std::make_shared<quavis::SceneObject>(geometry, std::make_shared<quavis::MaterialBase>()));
+
+    std::vector<quavis::Observation> observations;
+    for (const auto &eye : eyes) {
+      observations.push_back(quavis::Observation{glm::vec3(eye), glm::vec3(1.0f, 0.0f, 0.0f), 180.0f, {}, {}, {}});
+    }
+    render.add_observations(std::move(observations));
+
+    quavis::ComputeArea area(render.get_device(), render.get_render_size(), render.get_shader_defines());
+    quavis::ComputeVolume volume(render.get_device(), render.get_render_size(), render.get_shader_defines());
+    std::unique_ptr<quavis::ComputeGroups> groups;
+    std::unique_ptr<quavis::ComputeSun> sun;
+    if (cube) {
+      groups.reset(new quavis::ComputeGroups(render.get_device(), render.get_render_size(), render.get_shader_defines()));
+      sun.reset(new quavis::ComputeSun(render.get_device(), render.get_render_size(), false, render.get_shader_defines()));
+    }
+    const glm::ivec2 size = render.get_render_size();
+
+    // the first draw creates the pipelines and uploads the scene
+    render.draw(0);
+
+    double render_time = 0.0, area_time = 0.0, volume_time = 0.0, groups_time = 0.0, sun_time = 0.0;
+    double area_error = 0.0, volume_error = 0.0, groups_error = 0.0, sun_deviation = 0.0, sun_total = 0.0;
+    for (size_t i = 0; i < eyes.size(); i++) {
+      const auto t0 = Clock::now();
+      auto image    = render.draw(i);
+      const auto t1 = Clock::now();
+      const auto a  = area.compute(image, image)->values[0];
+      const auto t2 = Clock::now();
+      const auto v  = volume.compute(image, image)->values[0];
+      const auto t3 = Clock::now();
+
+      render_time += milliseconds(t1 - t0) / eyes.size();
+      area_time += milliseconds(t2 - t1) / eyes.size();
+      volume_time += milliseconds(t3 - t2) / eyes.size();
+      area_error += std::abs(a - bench::exact_area(eyes[i])) / bench::exact_area(eyes[i]) / eyes.size();
+      volume_error += std::abs(v - bench::exact_volume(eyes[i])) / bench::exact_volume(eyes[i]) / eyes.size();
+      if (!cube) continue;
+
+      const quavis::ComputeGroupsParams groups_par = {size.x, size.y, 360.0f, 1.0f, 0.0f, 0.0f, render.get_face_mask(i)};
+      const auto t4 = Clock::now();
+      const auto g  = groups->compute(groups_par, image, image)->values;
+      const auto t5 = Clock::now();
+      const quavis::ComputeSunParams sun_par = {size.x, size.y, sun_azimuth, sun_altitude, zenith_luminance};
+      const auto s  = sun->compute(sun_par, image, image)->values[0];
+      const auto t6 = Clock::now();
+
+      // the mean error of both groups
+      const double window_wall = bench::exact_window_wall_area(eyes[i]);
+      const double walls       = bench::exact_area(eyes[i]) - window_wall;
+      groups_time += milliseconds(t5 - t4) / eyes.size();
+      sun_time += milliseconds(t6 - t5) / eyes.size();
+      groups_error += (std::abs(g[1] - walls) / walls + std::abs(g[2] - window_wall) / window_wall) / 2.0 / eyes.size();
+      // the eyes above the window see no sky, the error of the sun stage is relative to the sum over all eyes
+      sun_deviation += std::abs(s - exact_sky[i]);
+      sun_total += exact_sky[i];
+    }
+
+    std::printf("%6d %10.3f %11.4f%% %10.3f %11.4f%% %10.3f", n, render_time, 100.0 * area_error, area_time, 100.0 * volume_error, volume_time);
+    if (cube) {
+      std::printf(" %11.4f%% %10.3f %11.4f%% %10.3f\n", 100.0 * groups_error, groups_time, 100.0 * sun_deviation / sun_total, sun_time);
+    } else {
+      std::printf(" %12s %10s %12s %10s\n", "-", "-", "-", "-");
+    }
+  }
+
+  return 0;
+}
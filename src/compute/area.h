@@ -12,12 +12,13 @@ struct ComputeAreaParams {
 
 class ComputeArea : public ComputeBaseGPU<ComputeAreaParams> {
  public:
-  ComputeArea(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2& image_dim);
+  ComputeArea(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2& image_dim, const std::vector<std::string>& defines = {});
 
   virtual const ComputeAreaParams get_parameter() override;
+  virtual void set_resolution(const glm::ivec2& resolution) override { image_dim_ = resolution; }
 
  private:
-  const glm::ivec2 image_dim_;
+  glm::ivec2 image_dim_;
 
   std::vector<ComputeShaderStage> create_compute_stages(const glm::ivec2& image_dim);
 };
@@ -1,6 +1,8 @@
 #define NOMINMAX
 #include "compute_base.h"
+#include "../render/device_queues.h"
 #include "../utils/shader_loader.h"
+#include <algorithm>
 #include <iostream>
 
 using namespace quavis;
@@ -8,9 +10,13 @@ using namespace quavis;
 ComputeBaseGPUImpl::ComputeBaseGPUImpl(std::weak_ptr<Anvil::SGPUDevice> device_ptr)
   : device_ptr_{device_ptr}
 {
+  const auto queues = get_device_queues(device_ptr_.lock());
+  queue_            = queues.compute;
+  command_pool_     = queues.compute_pool;
 }
 
-void ComputeBaseGPUImpl::create_pipelines(const std::vector<ComputeShaderStage> &stages, uint32_t parameter_size)
+void ComputeBaseGPUImpl::create_pipelines(const std::vector<ComputeShaderStage> &stages, uint32_t parameter_size,
+                                          const std::vector<std::string> &defines)
 {
   auto device{device_ptr_.lock()};
 
@@ -19,7 +25,7 @@ void ComputeBaseGPUImpl::create_pipelines(const std::vector<ComputeShaderStage>
   for (const auto &stage : stages) {
     PipelineStage pipeline;
 
-    pipeline.shader = ShaderLoader::create_shader_entry(device_ptr_, stage.shader_code, Anvil::ShaderStage::SHADER_STAGE_COMPUTE);
+    pipeline.shader = ShaderLoader::create_shader_entry(device_ptr_, stage.shader_code, Anvil::ShaderStage::SHADER_STAGE_COMPUTE, defines);
 
     pipeline_manager->add_regular_pipeline(false, false, *pipeline.shader, &pipeline.pipelineId);
 
@@ -61,16 +67,77 @@ std::shared_ptr<ComputeResult> ComputeBaseGPUImpl::compute_all_stages(const std:
     return result;
   }
 
+  // do we need to download something?
+  if (stages.front().input_buffer_size > 0) {
+    // TODO
+    assert(!"not implemented yet");
+  }
+
+  // the commands recorded for the target are submitted again as long as they are the same, only new parameters or layouts record them again
+  auto &recording        = get_recording(render_result);
+  const auto *parameters = static_cast<const uint8_t *>(parameter_data);
+  if (recording.layout_before == render_result->get_image_layout() && recording.parameters.size() == parameter_size &&
+      std::equal(parameters, parameters + parameter_size, recording.parameters.begin())) {
+    render_result->set_image_layout(recording.layout_after);
+  } else {
+    record_stages(stages, recording, render_result, parameter_data, parameter_size);
+  }
+
+  // submit compute
+  render_result->submit_after_writes(queue_, recording.command_buffer);
+
+  // retrieve whatever we need
+  for (size_t i = 0; i < stages.size(); i++) {
+    const auto &stage    = stages[i];
+    const auto &pipeline = pipelines_[i];
+
+    if (stage.retrieve_output_buffer_size) {
+      // output is casted to ComputeResult.values
+      assert(stage.retrieve_output_buffer_size % sizeof(result->values.front()) == 0);
+
+      auto size    = stage.retrieve_output_buffer_size / sizeof(result->values.front());
+      auto oldSize = result->values.size();
+      auto newSize = oldSize + size;
+      result->values.resize(newSize);
+
+      pipeline.output_buffer->read(0, stage.retrieve_output_buffer_size, &result->values[oldSize]);
+    }
+  }
+
+  return result;
+}
+
+ComputeBaseGPUImpl::Recording &ComputeBaseGPUImpl::get_recording(const std::shared_ptr<CubeImages> &render_result)
+{
+  // recordings of released targets are dropped, so a new target at the same address gets a new one
+  for (auto it = recordings_.begin(); it != recordings_.end();) {
+    it = it->second.target.expired() ? recordings_.erase(it) : std::next(it);
+  }
+
+  auto &recording = recordings_[render_result.get()];
+  if (recording.command_buffer == nullptr) {
+    recording.target         = render_result;
+    recording.command_buffer = command_pool_->alloc_primary_level_command_buffer();
+    for (const auto &pipeline : pipelines_) {
+      recording.descriptor_groups.push_back(Anvil::DescriptorSetGroup::create(pipeline.descriptor_group, false /* releaseable_sets */));
+    }
+  }
+  return recording;
+}
+
+void ComputeBaseGPUImpl::record_stages(const std::vector<ComputeShaderStage> &stages, Recording &recording,
+                                       std::shared_ptr<CubeImages> render_result, const void *parameter_data, uint32_t parameter_size)
+{
   auto device{device_ptr_.lock()};
   auto pipeline_manager{device->get_compute_pipeline_manager()};
-  auto command_pool{device->get_command_pool(Anvil::QUEUE_FAMILY_TYPE_UNIVERSAL)};
-  auto queue = device->get_universal_queue(0);
+  auto command_buffer = recording.command_buffer;
 
-  auto command_buffer{command_pool->alloc_primary_level_command_buffer()};
+  recording.layout_before = render_result->get_image_layout();
+  recording.parameters.assign(static_cast<const uint8_t *>(parameter_data), static_cast<const uint8_t *>(parameter_data) + parameter_size);
 
-  command_buffer->start_recording(true, false);
+  command_buffer->start_recording(false, false);
 
-  auto colorImage = render_result->get_storage_image_view(command_buffer, queue);
+  auto colorImage = render_result->get_storage_image_view(command_buffer, queue_);
 
   auto colorBinding = Anvil::DescriptorSet::StorageImageBindingElement(VK_IMAGE_LAYOUT_GENERAL, colorImage);
 
@@ -79,18 +146,13 @@ std::shared_ptr<ComputeResult> ComputeBaseGPUImpl::compute_all_stages(const std:
   // 	auto depthLayout = depth->get_image_layout();
   // 	auto depthBinding = Anvil::DescriptorSet::StorageImageBindingElement(colorLayout, depthImage);
 
-  // do we need to download something?
-  if (stages.front().input_buffer_size > 0) {
-    // TODO
-    assert(!"not implemented yet");
-  }
-
   for (size_t i = 0; i < stages.size(); i++) {
     const auto &stage    = stages[i];
     const auto &pipeline = pipelines_[i];
     auto pipeline_layout = pipeline_manager->get_compute_pipeline_layout(pipeline.pipelineId);
 
-    auto bindings = pipeline.descriptor_group->get_descriptor_set(0);
+    // the sets of the recording only change when the target gets a new view
+    auto bindings = recording.descriptor_groups[i]->get_descriptor_set(0);
 
     if (stage.input_color_cube) {
       bindings->set_binding_item(0, colorBinding);
@@ -115,36 +177,15 @@ std::shared_ptr<ComputeResult> ComputeBaseGPUImpl::compute_all_stages(const std:
     command_buffer->record_bind_descriptor_sets(VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1, &bindings, 0, nullptr);
 
     command_buffer->record_dispatch(stage.work_group_size.x, stage.work_group_size.y, stage.work_group_size.z);
-    auto outputBufferBarrier = Anvil::BufferBarrier(VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, queue->get_queue_family_index(),
-                                                    queue->get_queue_family_index(), pipeline.output_buffer, 0, stage.output_buffer_size);
+    auto outputBufferBarrier = Anvil::BufferBarrier(VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, queue_->get_queue_family_index(),
+                                                    queue_->get_queue_family_index(), pipeline.output_buffer, 0, stage.output_buffer_size);
 
     auto dstAccess = VK_ACCESS_SHADER_READ_BIT;
     command_buffer->record_pipeline_barrier(VK_ACCESS_SHADER_WRITE_BIT, dstAccess, false, 0, nullptr, 1, &outputBufferBarrier, 0, nullptr);
   }
 
   command_buffer->stop_recording();
-  // submit compute
-  queue->submit_command_buffer(command_buffer, true);
-
-  // retrieve whatever we need
-  for (size_t i = 0; i < stages.size(); i++) {
-    const auto &stage    = stages[i];
-    const auto &pipeline = pipelines_[i];
-
-    if (stage.retrieve_output_buffer_size) {
-      // output is casted to ComputeResult.values
-      assert(stage.retrieve_output_buffer_size % sizeof(result->values.front()) == 0);
-
-      auto size    = stage.retrieve_output_buffer_size / sizeof(result->values.front());
-      auto oldSize = result->values.size();
-      auto newSize = oldSize + size;
-      result->values.resize(newSize);
-
-      pipeline.output_buffer->read(0, stage.retrieve_output_buffer_size, &result->values[oldSize]);
-    }
-  }
-
-  return result;
+  recording.layout_after = render_result->get_image_layout();
 }
 
 std::shared_ptr<Anvil::Buffer> quavis::ComputeBaseGPUImpl::create_buffer(VkDeviceSize size, bool mapable) const
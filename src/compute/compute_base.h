@@ -1,13 +1,16 @@
 #ifndef QUAVIS_COMPUTE_COMPUTE_BASE
 #define QUAVIS_COMPUTE_COMPUTE_BASE
 
+#include <map>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <glm/glm.hpp>
 
 #include "../render/anvil.h"
 #include "../render/cube_images.h"
+#include "../render/observation.h"
 
 namespace quavis {
 
@@ -20,6 +23,12 @@ struct ComputeResult {
 class ComputeBase {
  public:
   virtual std::shared_ptr<ComputeResult> compute(std::shared_ptr<CubeImages> render_result, std::shared_ptr<CubeImages> depth) = 0;
+
+  /// the directions read by the computation, cube faces outside are neither rendered nor read
+  virtual DirectionDomain get_direction_domain() const { return DirectionDomain::FULL_SPHERE; }
+
+  /// the next computations read only the top left resolution texels of each layer (a render at a lower resolution level)
+  virtual void set_resolution(const glm::ivec2 &resolution) {}
 };
 
 /// description of each stage (compute shader invocation) of a GPU based computation
@@ -31,6 +40,8 @@ struct ComputeShaderStage {
    *  layout (binding = 2) buffer InputBuffer {} inputs;
    *  layout (binding = 3) buffer OutputBuffer {} outputs;
    *  layout(push_constant) uniform Parameters {} parameters;
+   * the layout of colorImage is described by the preprocessor definitions of Render::get_shader_defines, with QUAVIS_SAMPLES it is an
+   * image2DMSArray
    **/
   const char *shader_code;
 
@@ -50,14 +61,30 @@ class ComputeBaseGPUImpl : public ComputeBase {
  protected:
   ComputeBaseGPUImpl(std::weak_ptr<Anvil::SGPUDevice> device_ptr);
 
-  void create_pipelines(const std::vector<ComputeShaderStage> &stages, uint32_t parameter_size);
+  /// compiles the stages with the preprocessor definitions of the render target layout (see Render::get_shader_defines)
+  void create_pipelines(const std::vector<ComputeShaderStage> &stages, uint32_t parameter_size, const std::vector<std::string> &defines);
   void create_buffers(const std::vector<ComputeShaderStage> &stages);
 
   std::shared_ptr<ComputeResult> compute_all_stages(const std::vector<ComputeShaderStage> &shader_stages_, std::shared_ptr<CubeImages> render_result,
                                                     std::shared_ptr<CubeImages> depth, const void *parameter_data, uint32_t parameter_size);
 
  private:
+  /// the commands of all stages reading one render target, recorded once and submitted again while the layout of the target and the parameters
+  /// are the same
+  struct Recording {
+    std::weak_ptr<CubeImages> target;
+    std::shared_ptr<Anvil::PrimaryCommandBuffer> command_buffer;
+    std::vector<std::shared_ptr<Anvil::DescriptorSetGroup>> descriptor_groups;  ///< per stage, sharing the layout of its pipeline
+    std::vector<uint8_t> parameters;
+    VkImageLayout layout_before{VK_IMAGE_LAYOUT_MAX_ENUM};  ///< layout of the target the commands were recorded for
+    VkImageLayout layout_after{VK_IMAGE_LAYOUT_MAX_ENUM};   ///< layout of the target after the commands
+  };
+
   std::shared_ptr<Anvil::Buffer> create_buffer(VkDeviceSize size, bool mapable) const;
+  /// the recording of render_result, created on its first use
+  Recording &get_recording(const std::shared_ptr<CubeImages> &render_result);
+  void record_stages(const std::vector<ComputeShaderStage> &stages, Recording &recording, std::shared_ptr<CubeImages> render_result,
+                     const void *parameter_data, uint32_t parameter_size);
 
   struct PipelineStage {
     std::shared_ptr<Anvil::ShaderModuleStageEntryPoint> shader;
@@ -69,8 +96,11 @@ class ComputeBaseGPUImpl : public ComputeBase {
   };
 
   std::weak_ptr<Anvil::SGPUDevice> device_ptr_;
+  std::shared_ptr<Anvil::Queue> queue_;  ///< the stages run on the compute queue, in parallel to the drawing of the next view where possible
+  std::shared_ptr<Anvil::CommandPool> command_pool_;
 
   std::vector<PipelineStage> pipelines_;
+  std::map<CubeImages *, Recording> recordings_;
 };
 
 /// Base class for all GPU based computations, when deriving specify the parameter struct, and make sure shader_stages_ is initialized in constructor.
@@ -78,11 +108,12 @@ class ComputeBaseGPUImpl : public ComputeBase {
 template <class ComputeShaderParameterStruct>
 class ComputeBaseGPU : public ComputeBaseGPUImpl {
  public:
-  ComputeBaseGPU(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const std::vector<ComputeShaderStage> &&stages)
+  ComputeBaseGPU(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const std::vector<ComputeShaderStage> &&stages,
+                 const std::vector<std::string> &defines = {})
     : ComputeBaseGPUImpl{device_ptr}
     , shader_stages_{std::move(stages)}
   {
-    create_pipelines(shader_stages_, sizeof(ComputeShaderParameterStruct));
+    create_pipelines(shader_stages_, sizeof(ComputeShaderParameterStruct), defines);
     create_buffers(shader_stages_);
   }
 
@@ -0,0 +1,450 @@
+#define NOMINMAX
+#include "direct_sun.h"
+#include "../render/device_queues.h"
+#include "../utils/shader_loader.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace quavis;
+
+namespace {
+const char *shadow_vertex_shader =
+  R"(
+		#version 450
+
+		layout (set = 0, binding = 0) uniform Light {
+			mat4 light_matrix;
+		} light;
+
+		layout(push_constant) uniform ObjProp {
+			mat4 model_mat;
+		} objProp;
+
+		layout (location = 0) in vec3 inPosition;
+
+		void main() {
+			gl_Position = light.light_matrix * objProp.model_mat * vec4(inPosition, 1.0);
+		}
+		)";
+
+const char *shadow_fragment_shader =
+  R"(
+		#version 450
+
+		void main() {
+		}
+		)";
+
+const char *test_shader =
+  R"(
+		#version 450
+
+		#define N_LOCAL 64
+
+		layout (local_size_x = N_LOCAL, local_size_y = 1, local_size_z = 1) in;
+
+		layout (binding = 0) uniform sampler2D shadowMap;
+
+		layout (std430, binding = 1) readonly buffer Points {
+			vec4 points[];
+		};
+
+		layout (std430, binding = 2) buffer Flags {
+			uint flags[];
+		};
+
+		layout(push_constant) uniform Parameters {
+			mat4 light_matrix;
+			uint n_points;
+			uint words;
+			uint sun;
+			float bias;
+		} parameters;
+
+		void main() {
+			uint i = gl_GlobalInvocationID.x;
+			if (i >= parameters.n_points) return;
+
+			// points outside of the tile are tested with another one
+			vec4 p = parameters.light_matrix * vec4(points[i].xyz, 1.0);
+			ivec2 size = textureSize(shadowMap, 0);
+			ivec2 texel = ivec2(floor((p.xy * 0.5 + 0.5) * vec2(size)));
+			if (any(lessThan(texel, ivec2(0))) || any(greaterThanEqual(texel, size))) return;
+
+			if (p.z <= texelFetch(shadowMap, texel, 0).r + parameters.bias) {
+				flags[i * parameters.words + parameters.sun / 32] |= 1u << (parameters.sun % 32);
+			}
+		}
+		)";
+
+/// the direction to the sun, with the azimuth and altitude (radians) of the sun stages
+glm::vec3 sun_direction(float azimuth, float altitude)
+{
+  return glm::vec3(std::cos(altitude) * std::cos(azimuth), std::cos(altitude) * std::sin(azimuth), std::sin(altitude));
+}
+}  // namespace
+
+quavis::ComputeDirectSun::ComputeDirectSun(std::weak_ptr<Anvil::SGPUDevice> device_ptr, uint32_t resolution, float texel_size, float depth_bias)
+  : device_ptr_{device_ptr}
+  , resolution_{resolution}
+  , texel_size_{texel_size}
+  , depth_bias_{depth_bias}
+{
+  // the depth maps are drawn and read in turn, on the universal queue
+  const auto queues = get_device_queues(device_ptr_.lock());
+  queue_            = queues.graphics;
+  command_buffer_   = queues.graphics_pool->alloc_primary_level_command_buffer();
+
+  create_depth_map();
+  create_test_pipeline();
+}
+
+void quavis::ComputeDirectSun::create_depth_map()
+{
+  depth_image_ = Anvil::Image::create_nonsparse(device_ptr_, VK_IMAGE_TYPE_2D, VK_FORMAT_D32_SFLOAT, VK_IMAGE_TILING_OPTIMAL,
+                                                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, resolution_, resolution_,
+                                                1, /* in_base_mipmap_depth */
+                                                1, /* in_n_layers          */
+                                                VK_SAMPLE_COUNT_1_BIT, Anvil::QUEUE_FAMILY_GRAPHICS_BIT, VK_SHARING_MODE_EXCLUSIVE, false,
+                                                0u, /* in_memory_features */
+                                                0u, /* in_create_flags    */
+                                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, nullptr);
+  depth_view_  = Anvil::ImageView::create_2D(device_ptr_, depth_image_, 0, 0, 1, VK_IMAGE_ASPECT_DEPTH_BIT, VK_FORMAT_D32_SFLOAT,
+                                            VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+                                            VK_COMPONENT_SWIZZLE_IDENTITY);
+  depth_sampler_ = Anvil::Sampler::create(device_ptr_, VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_MIPMAP_MODE_NEAREST,
+                                          VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                                          VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, 0, 0, false, VK_COMPARE_OP_NEVER, 0.0, 0.0,
+                                          VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE, false);
+
+  framebuffer_ = Anvil::Framebuffer::create(device_ptr_, resolution_, resolution_, 1);
+  framebuffer_->add_attachment(depth_view_, nullptr);
+
+  auto allocator{Anvil::MemoryAllocator::create_oneshot(device_ptr_)};
+  light_ubo_ = Anvil::Buffer::create_nonsparse(device_ptr_, sizeof(glm::mat4), Anvil::QUEUE_FAMILY_GRAPHICS_BIT, VK_SHARING_MODE_EXCLUSIVE,
+                                               VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  allocator->add_buffer(light_ubo_, 0);
+  allocator->bake();
+
+  // all depth only pipelines share the light matrix
+  shadow_descriptor_group_ = Anvil::DescriptorSetGroup::create(device_ptr_, false, 1);
+  shadow_descriptor_group_->add_binding(0, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr);
+  auto light_set = shadow_descriptor_group_->get_descriptor_set(0);
+  light_set->set_binding_item(0, Anvil::DescriptorSet::UniformBufferBindingElement(light_ubo_));
+  light_set->bake();
+}
+
+void quavis::ComputeDirectSun::create_test_pipeline()
+{
+  auto device{device_ptr_.lock()};
+  auto pipeline_manager{device->get_compute_pipeline_manager()};
+
+  test_shader_ = ShaderLoader::create_shader_entry(device_ptr_, test_shader, Anvil::ShaderStage::SHADER_STAGE_COMPUTE);
+  pipeline_manager->add_regular_pipeline(false, false, *test_shader_, &test_pipeline_);
+  pipeline_manager->attach_push_constant_range_to_pipeline(test_pipeline_, 0, sizeof(ComputeDirectSunParams), VK_SHADER_STAGE_COMPUTE_BIT);
+
+  test_descriptor_group_ = Anvil::DescriptorSetGroup::create(device_ptr_, false, 1);
+  test_descriptor_group_->add_binding(0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr);
+  test_descriptor_group_->add_binding(0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr);
+  test_descriptor_group_->add_binding(0, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr);
+  pipeline_manager->set_pipeline_dsg(test_pipeline_, test_descriptor_group_);
+}
+
+quavis::ComputeDirectSun::ShadowPipeline quavis::ComputeDirectSun::create_shadow_pipeline(std::shared_ptr<DrawableGeometry> geometry)
+{
+  auto device{device_ptr_.lock()};
+  auto gfx_pipeline_manager{device->get_graphics_pipeline_manager()};
+
+  ShadowPipeline res;
+  res.render_pass = Anvil::RenderPass::create(device_ptr_, nullptr);
+
+  // the depth map is read by the test after the pass, the barriers around the pass change its layout
+  Anvil::RenderPassAttachmentID depth_attachment_id;
+  res.render_pass->add_depth_stencil_attachment(VK_FORMAT_D32_SFLOAT, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                                VK_ATTACHMENT_STORE_OP_STORE,
+                                                VK_ATTACHMENT_LOAD_OP_DONT_CARE,  /* stencil_load_op  */
+                                                VK_ATTACHMENT_STORE_OP_DONT_CARE, /* stencil_store_op */
+                                                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                                                false, /* may_alias */
+                                                &depth_attachment_id);
+
+  res.shader_vertex   = ShaderLoader::create_shader_entry(device_ptr_, shadow_vertex_shader, Anvil::SHADER_STAGE_VERTEX);
+  res.shader_fragment = ShaderLoader::create_shader_entry(device_ptr_, shadow_fragment_shader, Anvil::SHADER_STAGE_FRAGMENT);
+  res.shader_empty    = ShaderLoader::create_shader_entry(device_ptr_, nullptr, Anvil::SHADER_STAGE_GEOMETRY);
+  res.render_pass->add_subpass(*res.shader_fragment, *res.shader_empty, *res.shader_empty, *res.shader_empty, *res.shader_vertex, &res.subpass);
+  res.render_pass->get_subpass_graphics_pipeline_id(res.subpass, &res.pipeline);
+  res.render_pass->add_subpass_depth_stencil_attachment(res.subpass, depth_attachment_id, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+
+  gfx_pipeline_manager->toggle_dynamic_states(
+    res.pipeline, true, Anvil::GraphicsPipelineManager::DYNAMIC_STATE_VIEWPORT_BIT | Anvil::GraphicsPipelineManager::DYNAMIC_STATE_SCISSOR_BIT);
+  gfx_pipeline_manager->set_dynamic_viewport_state_properties(res.pipeline, 1);
+  gfx_pipeline_manager->set_dynamic_scissor_state_properties(res.pipeline, 1);
+  gfx_pipeline_manager->toggle_depth_test(res.pipeline, true, VK_COMPARE_OP_LESS_OR_EQUAL);
+  gfx_pipeline_manager->toggle_depth_writes(res.pipeline, true);
+  gfx_pipeline_manager->set_rasterization_properties(res.pipeline, VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 1.0f);
+
+  // only the positions, the vertex data bound by the draws is not read
+  gfx_pipeline_manager->add_vertex_attribute(res.pipeline, 0, geometry->get_position_format(), 0, geometry->get_position_stride(),
+                                             VK_VERTEX_INPUT_RATE_VERTEX, 0);
+  gfx_pipeline_manager->attach_push_constant_range_to_pipeline(res.pipeline, 0, sizeof(glm::mat4), VK_SHADER_STAGE_VERTEX_BIT);
+  gfx_pipeline_manager->set_pipeline_dsg(res.pipeline, shadow_descriptor_group_);
+
+  return res;
+}
+
+std::vector<std::shared_ptr<ComputeResult>> quavis::ComputeDirectSun::compute(const std::vector<std::shared_ptr<SceneObject>> &objects,
+                                                                              const std::vector<Observation> &observations)
+{
+  // the distinct sun positions, usually all observations share the same ones
+  std::map<std::pair<float, float>, uint32_t> sun_indices;
+  std::vector<glm::vec3> suns;
+  std::vector<glm::vec3> points;
+  for (const auto &obs : observations) {
+    for (size_t j = 0; j < obs.solar_azimuth.size(); j++) {
+      const auto key = std::make_pair(obs.solar_azimuth[j], obs.solar_altitude[j]);
+      if (sun_indices.emplace(key, static_cast<uint32_t>(suns.size())).second) {
+        suns.push_back(sun_direction(key.first, key.second));
+      }
+    }
+    points.push_back(obs.position);
+  }
+  const uint32_t words = static_cast<uint32_t>((suns.size() + 31) / 32);
+
+  std::vector<uint32_t> flags(points.size() * words, 0u);
+  if (!objects.empty() && !flags.empty()) {
+    auto device{device_ptr_.lock()};
+
+    // objects of streamed tiles that are not on the GPU are uploaded for the computation only
+    std::vector<std::shared_ptr<SceneObject>> uploaded;
+    for (const auto &obj : objects) {
+      if (!obj->get_geometry()->is_resident()) {
+        obj->prepare_for_draw(device_ptr_);
+        uploaded.push_back(obj);
+      }
+    }
+
+    bool new_pipelines = false;
+    for (auto &it : shadow_pipelines_) {
+      it.second.objects.clear();
+    }
+    for (size_t o = 0; o < objects.size(); o++) {
+      const auto geometry = objects[o]->get_geometry();
+      const auto key = std::to_string(static_cast<int>(geometry->get_position_format())) + "/" + std::to_string(geometry->get_position_stride());
+      auto it        = shadow_pipelines_.find(key);
+      if (it == shadow_pipelines_.end()) {
+        it            = shadow_pipelines_.emplace(key, create_shadow_pipeline(geometry)).first;
+        new_pipelines = true;
+      }
+      it->second.objects.push_back(o);
+    }
+    if (new_pipelines) device->get_graphics_pipeline_manager()->bake();
+
+    std::vector<glm::vec4> point_data;
+    for (const auto &p : points) {
+      point_data.emplace_back(p, 1.0f);
+    }
+
+    auto allocator{Anvil::MemoryAllocator::create_oneshot(device_ptr_)};
+    points_buffer_ = Anvil::Buffer::create_nonsparse(device_ptr_, point_data.size() * sizeof(point_data[0]), Anvil::QUEUE_FAMILY_GRAPHICS_BIT,
+                                                     VK_SHARING_MODE_EXCLUSIVE, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    flags_buffer_  = Anvil::Buffer::create_nonsparse(device_ptr_, flags.size() * sizeof(flags[0]), Anvil::QUEUE_FAMILY_GRAPHICS_BIT,
+                                                    VK_SHARING_MODE_EXCLUSIVE, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    allocator->add_buffer(points_buffer_, 0);
+    allocator->add_buffer(flags_buffer_, 0);
+    points_buffer_->write(0, point_data.size() * sizeof(point_data[0]), point_data.data());
+    flags_buffer_->write(0, flags.size() * sizeof(flags[0]), flags.data());
+
+    auto test_set = test_descriptor_group_->get_descriptor_set(0);
+    test_set->set_binding_item(
+      0, Anvil::DescriptorSet::CombinedImageSamplerBindingElement(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, depth_view_, depth_sampler_));
+    test_set->set_binding_item(1, Anvil::DescriptorSet::StorageBufferBindingElement(points_buffer_));
+    test_set->set_binding_item(2, Anvil::DescriptorSet::StorageBufferBindingElement(flags_buffer_));
+
+    // one sun at a time, the next one is recorded while the GPU is idle
+    for (uint32_t s = 0; s < suns.size(); s++) {
+      if (suns[s].z <= 0.0f) continue;
+      record_sun(objects, points, suns[s], s, words);
+      queue_->submit_command_buffer(command_buffer_, true /* should_block */);
+    }
+
+    flags_buffer_->read(0, flags.size() * sizeof(flags[0]), flags.data());
+
+    for (const auto &obj : uploaded) {
+      obj->release_gpu();
+    }
+  }
+
+  std::vector<std::shared_ptr<ComputeResult>> results;
+  for (size_t i = 0; i < observations.size(); i++) {
+    const auto &obs = observations[i];
+    auto result     = std::make_shared<ComputeResult>();
+    for (size_t j = 0; j < obs.solar_azimuth.size(); j++) {
+      const uint32_t s = sun_indices.at(std::make_pair(obs.solar_azimuth[j], obs.solar_altitude[j]));
+      const bool lit   = suns[s].z > 0.0f && (objects.empty() || (flags[i * words + s / 32] >> (s % 32) & 1u) != 0);
+      result->values.push_back(lit ? 1.0f : 0.0f);
+    }
+    results.push_back(result);
+  }
+  return results;
+}
+
+void quavis::ComputeDirectSun::record_sun(const std::vector<std::shared_ptr<SceneObject>> &objects, const std::vector<glm::vec3> &points,
+                                          const glm::vec3 &direction, uint32_t sun, uint32_t words)
+{
+  auto device{device_ptr_.lock()};
+  auto gfx_pipeline_manager{device->get_graphics_pipeline_manager()};
+  auto compute_pipeline_manager{device->get_compute_pipeline_manager()};
+
+  // light space looks along the sun light, the depth grows away from the sun
+  const glm::vec3 up        = std::abs(direction.z) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 0.0f, 1.0f);
+  const glm::mat4 light_view = glm::lookAt(glm::vec3(0.0f), -direction, up);
+
+  // the tiles cover the observation points, the depth range all objects between the sun and the farthest point
+  glm::vec2 lower(std::numeric_limits<float>::max());
+  glm::vec2 upper(std::numeric_limits<float>::lowest());
+  float near = std::numeric_limits<float>::max();
+  float far  = std::numeric_limits<float>::lowest();
+  std::vector<glm::vec2> light_points;
+  for (const auto &p : points) {
+    const glm::vec3 l(light_view * glm::vec4(p, 1.0f));
+    light_points.emplace_back(l);
+    lower = glm::min(lower, glm::vec2(l));
+    upper = glm::max(upper, glm::vec2(l));
+    near  = std::min(near, -l.z);
+    far   = std::max(far, -l.z);
+  }
+  std::vector<glm::vec4> bounds;  ///< per object, the center of its bounding sphere in light space (x, y, depth) and its radius
+  for (const auto &obj : objects) {
+    const glm::vec3 c(light_view * glm::vec4(obj->get_world_bounds_center(), 1.0f));
+    const float r = obj->get_world_bounds_radius();
+    bounds.emplace_back(c.x, c.y, -c.z, r);
+    near = std::min(near, -c.z - r);
+  }
+  near -= depth_bias_;
+  far += 2.0f * depth_bias_;
+  const float margin = 1e-3f * std::max(upper.x - lower.x, upper.y - lower.y) + depth_bias_;
+  lower -= margin;
+  upper += margin;
+
+  const glm::vec2 extent = upper - lower;
+  const float tile_size  = texel_size_ > 0.0f ? texel_size_ * static_cast<float>(resolution_) : std::max(extent.x, extent.y);
+  const int tiles_x      = std::max(1, static_cast<int>(std::ceil(extent.x / tile_size)));
+  const int tiles_y      = std::max(1, static_cast<int>(std::ceil(extent.y / tile_size)));
+
+  // only tiles with observation points are drawn
+  std::vector<bool> occupied(tiles_x * tiles_y, false);
+  for (const auto &l : light_points) {
+    const int x = std::min(tiles_x - 1, static_cast<int>((l.x - lower.x) / tile_size));
+    const int y = std::min(tiles_y - 1, static_cast<int>((l.y - lower.y) / tile_size));
+    occupied[y * tiles_x + x] = true;
+  }
+
+  ComputeDirectSunParams par;
+  par.n_points = static_cast<uint32_t>(points.size());
+  par.words    = words;
+  par.sun      = sun;
+  par.bias     = depth_bias_ / (far - near);
+
+  const VkImageSubresourceRange depth_range{VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1};
+  VkClearValue clear;
+  clear.depthStencil.depth   = 1.0f;
+  clear.depthStencil.stencil = 0;
+  VkRect2D render_area;
+  render_area.offset = {0, 0};
+  render_area.extent = {resolution_, resolution_};
+  const VkViewport viewport{0.0f, 0.0f, static_cast<float>(resolution_), static_cast<float>(resolution_), 0.0f, 1.0f};
+
+  // the draws are raw commands, the wrappers search all objects referenced by the command buffer on each call
+  const std::shared_ptr<Anvil::CommandBufferBase> command_buffer = command_buffer_;
+  const auto commands                                            = command_buffer->get_command_buffer();
+  auto light_set                                                 = shadow_descriptor_group_->get_descriptor_set(0);
+  auto test_set                                                  = test_descriptor_group_->get_descriptor_set(0);
+  auto test_layout                                               = compute_pipeline_manager->get_compute_pipeline_layout(test_pipeline_);
+
+  command_buffer_->start_recording(false, false);
+  for (int y = 0; y < tiles_y; y++) {
+    for (int x = 0; x < tiles_x; x++) {
+      if (!occupied[y * tiles_x + x]) continue;
+
+      // orthographic projection of the tile, the depth from near to far mapped to [0, 1]
+      const glm::vec2 tile_lower = lower + glm::vec2(static_cast<float>(x), static_cast<float>(y)) * tile_size;
+      const glm::vec2 tile_upper = tile_lower + tile_size;
+      glm::mat4 projection(1.0f);
+      projection[0][0] = 2.0f / tile_size;
+      projection[1][1] = 2.0f / tile_size;
+      projection[2][2] = -1.0f / (far - near);
+      projection[3][0] = -(tile_lower.x + tile_upper.x) / tile_size;
+      projection[3][1] = -(tile_lower.y + tile_upper.y) / tile_size;
+      projection[3][2] = -near / (far - near);
+      par.light_matrix = projection * light_view;
+
+      // the draws of the previous tile have read the light matrix, the test of the previous tile the depth map
+      const Anvil::MemoryBarrier matrix_read(VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_UNIFORM_READ_BIT);
+      command_buffer_->record_pipeline_barrier(VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_FALSE, 1, &matrix_read, 0,
+                                               nullptr, 0, nullptr);
+      command_buffer_->record_update_buffer(light_ubo_, 0, sizeof(par.light_matrix), reinterpret_cast<const uint32_t *>(&par.light_matrix));
+      const Anvil::MemoryBarrier matrix_written(VK_ACCESS_UNIFORM_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+      const Anvil::ImageBarrier to_attachment(
+        VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, false,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+        depth_image_, depth_range);
+      command_buffer_->record_pipeline_barrier(
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_FALSE, 1,
+        &matrix_written, 0, nullptr, 1, &to_attachment);
+
+      command_buffer_->record_begin_render_pass(1, &clear, framebuffer_, render_area, shadow_pipelines_.begin()->second.render_pass,
+                                                VK_SUBPASS_CONTENTS_INLINE);
+      command_buffer_->record_set_viewport(0, 1, &viewport);
+      command_buffer_->record_set_scissor(0, 1, &render_area);
+
+      for (const auto &it : shadow_pipelines_) {
+        const auto &pipeline = it.second;
+        if (pipeline.objects.empty()) continue;
+
+        auto pipeline_layout = gfx_pipeline_manager->get_graphics_pipeline_layout(pipeline.pipeline);
+        command_buffer_->record_bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+        command_buffer_->record_bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &light_set, 0, nullptr);
+
+        const auto layout = pipeline_layout->get_pipeline_layout();
+        for (const size_t o : pipeline.objects) {
+          // objects beside the tile or behind all points cast no shadow on the points of the tile
+          const auto &b = bounds[o];
+          if (b.x + b.w < tile_lower.x || b.x - b.w > tile_upper.x || b.y + b.w < tile_lower.y || b.y - b.w > tile_upper.y || b.z - b.w > far) {
+            continue;
+          }
+          const auto &model = objects[o]->get_shader_data().model_matrix;
+          vkCmdPushConstants(commands, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(model), &model);
+          objects[o]->get_geometry()->draw(device_ptr_, command_buffer, 0);
+        }
+      }
+      command_buffer_->record_end_render_pass();
+
+      const Anvil::ImageBarrier to_read(VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, false,
+                                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                        VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, depth_image_, depth_range);
+      command_buffer_->record_pipeline_barrier(VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FALSE, 0, nullptr,
+                                               0, nullptr, 1, &to_read);
+
+      // all points in one dispatch, the points outside of the tile return early
+      command_buffer_->record_bind_pipeline(VK_PIPELINE_BIND_POINT_COMPUTE, test_pipeline_);
+      command_buffer_->record_push_constants(test_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(par), &par);
+      command_buffer_->record_bind_descriptor_sets(VK_PIPELINE_BIND_POINT_COMPUTE, test_layout, 0, 1, &test_set, 0, nullptr);
+      command_buffer_->record_dispatch((par.n_points + 63) / 64, 1, 1);
+
+      // the test of the next tile sets bits of the same words
+      const Anvil::MemoryBarrier flags_written(VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+      command_buffer_->record_pipeline_barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FALSE, 1,
+                                               &flags_written, 0, nullptr, 0, nullptr);
+    }
+  }
+
+  const Anvil::MemoryBarrier host_read(VK_ACCESS_HOST_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+  command_buffer_->record_pipeline_barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_FALSE, 1, &host_read, 0, nullptr, 0,
+                                           nullptr);
+  command_buffer_->stop_recording();
+}
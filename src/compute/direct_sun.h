@@ -0,0 +1,81 @@
+#ifndef QUAVIS_COMPUTE_DIRECT_SUN
+#define QUAVIS_COMPUTE_DIRECT_SUN
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "../render/scene_object.h"
+#include "./compute_base.h"
+
+namespace quavis {
+struct ComputeDirectSunParams {
+  glm::mat4 light_matrix;  ///< world to the clip space of the depth map tile
+  uint32_t n_points;
+  uint32_t words;  ///< flag words per observation point
+  uint32_t sun;    ///< index of the sun position, the bit set for sunlit points
+  float bias;      ///< depth bias in clip space
+};
+
+/// The direct sun light of all observation points at once. For each distinct sun position of the observations the scene is rendered into an
+/// orthographic depth map seen from the sun, then one compute dispatch tests all observation points against it. Unlike the sun stages it needs no
+/// rendering per observation point, the cost grows with the sun positions instead of the observation points.
+class ComputeDirectSun {
+ public:
+  /// resolution is the width and height of the depth map. texel_size is the size of a depth map texel in world units, the observation points are
+  /// then covered by as many tiles as needed, 0 fits a single depth map around all of them. A point up to depth_bias (world units) behind the first
+  /// surface seen from the sun is still sunlit
+  ComputeDirectSun(std::weak_ptr<Anvil::SGPUDevice> device_ptr, uint32_t resolution = 2048, float texel_size = 0.0f, float depth_bias = 0.01f);
+
+  /// returns per observation a value per sun position of the observation (see Observation::solar_azimuth), 1 if the point is sunlit and 0 if it
+  /// is shaded or the sun is below the horizon. Objects not on the GPU (streaming) are uploaded for the computation and released again
+  std::vector<std::shared_ptr<ComputeResult>> compute(const std::vector<std::shared_ptr<SceneObject>> &objects,
+                                                      const std::vector<Observation> &observations);
+
+ private:
+  /// the depth only pipeline of one vertex position layout and the objects drawn with it
+  struct ShadowPipeline {
+    std::shared_ptr<Anvil::ShaderModuleStageEntryPoint> shader_vertex;
+    std::shared_ptr<Anvil::ShaderModuleStageEntryPoint> shader_fragment;
+    std::shared_ptr<Anvil::ShaderModuleStageEntryPoint> shader_empty;
+    std::shared_ptr<Anvil::RenderPass> render_pass;
+    Anvil::SubPassID subpass;
+    Anvil::PipelineID pipeline;
+    std::vector<size_t> objects;
+  };
+
+  void create_depth_map();
+  void create_test_pipeline();
+  ShadowPipeline create_shadow_pipeline(std::shared_ptr<DrawableGeometry> geometry);
+  /// records the depth maps and the tests of sun position sun, the bits of sunlit points are set in flags_
+  void record_sun(const std::vector<std::shared_ptr<SceneObject>> &objects, const std::vector<glm::vec3> &points, const glm::vec3 &direction,
+                  uint32_t sun, uint32_t words);
+
+  std::weak_ptr<Anvil::SGPUDevice> device_ptr_;
+  uint32_t resolution_;
+  float texel_size_;
+  float depth_bias_;
+
+  std::shared_ptr<Anvil::Queue> queue_;
+  std::shared_ptr<Anvil::PrimaryCommandBuffer> command_buffer_;
+
+  std::shared_ptr<Anvil::Image> depth_image_;
+  std::shared_ptr<Anvil::ImageView> depth_view_;
+  std::shared_ptr<Anvil::Sampler> depth_sampler_;
+  std::shared_ptr<Anvil::Framebuffer> framebuffer_;
+  std::shared_ptr<Anvil::Buffer> light_ubo_;  ///< the light matrix of the tile drawn
+  std::shared_ptr<Anvil::DescriptorSetGroup> shadow_descriptor_group_;
+  std::map<std::string, ShadowPipeline> shadow_pipelines_;  ///< per vertex position format and stride
+
+  std::shared_ptr<Anvil::ShaderModuleStageEntryPoint> test_shader_;
+  Anvil::ComputePipelineID test_pipeline_;
+  std::shared_ptr<Anvil::DescriptorSetGroup> test_descriptor_group_;
+  std::shared_ptr<Anvil::Buffer> points_buffer_;
+  std::shared_ptr<Anvil::Buffer> flags_buffer_;
+};
+}  // namespace quavis
+
+#endif
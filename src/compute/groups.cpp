@@ -5,9 +5,10 @@
 
 using namespace quavis;
 
-quavis::ComputeGroups::ComputeGroups(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2 &image_dim)
+quavis::ComputeGroups::ComputeGroups(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2 &image_dim,
+                                     const std::vector<std::string> &defines)
   : image_dim_{image_dim}
-  , ComputeBaseGPU<ComputeGroupsParams>(device_ptr, create_compute_stages(image_dim))
+  , ComputeBaseGPU<ComputeGroupsParams>(device_ptr, create_compute_stages(image_dim), defines)
 {
 }
 
@@ -18,6 +19,7 @@ const quavis::ComputeGroupsParams quavis::ComputeGroups::get_parameter()
   par.width  = image_dim_.x;
 	//par.vv = {1.0,0.0,0.0};
 	par.field_of_view = 360.0;
+  par.face_mask     = 0x3f;
   return par;
 }
 
@@ -38,7 +40,16 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeGroups::create_compute_st
 
 		layout (local_size_x = N_LOCAL, local_size_y = 1, local_size_z = 1) in;
 
-		layout (binding = 0, rgba32f) uniform readonly image2DArray colorImage;
+#ifndef QUAVIS_TARGET_FORMAT
+		// color and distance (see TargetLayout)
+		#define QUAVIS_TARGET_FORMAT rgba32f
+		#define QUAVIS_TARGET_DISTANCE a
+#endif
+#ifdef QUAVIS_SAMPLES
+		layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DMSArray colorImage;
+#else
+		layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DArray colorImage;
+#endif
 		layout (binding = 1, rg32f) uniform readonly image2DArray depthImage;
 		// layout (binding = 2) buffer InputBuffer { } input;
 		layout (binding = 3) buffer OutputBuffer {
@@ -52,8 +63,12 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeGroups::create_compute_st
 			float view_x;
 			float view_y;
 			float view_z;
+			uint face_mask;
 		} parameters;
 
+		// face_size, triangle_solid_angle and cube_weight
+		#include "cube_faces.glsl"
+
 		shared float tmp_local[N_LOCAL*MAX_GROUPS];
 
 		vec2 project(vec3 position) {
@@ -75,6 +90,9 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeGroups::create_compute_st
 
 		void main()
 		{
+		  // lower resolution levels only fill the first rows of the image
+		  if (gl_WorkGroupID.y >= uint(parameters.height)) return;
+
 			for (int i = 0; i < N_LOCAL*MAX_GROUPS; i++) {
 				tmp_local[i] = 0.0;
 			}
@@ -96,19 +114,31 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeGroups::create_compute_st
 			  j = float(gl_WorkGroupID.y);
 			  n = float(parameters.width);
 			  m = float(parameters.height);
-			  float weight = 4.0f/n/m/sqrt(pow((3.0f + 4.0f*j*(j-m)/m/m + 4.0f*i*(i-n)/n/n), 3.0f));
+			  float weight = cube_weight(i, j, n, m);
 				//float k = log2(max(1, pow(MAX_GROUPS, 1.0 / 3.0) - 1));
         //float basis = round(max(2, pow(2, k) + 1));
 				
 				// compute pixel direction (cartesian)
-				float u = 2*(float(x)/parameters.width - 0.5);
-				float v = 2*(float(gl_WorkGroupID.y)/parameters.height - 0.5);
+				float u = 2*((float(x) + 0.5)/parameters.width - 0.5);
+				float v = 2*((float(gl_WorkGroupID.y) + 0.5)/parameters.height - 0.5);
 
 				float value;
 				highp int bucket;
 				vec4 rgba;
 				vec2 pv; // pixel direction
 				for (uint i = 0; i < 6; i++) {
+					// faces outside the view cone are not rendered
+					if ((parameters.face_mask & (1u << i)) == 0u) continue;
+#ifdef QUAVIS_FACE_SIZES
+					// texels outside of the resolution of the face are not rendered
+					if (x >= uint(face_size[i].x) || gl_WorkGroupID.y >= uint(face_size[i].y)) continue;
+					n = float(face_size[i].x);
+					m = float(face_size[i].y);
+					weight = cube_weight(float(x), j, n, m);
+					u = 2*((float(x) + 0.5)/n - 0.5);
+					v = 2*((float(gl_WorkGroupID.y) + 0.5)/m - 0.5);
+#endif
+
 					if (i == 0) {
 						// front
 						pv = project(vec3(1, u, v));
@@ -139,11 +169,21 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeGroups::create_compute_st
 
 					float delta = acos(sin(pv.y)*sin(vv.y) + cos(pv.y)*cos(vv.y)*cos(pv.x-vv.x));
 					if (delta <= parameters.field_of_view / 180.0 * 3.1415926) {
+#ifdef QUAVIS_SAMPLES
+						// each sample adds its part of the texel to its own group
+						for (int s = 0; s < QUAVIS_SAMPLES; s++) {
+							rgba = imageLoad(colorImage, ivec3(x, gl_WorkGroupID.y, i), s);
+							value = rgba.QUAVIS_TARGET_DISTANCE > 0 ? weight / float(QUAVIS_SAMPLES) : 0;
+							bucket = int(round(rgba.r));
+							tmp_local[gl_LocalInvocationID.x*MAX_GROUPS + bucket] += value;
+						}
+#else
 						rgba = imageLoad(colorImage, ivec3(x, gl_WorkGroupID.y, i));
-			  		value = rgba.a > 0 ? weight : 0;
+			  		value = rgba.QUAVIS_TARGET_DISTANCE > 0 ? weight : 0;
 						bucket = int(round(rgba.r));
 						//bucket = int(round(rgba.r * (basis-1) + rgba.g * (basis-1) * basis + rgba.b * (basis-1) * pow(basis, 2)));
 						tmp_local[gl_LocalInvocationID.x*MAX_GROUPS + bucket] += value;
+#endif
 					}
 				}
 		  }
@@ -185,7 +225,14 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeGroups::create_compute_st
 
 		layout (local_size_x = 1, local_size_y = N_LOCAL, local_size_z = 1) in;
 
-		layout (binding = 0, rgba32f) uniform readonly image2DArray colorImage;
+#ifndef QUAVIS_TARGET_FORMAT
+		#define QUAVIS_TARGET_FORMAT rgba32f
+#endif
+#ifdef QUAVIS_SAMPLES
+		layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DMSArray colorImage;
+#else
+		layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DArray colorImage;
+#endif
 		// layout (binding = 1, rg32f) uniform readonly image2DArray depthImage;
 		layout (binding = 2) buffer InputBuffer { 
 			float values[];
@@ -202,6 +249,7 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeGroups::create_compute_st
 			float view_x;
 			float view_y;
 			float view_z;
+			uint face_mask;
 		} parameters;
 
 		void main()
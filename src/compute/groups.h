@@ -11,15 +11,18 @@ struct ComputeGroupsParams {
   float view_x;
   float view_y;
   float view_z;
+  uint32_t face_mask;  ///< cube faces (bit i for layer i) that were rendered
 };
 
 class ComputeGroups : public ComputeBaseGPU<ComputeGroupsParams> {
  public:
-  ComputeGroups(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2& image_dim);
+  ComputeGroups(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2& image_dim, const std::vector<std::string>& defines = {});
   virtual const ComputeGroupsParams get_parameter() override;
+  virtual void set_resolution(const glm::ivec2& resolution) override { image_dim_ = resolution; }
+  virtual DirectionDomain get_direction_domain() const override { return DirectionDomain::VIEW_CONE; }
 
  private:
-  const glm::ivec2 image_dim_;
+  glm::ivec2 image_dim_;
 
   std::vector<ComputeShaderStage> create_compute_stages(const glm::ivec2& image_dim);
 };
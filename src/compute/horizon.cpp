@@ -0,0 +1,213 @@
+#include "horizon.h"
+
+#include <stdexcept>
+
+using namespace quavis;
+
+namespace {
+/// the stages need the number of bins at compile time, for the profile of a row in shared memory
+std::vector<std::string> add_bins_define(std::vector<std::string> defines, uint32_t bins)
+{
+  if (bins == 0 || bins > 4096) throw std::runtime_error("The horizon needs 1 to 4096 bins");
+  defines.push_back("QUAVIS_HORIZON_BINS " + std::to_string(bins));
+  return defines;
+}
+}  // namespace
+
+quavis::ComputeHorizon::ComputeHorizon(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2 &image_dim, uint32_t bins,
+                                       const std::vector<std::string> &defines)
+  : image_dim_{image_dim}
+  , ComputeBaseGPU<ComputeHorizonParams>(device_ptr, create_compute_stages(image_dim, bins), add_bins_define(defines, bins))
+{
+}
+
+const quavis::ComputeHorizonParams quavis::ComputeHorizon::get_parameter()
+{
+  ComputeHorizonParams par;
+  par.height = image_dim_.y;
+  par.width  = image_dim_.x;
+  return par;
+}
+
+std::vector<quavis::ComputeShaderStage> quavis::ComputeHorizon::create_compute_stages(const glm::ivec2 &image_dim, uint32_t bins)
+{
+  std::vector<quavis::ComputeShaderStage> stages;
+  ComputeShaderStage stage;
+  stage.shader_code =
+    R"(
+		#version 450
+
+		// constants
+		#define N_LOCAL 16
+		#define PI 3.1415926
+
+		layout (local_size_x = N_LOCAL, local_size_y = 1, local_size_z = 1) in;
+
+#ifndef QUAVIS_TARGET_FORMAT
+		// color and distance (see TargetLayout)
+		#define QUAVIS_TARGET_FORMAT rgba32f
+		#define QUAVIS_TARGET_DISTANCE a
+#endif
+#ifdef QUAVIS_SAMPLES
+		layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DMSArray colorImage;
+#else
+		layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DArray colorImage;
+#endif
+		// layout (binding = 2) buffer InputBuffer { } input;
+		layout (binding = 3) buffer OutputBuffer {
+		  float values[];
+		} outputs;
+
+		layout(push_constant) uniform Parameters {
+			int width;
+			int height;
+		} parameters;
+
+		// face_size and face_direction
+		#include "cube_faces.glsl"
+
+		// the highest obstructed altitude per bin of this row. The bits of positive floats have the order of the floats
+		shared uint profile[QUAVIS_HORIZON_BINS];
+
+		// fraction of the texel p covered by geometry, each sample of a multisampled target covers an equal part of the texel
+		float coverage(ivec3 p) {
+#ifdef QUAVIS_SAMPLES
+			float c = 0.0f;
+			for (int s = 0; s < QUAVIS_SAMPLES; s++) {
+				c += imageLoad(colorImage, p, s).QUAVIS_TARGET_DISTANCE > 0 ? 1.0f : 0.0f;
+			}
+			return c / float(QUAVIS_SAMPLES);
+#else
+			return imageLoad(colorImage, p).QUAVIS_TARGET_DISTANCE > 0 ? 1.0f : 0.0f;
+#endif
+		}
+
+		// azimuth in [0, 2pi)
+		float azimuth(vec3 d) {
+			float a = atan(d.y, d.x);
+			return a < 0.0f ? a + 2.0f*PI : a;
+		}
+
+		void main()
+		{
+		  // lower resolution levels only fill the first rows of the image
+		  if (gl_WorkGroupID.y >= uint(parameters.height)) return;
+
+		  for (uint b = gl_LocalInvocationID.x; b < QUAVIS_HORIZON_BINS; b += N_LOCAL) {
+			profile[b] = 0;
+		  }
+		  barrier();
+
+		  uint chunksize = parameters.width/N_LOCAL;
+		  uint xpos = gl_LocalInvocationID.x * chunksize;
+		  float bins_per_radian = float(QUAVIS_HORIZON_BINS) / (2.0f*PI);
+		  for (uint x = xpos; x < xpos + chunksize; x++) {
+			float n = float(parameters.width);
+			float m = float(parameters.height);
+			// the downward face (5) is below the horizon and not rendered
+			for (int f = 0; f < 5; f++) {
+#ifdef QUAVIS_FACE_SIZES
+			  // texels outside of the resolution of the face are not rendered
+			  if (x >= uint(face_size[f].x) || gl_WorkGroupID.y >= uint(face_size[f].y)) continue;
+			  n = float(face_size[f].x);
+			  m = float(face_size[f].y);
+#endif
+			  if (coverage(ivec3(x, gl_WorkGroupID.y, f)) < 0.5f) continue;
+
+			  float v = 2.0f*(float(x) + 0.5f)/n - 1.0f;
+			  float u = 2.0f*(float(gl_WorkGroupID.y) + 0.5f)/m - 1.0f;
+			  vec3 d = face_direction(f, v, u);
+
+			  // the altitude of the highest point of the texel keeps the horizon conservative. It is the point closest to the face center on the
+			  // top face, and the point of the upper edge closest to the center column on the side faces
+			  float v_top = clamp(0.0f, v - 1.0f/n, v + 1.0f/n);
+			  float u_top = f == 4 ? clamp(0.0f, u - 1.0f/m, u + 1.0f/m) : u - 1.0f/m;
+			  vec3 top = face_direction(f, v_top, u_top);
+			  float altitude = asin(top.z / length(top));
+			  if (altitude <= 0.0f) continue;
+
+			  // the texel counts for all bins between the azimuths of its corners, so bins narrower than the texels near the zenith are not missed
+			  float a = azimuth(d);
+			  float lo = 0.0f;
+			  float hi = 0.0f;
+			  for (int c = 0; c < 4; c++) {
+				vec3 corner = face_direction(f, v + ((c & 1) == 0 ? -1.0f : 1.0f)/n, u + ((c & 2) == 0 ? -1.0f : 1.0f)/m);
+				float delta = azimuth(corner) - a;
+				delta = delta > PI ? delta - 2.0f*PI : (delta < -PI ? delta + 2.0f*PI : delta);
+				lo = min(lo, delta);
+				hi = max(hi, delta);
+			  }
+			  int first = int(floor((a + lo) * bins_per_radian));
+			  int last = int(floor((a + hi) * bins_per_radian));
+			  // the texel around the zenith covers all azimuths
+			  if (hi - lo > PI) {
+				first = 0;
+				last = QUAVIS_HORIZON_BINS - 1;
+			  }
+
+			  uint bits = floatBitsToUint(altitude);
+			  for (int b = first; b <= last; b++) {
+				atomicMax(profile[(b + QUAVIS_HORIZON_BINS) % QUAVIS_HORIZON_BINS], bits);
+			  }
+			}
+		  }
+		  barrier();
+
+		  for (uint b = gl_LocalInvocationID.x; b < QUAVIS_HORIZON_BINS; b += N_LOCAL) {
+			outputs.values[gl_WorkGroupID.y * QUAVIS_HORIZON_BINS + b] = uintBitsToFloat(profile[b]);
+		  }
+		}
+		)";
+  stage.work_group_size             = glm::vec3(1, image_dim.y, 1);
+  stage.input_buffer_size           = 0;
+  stage.output_buffer_size          = image_dim.y * bins * sizeof(float);
+  stage.has_shader_parameters       = true;
+  stage.input_color_cube            = true;
+  stage.retrieve_output_buffer_size = 0;
+  stages.push_back(stage);
+
+  stage.shader_code =
+    R"(
+		#version 450
+
+		// constants
+		#define N_LOCAL 64
+
+		layout (local_size_x = N_LOCAL, local_size_y = 1, local_size_z = 1) in;
+
+		layout (binding = 2) buffer InputBuffer {
+			float values[];
+		} inputs;
+
+		layout (binding = 3) buffer OutputBuffer {
+		  float values[];
+		} outputs;
+
+		layout(push_constant) uniform Parameters {
+			int width;
+			int height;
+		} parameters;
+
+		void main()
+		{
+		  // the profile is the highest altitude of all rows per bin
+		  uint b = gl_GlobalInvocationID.x;
+		  if (b >= QUAVIS_HORIZON_BINS) return;
+
+		  float altitude = 0.0f;
+		  for (int y = 0; y < parameters.height; y++) {
+			altitude = max(altitude, inputs.values[y * QUAVIS_HORIZON_BINS + b]);
+		  }
+		  outputs.values[b] = altitude;
+		}
+		)";
+  stage.work_group_size             = glm::vec3((bins + 63) / 64, 1, 1);
+  stage.input_buffer_size           = image_dim.y * bins * sizeof(float);
+  stage.output_buffer_size          = bins * sizeof(float);
+  stage.has_shader_parameters       = true;
+  stage.input_color_cube            = false;
+  stage.retrieve_output_buffer_size = bins * sizeof(float);
+  stages.push_back(stage);
+
+  return stages;
+}
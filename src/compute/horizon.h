@@ -0,0 +1,31 @@
+#ifndef QUAVIS_COMPUTE_HORIZON
+#define QUAVIS_COMPUTE_HORIZON
+
+#include "./compute_base.h"
+
+namespace quavis {
+struct ComputeHorizonParams {
+  int width;
+  int height;
+};
+
+/// The horizon profile of an observation point, the highest obstructed altitude (radians, 0 if nothing is above the horizon) per azimuth bin, taken
+/// at the upper edge of the obstructed texels. Bin b covers the azimuths [b, b + 1) * 2pi / bins, with the azimuth of the sun stages. The profile
+/// assumes that everything below an obstruction is obstructed too, sky seen below an overhang is lost
+class ComputeHorizon : public ComputeBaseGPU<ComputeHorizonParams> {
+ public:
+  ComputeHorizon(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2& image_dim, uint32_t bins = 720,
+                 const std::vector<std::string>& defines = {});
+
+  virtual const ComputeHorizonParams get_parameter() override;
+  virtual void set_resolution(const glm::ivec2& resolution) override { image_dim_ = resolution; }
+  virtual DirectionDomain get_direction_domain() const override { return DirectionDomain::UPPER_HEMISPHERE; }
+
+ private:
+  glm::ivec2 image_dim_;
+
+  std::vector<ComputeShaderStage> create_compute_stages(const glm::ivec2& image_dim, uint32_t bins);
+};
+}  // namespace quavis
+
+#endif
@@ -0,0 +1,62 @@
+#include "horizon_profiles.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace quavis;
+
+quavis::HorizonProfiles::HorizonProfiles(const std::vector<std::vector<float>> &profiles)
+  : bins_{profiles.empty() ? 0 : profiles.front().size()}
+  , points_{profiles.size()}
+  , altitudes_(bins_ * points_)
+{
+  for (size_t p = 0; p < points_; p++) {
+    if (profiles[p].size() != bins_) throw std::runtime_error("The horizon profiles have different numbers of bins");
+    for (size_t b = 0; b < bins_; b++) {
+      altitudes_[b * points_ + p] = profiles[p][b];
+    }
+  }
+}
+
+std::vector<uint8_t> quavis::HorizonProfiles::compute_sunlit(const std::vector<float> &azimuths, const std::vector<float> &altitudes) const
+{
+  if (azimuths.size() != altitudes.size()) throw std::runtime_error("The sun positions need an azimuth and an altitude each");
+
+  const float two_pi = 6.2831853f;
+  std::vector<uint8_t> sunlit(azimuths.size() * points_, 0);
+  for (size_t s = 0; s < azimuths.size(); s++) {
+    const float altitude = altitudes[s];
+    if (altitude <= 0.0f || bins_ == 0) continue;
+
+    // the profile values of all points in the bin of the sun are contiguous
+    float azimuth = std::fmod(azimuths[s], two_pi);
+    if (azimuth < 0.0f) azimuth += two_pi;
+    const size_t bin = std::min(bins_ - 1, static_cast<size_t>(azimuth / two_pi * static_cast<float>(bins_)));
+    const float *horizon = &altitudes_[bin * points_];
+    uint8_t *flags       = &sunlit[s * points_];
+
+    size_t p = 0;
+#ifdef __SSE2__
+    // 16 points per iteration, the compare masks are packed to one byte per point
+    const __m128 sun = _mm_set1_ps(altitude);
+    const __m128i one = _mm_set1_epi8(1);
+    for (; p + 16 <= points_; p += 16) {
+      const __m128i m0 = _mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(horizon + p), sun));
+      const __m128i m1 = _mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(horizon + p + 4), sun));
+      const __m128i m2 = _mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(horizon + p + 8), sun));
+      const __m128i m3 = _mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(horizon + p + 12), sun));
+      const __m128i bytes = _mm_packs_epi16(_mm_packs_epi32(m0, m1), _mm_packs_epi32(m2, m3));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(flags + p), _mm_and_si128(bytes, one));
+    }
+#endif
+    for (; p < points_; p++) {
+      flags[p] = horizon[p] < altitude ? 1 : 0;
+    }
+  }
+  return sunlit;
+}
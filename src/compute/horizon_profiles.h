@@ -0,0 +1,30 @@
+#ifndef QUAVIS_COMPUTE_HORIZON_PROFILES
+#define QUAVIS_COMPUTE_HORIZON_PROFILES
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace quavis {
+/// The horizon profiles of a set of observation points (the values of the horizon stage), to test any sun positions against them on the CPU
+/// without rendering again. The profiles are stored per bin, so one sun position is tested for several points at once with SIMD instructions
+class HorizonProfiles {
+ public:
+  /// one profile per observation point, all with the same number of bins
+  explicit HorizonProfiles(const std::vector<std::vector<float>> &profiles);
+
+  /// number of observation points
+  size_t size() const { return points_; }
+
+  /// per sun position (radians, azimuth and altitude as in the sun stages) and observation point, 1 if the sun is above the horizon profile of the
+  /// point and 0 otherwise. The flags of a sun position are contiguous, the flag of point p and sun s is at s * size() + p
+  std::vector<uint8_t> compute_sunlit(const std::vector<float> &azimuths, const std::vector<float> &altitudes) const;
+
+ private:
+  size_t bins_;
+  size_t points_;
+  std::vector<float> altitudes_;  ///< the profiles, bin major
+};
+}  // namespace quavis
+
+#endif
@@ -0,0 +1,139 @@
+#include "result_interpolation.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+quavis::ResultInterpolation::ResultInterpolation(const std::vector<glm::vec3> &positions, const std::vector<size_t> &keys, float spacing,
+                                                 float tolerance)
+  : positions_{positions}
+  , keys_{keys}
+  , spacing_{spacing}
+  , tolerance_{tolerance}
+  , exact_(positions.size(), false)
+  , values_(positions.size())
+{
+  assert(positions_.size() == keys_.size());
+  assert(spacing_ > 0.0f);
+}
+
+std::vector<size_t> quavis::ResultInterpolation::get_coarse_samples() const
+{
+  std::map<std::pair<CellKey, size_t>, size_t> best;
+  for (size_t i = 0; i < positions_.size(); i++) {
+    const auto cell   = get_cell(positions_[i]);
+    const auto center = (glm::floor(positions_[i] / spacing_) + 0.5f) * spacing_;
+
+    auto it = best.find(std::make_pair(cell, keys_[i]));
+    if (it == best.end()) {
+      best.emplace(std::make_pair(cell, keys_[i]), i);
+    } else if (glm::distance(positions_[i], center) < glm::distance(positions_[it->second], center)) {
+      it->second = i;
+    }
+  }
+
+  std::vector<size_t> samples;
+  for (const auto &b : best) {
+    samples.push_back(b.second);
+  }
+  std::sort(samples.begin(), samples.end());
+  return samples;
+}
+
+void quavis::ResultInterpolation::set_exact(size_t i, const std::vector<std::vector<float>> &values)
+{
+  if (!exact_[i]) exact_cells_[get_cell(positions_[i])].push_back(i);
+  exact_[i]  = true;
+  values_[i] = values;
+}
+
+std::vector<size_t> quavis::ResultInterpolation::get_refinement() const
+{
+  std::vector<size_t> refinement;
+  for (size_t i = 0; i < positions_.size(); i++) {
+    if (exact_[i]) continue;
+
+    const auto neighbours = get_neighbours(i);
+    if (neighbours.size() < 2 || get_spread(neighbours) > tolerance_) refinement.push_back(i);
+  }
+  return refinement;
+}
+
+std::vector<std::pair<size_t, float>> quavis::ResultInterpolation::get_weights(size_t i) const
+{
+  std::vector<std::pair<size_t, float>> weights;
+  float sum = 0.0f;
+  for (auto n : get_neighbours(i)) {
+    const float d = std::max(glm::distance(positions_[i], positions_[n]), 1e-3f * spacing_);
+    weights.emplace_back(n, 1.0f / (d * d));
+    sum += weights.back().second;
+  }
+  for (auto &w : weights) {
+    w.second /= sum;
+  }
+  return weights;
+}
+
+quavis::ResultInterpolation::CellKey quavis::ResultInterpolation::get_cell(const glm::vec3 &position) const
+{
+  const glm::vec3 c = glm::floor(position / spacing_);
+  return std::make_tuple(static_cast<int64_t>(c.x), static_cast<int64_t>(c.y), static_cast<int64_t>(c.z));
+}
+
+std::vector<size_t> quavis::ResultInterpolation::get_neighbours(size_t i) const
+{
+  std::vector<size_t> neighbours;
+  const auto cell = get_cell(positions_[i]);
+  for (int64_t x = -2; x <= 2; x++) {
+    for (int64_t y = -2; y <= 2; y++) {
+      for (int64_t z = -2; z <= 2; z++) {
+        auto it = exact_cells_.find(std::make_tuple(std::get<0>(cell) + x, std::get<1>(cell) + y, std::get<2>(cell) + z));
+        if (it == exact_cells_.end()) continue;
+
+        for (auto n : it->second) {
+          if (keys_[n] == keys_[i] && glm::distance(positions_[i], positions_[n]) <= 2.0f * spacing_) neighbours.push_back(n);
+        }
+      }
+    }
+  }
+
+  // only the closest ones, so refined points shield the points behind them from samples across an edge
+  const size_t max_neighbours = 4;
+  if (neighbours.size() > max_neighbours) {
+    std::partial_sort(neighbours.begin(), neighbours.begin() + max_neighbours, neighbours.end(), [&](size_t a, size_t b) {
+      return glm::distance(positions_[i], positions_[a]) < glm::distance(positions_[i], positions_[b]);
+    });
+    neighbours.resize(max_neighbours);
+  }
+  return neighbours;
+}
+
+float quavis::ResultInterpolation::get_spread(const std::vector<size_t> &points) const
+{
+  const auto &first = values_[points.front()];
+  for (auto p : points) {
+    if (values_[p].size() != first.size()) return std::numeric_limits<float>::infinity();
+    for (size_t s = 0; s < first.size(); s++) {
+      if (values_[p][s].size() != first[s].size()) return std::numeric_limits<float>::infinity();
+    }
+  }
+
+  float spread = 0.0f;
+  for (size_t s = 0; s < first.size(); s++) {
+    float difference = 0.0f;
+    float magnitude  = 0.0f;
+    for (size_t v = 0; v < first[s].size(); v++) {
+      float min_value = first[s][v];
+      float max_value = first[s][v];
+      for (auto p : points) {
+        min_value = std::min(min_value, values_[p][s][v]);
+        max_value = std::max(max_value, values_[p][s][v]);
+      }
+      difference += max_value - min_value;
+      magnitude += std::max(std::abs(min_value), std::abs(max_value));
+    }
+    if (difference > 0.0f) spread = std::max(spread, difference / std::max(magnitude, std::numeric_limits<float>::min()));
+  }
+  return spread;
+}
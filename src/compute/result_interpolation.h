@@ -0,0 +1,55 @@
+#ifndef QUAVIS_COMPUTE_RESULT_INTERPOLATION
+#define QUAVIS_COMPUTE_RESULT_INTERPOLATION
+
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace quavis {
+/// Approximates the results of dense observation points from a subset of exactly computed points. One point per grid cell of size spacing is
+/// computed first, the others are interpolated by inverse distance weighting from the 4 closest exact points within two spacings. Wherever
+/// these neighbouring samples differ by more than the relative tolerance (or there are fewer than two) the point is computed exactly, until no
+/// point needs refinement.
+class ResultInterpolation {
+ public:
+  /// values are only interpolated between points of the same key (e.g. the same view direction and sun positions)
+  ResultInterpolation(const std::vector<glm::vec3> &positions, const std::vector<size_t> &keys, float spacing, float tolerance);
+
+  /// the points to compute exactly first, the one closest to the center of each cell and key
+  std::vector<size_t> get_coarse_samples() const;
+
+  /// stores the exact values of point i, one vector per compute stage
+  void set_exact(size_t i, const std::vector<std::vector<float>> &values);
+
+  /// the points that are not exact and cannot be interpolated within the tolerance, empty when all remaining points can be interpolated
+  std::vector<size_t> get_refinement() const;
+
+  bool is_exact(size_t i) const { return exact_[i]; }
+
+  /// inverse distance weights (summing to 1) of the exact points next to point i
+  std::vector<std::pair<size_t, float>> get_weights(size_t i) const;
+
+ private:
+  typedef std::tuple<int64_t, int64_t, int64_t> CellKey;
+
+  CellKey get_cell(const glm::vec3 &position) const;
+  /// the closest exact points with the key of point i within two spacings
+  std::vector<size_t> get_neighbours(size_t i) const;
+  /// largest difference of the values of the points relative to their magnitude over all stages, infinite if the number of values differs
+  float get_spread(const std::vector<size_t> &points) const;
+
+  std::vector<glm::vec3> positions_;
+  std::vector<size_t> keys_;
+  float spacing_;
+  float tolerance_;
+
+  std::vector<bool> exact_;
+  std::vector<std::vector<std::vector<float>>> values_;
+  std::map<CellKey, std::vector<size_t>> exact_cells_;  ///< exact points per cell
+};
+}  // namespace quavis
+
+#endif
@@ -0,0 +1,145 @@
+#include "sky_matrix.h"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <stdexcept>
+#include <thread>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace quavis;
+
+const size_t quavis::SkyMatrix::PATCHES;
+
+namespace {
+const float PI = 3.1415926f;
+
+// CIE clear sky model, the constants of the sun stages
+const float CIE_A = -1.0f;
+const float CIE_B = -0.25f;
+const float CIE_C = 16.0f;
+const float CIE_D = -3.0f;
+const float CIE_E = 0.3f;
+
+// patches per band of the Tregenza sky and the index of their first patch, the last band is the zenith cap
+const size_t band_patches[8] = {30, 30, 24, 24, 18, 12, 6, 1};
+const size_t band_first[8]   = {0, 30, 60, 84, 108, 126, 138, 144};
+
+/// c (rows x n) = a (rows x k) * b (k x n), all row major. Blocks of 4 rows and 4 columns are summed in registers, the columns are processed in
+/// blocks that keep their part of b in the cache
+void multiply(const float *a, const float *b, float *c, size_t rows, size_t k, size_t n)
+{
+  const size_t column_block = 256;
+  for (size_t j0 = 0; j0 < n; j0 += column_block) {
+    const size_t j1 = std::min(n, j0 + column_block);
+    size_t i        = 0;
+    for (; i + 4 <= rows; i += 4) {
+      const float *a0 = a + i * k;
+      size_t j        = j0;
+#ifdef __SSE2__
+      for (; j + 4 <= j1; j += 4) {
+        __m128 c0 = _mm_setzero_ps();
+        __m128 c1 = _mm_setzero_ps();
+        __m128 c2 = _mm_setzero_ps();
+        __m128 c3 = _mm_setzero_ps();
+        for (size_t p = 0; p < k; p++) {
+          const __m128 bp = _mm_loadu_ps(b + p * n + j);
+          c0              = _mm_add_ps(c0, _mm_mul_ps(_mm_set1_ps(a0[p]), bp));
+          c1              = _mm_add_ps(c1, _mm_mul_ps(_mm_set1_ps(a0[k + p]), bp));
+          c2              = _mm_add_ps(c2, _mm_mul_ps(_mm_set1_ps(a0[2 * k + p]), bp));
+          c3              = _mm_add_ps(c3, _mm_mul_ps(_mm_set1_ps(a0[3 * k + p]), bp));
+        }
+        _mm_storeu_ps(c + i * n + j, c0);
+        _mm_storeu_ps(c + (i + 1) * n + j, c1);
+        _mm_storeu_ps(c + (i + 2) * n + j, c2);
+        _mm_storeu_ps(c + (i + 3) * n + j, c3);
+      }
+#endif
+      for (; j < j1; j++) {
+        for (size_t r = 0; r < 4; r++) {
+          float sum = 0.0f;
+          for (size_t p = 0; p < k; p++) {
+            sum += a0[r * k + p] * b[p * n + j];
+          }
+          c[(i + r) * n + j] = sum;
+        }
+      }
+    }
+    for (; i < rows; i++) {
+      for (size_t j = j0; j < j1; j++) {
+        float sum = 0.0f;
+        for (size_t p = 0; p < k; p++) {
+          sum += a[i * k + p] * b[p * n + j];
+        }
+        c[i * n + j] = sum;
+      }
+    }
+  }
+}
+}  // namespace
+
+glm::vec2 quavis::SkyMatrix::get_patch_center(size_t patch)
+{
+  size_t band = 0;
+  while (band < 7 && patch >= band_first[band + 1]) band++;
+  if (band == 7) return glm::vec2(0.0f, PI / 2.0f);
+
+  const float band_height = 12.0f * PI / 180.0f;
+  return glm::vec2(static_cast<float>(patch - band_first[band]) * 2.0f * PI / static_cast<float>(band_patches[band]),
+                   (static_cast<float>(band) + 0.5f) * band_height);
+}
+
+quavis::SkyMatrix::SkyMatrix(const std::vector<float> &sun_azimuths, const std::vector<float> &sun_altitudes,
+                             const std::vector<float> &zenith_luminances)
+  : timesteps_{sun_azimuths.size()}
+  , luminances_(PATCHES * sun_azimuths.size())
+{
+  if (sun_altitudes.size() != timesteps_ || zenith_luminances.size() != timesteps_) {
+    throw std::runtime_error("The sky matrix needs a sun azimuth, sun altitude and zenith luminance per time step");
+  }
+
+  const float phi0 = 1.0f + CIE_A * std::exp(CIE_B);
+  for (size_t t = 0; t < timesteps_; t++) {
+    const float z_s = PI / 2.0f - sun_altitudes[t];
+    const float fzs = 1.0f + CIE_C * (std::exp(CIE_D * z_s) - std::exp(CIE_D * PI / 2.0f)) + CIE_E * std::pow(std::cos(z_s), 2.0f);
+
+    for (size_t p = 0; p < PATCHES; p++) {
+      const glm::vec2 center = get_patch_center(p);
+      const float z          = PI / 2.0f - center.y;
+      const float cos_chi =
+        std::cos(z_s) * std::cos(z) + std::sin(z_s) * std::sin(z) * std::cos(std::abs(center.x - sun_azimuths[t]));
+      const float chi  = std::acos(std::max(-1.0f, std::min(1.0f, cos_chi)));
+      const float fchi = 1.0f + CIE_C * (std::exp(CIE_D * chi) - std::exp(CIE_D * PI / 2.0f)) + CIE_E * std::pow(std::cos(chi), 2.0f);
+      const float phiz = z > 0.0f ? 1.0f + CIE_A * std::exp(CIE_B / z) : 1.0f;
+
+      // negative values are left out, as by the sun stages
+      luminances_[p * timesteps_ + t] = std::max(0.0f, fchi * phiz / (fzs * phi0) * zenith_luminances[t]);
+    }
+  }
+}
+
+std::vector<float> quavis::SkyMatrix::integrate(const std::vector<float> &visibility, size_t workers) const
+{
+  if (visibility.size() % PATCHES != 0) throw std::runtime_error("The sky visibility needs " + std::to_string(PATCHES) + " values per observation");
+
+  const size_t observations = visibility.size() / PATCHES;
+  std::vector<float> result(observations * timesteps_);
+
+  // chunks of observations in multiples of the 4 rows summed together
+  if (workers == 0) workers = std::max(1u, std::thread::hardware_concurrency());
+  const size_t chunk = std::max<size_t>(4, (observations + workers - 1) / workers + 3) / 4 * 4;
+  std::vector<std::future<void>> tasks;
+  for (size_t first = 0; first < observations; first += chunk) {
+    const size_t rows = std::min(chunk, observations - first);
+    tasks.push_back(std::async(std::launch::async, [&, first, rows]() {
+      multiply(&visibility[first * PATCHES], luminances_.data(), &result[first * timesteps_], rows, PATCHES, timesteps_);
+    }));
+  }
+  for (auto &task : tasks) {
+    task.get();
+  }
+  return result;
+}
@@ -0,0 +1,38 @@
+#ifndef QUAVIS_COMPUTE_SKY_MATRIX
+#define QUAVIS_COMPUTE_SKY_MATRIX
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace quavis {
+/// The luminance of the CIE clear sky (as computed by the sun stages) at the center of each Tregenza patch, for a series of time steps. The 145
+/// patches are 7 bands of 12 degrees altitude with 30, 30, 24, 24, 18, 12 and 6 patches from the horizon up, and the zenith cap above 84 degrees.
+/// The first patch of a band is centered on azimuth 0, the azimuth grows as in the sun stages. Multiplied with the visible solid angle per patch
+/// of the observation points (the values of the skyPatches stage) it gives the sky luminance integrated over the visible sky for all time steps
+/// at once, instead of a sun stage computation per time step
+class SkyMatrix {
+ public:
+  static const size_t PATCHES = 145;
+
+  /// azimuth and altitude (radians) of the center of the patch
+  static glm::vec2 get_patch_center(size_t patch);
+
+  /// one time step per sun azimuth, sun altitude (radians) and zenith luminance
+  SkyMatrix(const std::vector<float> &sun_azimuths, const std::vector<float> &sun_altitudes, const std::vector<float> &zenith_luminances);
+
+  size_t get_timesteps() const { return timesteps_; }
+
+  /// the product of the visible solid angles (observations x PATCHES, row major) with the sky matrix, the luminance integrated over the visible
+  /// sky (observations x time steps, row major). The observations are split over workers threads (0 for all cores), each multiplies with SIMD
+  /// instructions
+  std::vector<float> integrate(const std::vector<float> &visibility, size_t workers = 0) const;
+
+ private:
+  size_t timesteps_;
+  std::vector<float> luminances_;  ///< PATCHES x time steps, row major
+};
+}  // namespace quavis
+
+#endif
@@ -0,0 +1,188 @@
+#include "sky_patches.h"
+
+#include "sky_matrix.h"
+
+using namespace quavis;
+
+quavis::ComputeSkyPatches::ComputeSkyPatches(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2 &image_dim,
+                                             const std::vector<std::string> &defines)
+  : image_dim_{image_dim}
+  , ComputeBaseGPU<ComputeSkyPatchesParams>(device_ptr, create_compute_stages(image_dim), defines)
+{
+}
+
+const quavis::ComputeSkyPatchesParams quavis::ComputeSkyPatches::get_parameter()
+{
+  ComputeSkyPatchesParams par;
+  par.height = image_dim_.y;
+  par.width  = image_dim_.x;
+  return par;
+}
+
+std::vector<quavis::ComputeShaderStage> quavis::ComputeSkyPatches::create_compute_stages(const glm::ivec2 &image_dim)
+{
+  std::vector<quavis::ComputeShaderStage> stages;
+  ComputeShaderStage stage;
+  stage.shader_code =
+    R"(
+		#version 450
+
+		// constants
+		#define N_LOCAL 16
+		#define PI 3.1415926
+		#define PATCHES 145
+
+		layout (local_size_x = N_LOCAL, local_size_y = 1, local_size_z = 1) in;
+
+#ifndef QUAVIS_TARGET_FORMAT
+		// color and distance (see TargetLayout)
+		#define QUAVIS_TARGET_FORMAT rgba32f
+		#define QUAVIS_TARGET_DISTANCE a
+#endif
+#ifdef QUAVIS_SAMPLES
+		layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DMSArray colorImage;
+#else
+		layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DArray colorImage;
+#endif
+		// layout (binding = 2) buffer InputBuffer { } input;
+		layout (binding = 3) buffer OutputBuffer {
+		  float values[];
+		} outputs;
+
+		layout(push_constant) uniform Parameters {
+			int width;
+			int height;
+		} parameters;
+
+		// face_size, triangle_solid_angle, cube_weight and face_direction
+		#include "cube_faces.glsl"
+
+		// patches per band of 12 degrees of the Tregenza sky and the index of their first patch, the last band is the zenith cap (see SkyMatrix)
+		const int band_patches[8] = int[8](30, 30, 24, 24, 18, 12, 6, 1);
+		const int band_first[8] = int[8](0, 30, 60, 84, 108, 126, 138, 144);
+
+		// the visible solid angle per patch of each thread of this row
+		shared float partial[N_LOCAL * PATCHES];
+
+		// fraction of the texel p covered by geometry, each sample of a multisampled target covers an equal part of the texel
+		float coverage(ivec3 p) {
+#ifdef QUAVIS_SAMPLES
+			float c = 0.0f;
+			for (int s = 0; s < QUAVIS_SAMPLES; s++) {
+				c += imageLoad(colorImage, p, s).QUAVIS_TARGET_DISTANCE > 0 ? 1.0f : 0.0f;
+			}
+			return c / float(QUAVIS_SAMPLES);
+#else
+			return imageLoad(colorImage, p).QUAVIS_TARGET_DISTANCE > 0 ? 1.0f : 0.0f;
+#endif
+		}
+
+		// Tregenza patch of a direction above the horizon, the first patch of a band is centered on azimuth 0
+		int patch_index(vec3 d) {
+			float altitude = asin(d.z / length(d));
+			int band = min(7, int(altitude / (12.0f*PI/180.0f)));
+			float a = atan(d.y, d.x);
+			a = a < 0.0f ? a + 2.0f*PI : a;
+			int count = band_patches[band];
+			return band_first[band] + int(floor(a / (2.0f*PI) * float(count) + 0.5f)) % count;
+		}
+
+		void main()
+		{
+		  // lower resolution levels only fill the first rows of the image
+		  if (gl_WorkGroupID.y >= uint(parameters.height)) return;
+
+		  uint row = gl_LocalInvocationID.x * PATCHES;
+		  for (uint p = 0; p < PATCHES; p++) {
+			partial[row + p] = 0.0f;
+		  }
+
+		  uint chunksize = parameters.width/N_LOCAL;
+		  uint xpos = gl_LocalInvocationID.x * chunksize;
+		  for (uint x = xpos; x < xpos + chunksize; x++) {
+			float n = float(parameters.width);
+			float m = float(parameters.height);
+			// the downward face (5) is below the horizon and not rendered
+			for (int f = 0; f < 5; f++) {
+#ifdef QUAVIS_FACE_SIZES
+			  // texels outside of the resolution of the face are not rendered
+			  if (x >= uint(face_size[f].x) || gl_WorkGroupID.y >= uint(face_size[f].y)) continue;
+			  n = float(face_size[f].x);
+			  m = float(face_size[f].y);
+#endif
+			  float sky = 1.0f - coverage(ivec3(x, gl_WorkGroupID.y, f));
+			  if (sky <= 0.0f) continue;
+
+			  float v = 2.0f*(float(x) + 0.5f)/n - 1.0f;
+			  float u = 2.0f*(float(gl_WorkGroupID.y) + 0.5f)/m - 1.0f;
+			  vec3 d = face_direction(f, v, u);
+			  if (d.z <= 0.0f) continue;
+
+			  partial[row + patch_index(d)] += sky*cube_weight(float(x), float(gl_WorkGroupID.y), n, m);
+			}
+		  }
+		  barrier();
+
+		  for (uint p = gl_LocalInvocationID.x; p < PATCHES; p += N_LOCAL) {
+			float sum = 0.0f;
+			for (uint t = 0; t < N_LOCAL; t++) {
+			  sum += partial[t * PATCHES + p];
+			}
+			outputs.values[gl_WorkGroupID.y * PATCHES + p] = sum;
+		  }
+		}
+		)";
+  stage.work_group_size             = glm::vec3(1, image_dim.y, 1);
+  stage.input_buffer_size           = 0;
+  stage.output_buffer_size          = image_dim.y * SkyMatrix::PATCHES * sizeof(float);
+  stage.has_shader_parameters       = true;
+  stage.input_color_cube            = true;
+  stage.retrieve_output_buffer_size = 0;
+  stages.push_back(stage);
+
+  stage.shader_code =
+    R"(
+		#version 450
+
+		// constants
+		#define N_LOCAL 64
+		#define PATCHES 145
+
+		layout (local_size_x = N_LOCAL, local_size_y = 1, local_size_z = 1) in;
+
+		layout (binding = 2) buffer InputBuffer {
+			float values[];
+		} inputs;
+
+		layout (binding = 3) buffer OutputBuffer {
+		  float values[];
+		} outputs;
+
+		layout(push_constant) uniform Parameters {
+			int width;
+			int height;
+		} parameters;
+
+		void main()
+		{
+		  // the visible solid angle of a patch is the sum over all rows
+		  uint p = gl_GlobalInvocationID.x;
+		  if (p >= PATCHES) return;
+
+		  float sum = 0.0f;
+		  for (int y = 0; y < parameters.height; y++) {
+			sum += inputs.values[y * PATCHES + p];
+		  }
+		  outputs.values[p] = sum;
+		}
+		)";
+  stage.work_group_size             = glm::vec3((SkyMatrix::PATCHES + 63) / 64, 1, 1);
+  stage.input_buffer_size           = image_dim.y * SkyMatrix::PATCHES * sizeof(float);
+  stage.output_buffer_size          = SkyMatrix::PATCHES * sizeof(float);
+  stage.has_shader_parameters       = true;
+  stage.input_color_cube            = false;
+  stage.retrieve_output_buffer_size = SkyMatrix::PATCHES * sizeof(float);
+  stages.push_back(stage);
+
+  return stages;
+}
@@ -0,0 +1,29 @@
+#ifndef QUAVIS_COMPUTE_SKY_PATCHES
+#define QUAVIS_COMPUTE_SKY_PATCHES
+
+#include "./compute_base.h"
+
+namespace quavis {
+struct ComputeSkyPatchesParams {
+  int width;
+  int height;
+};
+
+/// The visible sky of an observation point per Tregenza patch (see SkyMatrix), the solid angle (steradians) of the uncovered texels above the
+/// horizon whose center lies in the patch. Together with a SkyMatrix it gives the sky luminance for any number of sun positions
+class ComputeSkyPatches : public ComputeBaseGPU<ComputeSkyPatchesParams> {
+ public:
+  ComputeSkyPatches(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2& image_dim, const std::vector<std::string>& defines = {});
+
+  virtual const ComputeSkyPatchesParams get_parameter() override;
+  virtual void set_resolution(const glm::ivec2& resolution) override { image_dim_ = resolution; }
+  virtual DirectionDomain get_direction_domain() const override { return DirectionDomain::UPPER_HEMISPHERE; }
+
+ private:
+  glm::ivec2 image_dim_;
+
+  std::vector<ComputeShaderStage> create_compute_stages(const glm::ivec2& image_dim);
+};
+}  // namespace quavis
+
+#endif
@@ -2,9 +2,10 @@
 
 using namespace quavis;
 
-quavis::ComputeSun::ComputeSun(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2 &image_dim, const bool use_v2)
+quavis::ComputeSun::ComputeSun(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2 &image_dim, const bool use_v2,
+                               const std::vector<std::string> &defines)
   : image_dim_{image_dim}
-  , ComputeBaseGPU<ComputeSunParams>(device_ptr, create_compute_stages(image_dim, use_v2))
+  , ComputeBaseGPU<ComputeSunParams>(device_ptr, create_compute_stages(image_dim, use_v2), defines)
 {
 }
 
@@ -13,7 +14,6 @@ const quavis::ComputeSunParams quavis::ComputeSun::get_parameter()
   ComputeSunParams par;
   par.height = image_dim_.y;
   par.width  = image_dim_.x;
-  par.r_max  = 1.0f;
   return par;
 }
 
@@ -47,7 +47,16 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeSun::create_compute_stage
 
 		layout (local_size_x = N_LOCAL, local_size_y = 1, local_size_z = 1) in;
 
-		layout (binding = 0, rgba32f) uniform readonly image2DArray colorImage;
+#ifndef QUAVIS_TARGET_FORMAT
+		// color and distance (see TargetLayout)
+		#define QUAVIS_TARGET_FORMAT rgba32f
+		#define QUAVIS_TARGET_DISTANCE a
+#endif
+#ifdef QUAVIS_SAMPLES
+		layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DMSArray colorImage;
+#else
+		layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DArray colorImage;
+#endif
 		layout (binding = 1, rg32f) uniform readonly image2DArray depthImage;
 		// layout (binding = 2) buffer InputBuffer { } input;
 		layout (binding = 3) buffer OutputBuffer {
@@ -62,6 +71,22 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeSun::create_compute_stage
 			float zenith_luminance;
 		} parameters;
 
+		// face_size, triangle_solid_angle, cube_weight and face_direction
+		#include "cube_faces.glsl"
+
+		// fraction of the texel p that sees the sky, each sample of a multisampled target covers an equal part of the texel
+		float sky_fraction(ivec3 p) {
+#ifdef QUAVIS_SAMPLES
+			float c = 0.0f;
+			for (int s = 0; s < QUAVIS_SAMPLES; s++) {
+				c += imageLoad(colorImage, p, s).r != 0 ? 0.0f : 1.0f;
+			}
+			return c / float(QUAVIS_SAMPLES);
+#else
+			return imageLoad(colorImage, p).r != 0 ? 0.0f : 1.0f;
+#endif
+		}
+
 		shared float tmp_local[N_LOCAL];
 
 		vec2 project(vec3 position) {
@@ -83,6 +108,9 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeSun::create_compute_stage
 
 		void main()
 		{
+		  // lower resolution levels only fill the first rows of the image
+		  if (gl_WorkGroupID.y >= uint(parameters.height)) return;
+
 			for (int i = 0; i < N_LOCAL; i++) {
 				tmp_local[i] = 0.0;
 			}
@@ -102,42 +130,36 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeSun::create_compute_stage
 			  j = float(gl_WorkGroupID.y);
 			  n = float(parameters.width);
 			  m = float(parameters.height);
-			  float weight =  4.0f/n/m/sqrt(pow((3.0f + 4.0f*j*(j-m)/m/m + 4.0f*i*(i-n)/n/n), 3.0f));
+			  float weight = cube_weight(i, j, n, m);
 
 				// compute pixel direction (cartesian)
-				float v = 2*(float(x)/parameters.width - 0.5);
-				float u = 2*(float(gl_WorkGroupID.y)/parameters.height - 0.5);
+				float v = 2*((float(x) + 0.5)/parameters.width - 0.5);
+				float u = 2*((float(gl_WorkGroupID.y) + 0.5)/parameters.height - 0.5);
 
 				vec2 pv; // pixel direction
 				vec4 rgba;
 				float Z, chi, fchi, phiz, azimuth, altitude;
-				for (uint i = 0; i < 6; i++) {
-					if (imageLoad(colorImage, ivec3(x, gl_WorkGroupID.y, i)).r != 0) continue;
-
-					if (i == 0) {
-						pv = project(vec3(1, v, -u));
-					}
-					else if (i == 1) {
-						pv = project(vec3(-1, v, u));
-					}
-					else if (i == 2) {
-						pv = project(vec3(-v, 1, -u));
-					}
-					else if (i == 3) {
-						pv = project(vec3(v, -1, -u));
-					}
-					else if (i == 4) {
-						pv = project(vec3(u, v, 1));
-					}
-					else if (i == 5) {
-						pv = project(vec3(-u, v, -1));
-					}
+				// the downward face (5) is below the horizon and not rendered
+				for (uint i = 0; i < 5; i++) {
+#ifdef QUAVIS_FACE_SIZES
+					// texels outside of the resolution of the face are not rendered
+					if (x >= uint(face_size[i].x) || gl_WorkGroupID.y >= uint(face_size[i].y)) continue;
+					n = float(face_size[i].x);
+					m = float(face_size[i].y);
+					weight = cube_weight(float(x), j, n, m);
+					v = 2*((float(x) + 0.5)/n - 0.5);
+					u = 2*((float(gl_WorkGroupID.y) + 0.5)/m - 0.5);
+#endif
+					float sky = sky_fraction(ivec3(x, gl_WorkGroupID.y, i));
+					if (sky == 0) continue;
+
+					pv = project(face_direction(int(i), v, u));
 					// pixel parameters
 					azimuth = pv[0];
 					altitude = pv[1];
 
 					if (azimuth == 0) continue;
-					if (altitude == 0) continue;
+					if (altitude <= 0) continue;
 
 					// Compute CIE model
 					Z = PI/2.0 - altitude;
@@ -146,7 +168,7 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeSun::create_compute_stage
 					phiz = 1 + CIE_A * exp(CIE_B / Z);
 
 					float val = fchi*phiz/(fzs*phi0)*parameters.zenith_luminance;
-					if (val > 0) tmp += val*weight;
+					if (val > 0) tmp += val*weight*sky;
 				}
 		  }
 			tmp_local[gl_LocalInvocationID.x] = tmp;
@@ -183,7 +205,14 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeSun::create_compute_stage
 
 		layout (local_size_x = 1, local_size_y = N_LOCAL, local_size_z = 1) in;
 
-		layout (binding = 0, rgba32f) uniform readonly image2DArray colorImage;
+#ifndef QUAVIS_TARGET_FORMAT
+		#define QUAVIS_TARGET_FORMAT rgba32f
+#endif
+#ifdef QUAVIS_SAMPLES
+		layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DMSArray colorImage;
+#else
+		layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DArray colorImage;
+#endif
 		// layout (binding = 1, rg32f) uniform readonly image2DArray depthImage;
 		layout (binding = 2) buffer InputBuffer { 
 			float values[];
@@ -255,7 +284,16 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeSun::create_compute_stage
 
 		layout (local_size_x = N_LOCAL, local_size_y = 1, local_size_z = 1) in;
 
-		layout (binding = 0, rgba32f) uniform readonly image2DArray colorImage;
+#ifndef QUAVIS_TARGET_FORMAT
+		// color and distance (see TargetLayout)
+		#define QUAVIS_TARGET_FORMAT rgba32f
+		#define QUAVIS_TARGET_DISTANCE a
+#endif
+#ifdef QUAVIS_SAMPLES
+		layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DMSArray colorImage;
+#else
+		layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DArray colorImage;
+#endif
 		layout (binding = 1, rg32f) uniform readonly image2DArray depthImage;
 		// layout (binding = 2) buffer InputBuffer { } input;
 		layout (binding = 3) buffer OutputBuffer {
@@ -270,6 +308,22 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeSun::create_compute_stage
 			float zenith_luminance;
 		} parameters;
 
+		// face_size, triangle_solid_angle, cube_weight and face_direction
+		#include "cube_faces.glsl"
+
+		// fraction of the texel p that sees the sky, each sample of a multisampled target covers an equal part of the texel
+		float sky_fraction(ivec3 p) {
+#ifdef QUAVIS_SAMPLES
+			float c = 0.0f;
+			for (int s = 0; s < QUAVIS_SAMPLES; s++) {
+				c += imageLoad(colorImage, p, s).r != 0 ? 0.0f : 1.0f;
+			}
+			return c / float(QUAVIS_SAMPLES);
+#else
+			return imageLoad(colorImage, p).r != 0 ? 0.0f : 1.0f;
+#endif
+		}
+
 		shared float tmp_local[N_LOCAL];
 
 		vec2 project(vec3 position) {
@@ -291,6 +345,9 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeSun::create_compute_stage
 
 		void main()
 		{
+		  // lower resolution levels only fill the first rows of the image
+		  if (gl_WorkGroupID.y >= uint(parameters.height)) return;
+
 			for (int i = 0; i < N_LOCAL; i++) {
 				tmp_local[i] = 0.0;
 			}
@@ -310,42 +367,36 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeSun::create_compute_stage
 			  j = float(gl_WorkGroupID.y);
 			  n = float(parameters.width);
 			  m = float(parameters.height);
-			  float weight =  4.0f/n/m/sqrt(pow((3.0f + 4.0f*j*(j-m)/m/m + 4.0f*i*(i-n)/n/n), 3.0f));
+			  float weight = cube_weight(i, j, n, m);
 
 				// compute pixel direction (cartesian)
-				float v = 2*(float(x)/parameters.width - 0.5);
-				float u = 2*(float(gl_WorkGroupID.y)/parameters.height - 0.5);
+				float v = 2*((float(x) + 0.5)/parameters.width - 0.5);
+				float u = 2*((float(gl_WorkGroupID.y) + 0.5)/parameters.height - 0.5);
 
 				vec2 pv; // pixel direction
 				vec4 rgba;
 				float Z, chi, fchi, phiz, azimuth, altitude;
-				for (uint i = 0; i < 6; i++) {
-					if (imageLoad(colorImage, ivec3(x, gl_WorkGroupID.y, i)).r != 0) continue;
-
-					if (i == 0) {
-						pv = project(vec3(1, v, -u));
-					}
-					else if (i == 1) {
-						pv = project(vec3(-1, v, u));
-					}
-					else if (i == 2) {
-						pv = project(vec3(-v, 1, -u));
-					}
-					else if (i == 3) {
-						pv = project(vec3(v, -1, -u));
-					}
-					else if (i == 4) {
-						pv = project(vec3(u, v, 1));
-					}
-					else if (i == 5) {
-						pv = project(vec3(-u, v, -1));
-					}
+				// the downward face (5) is below the horizon and not rendered
+				for (uint i = 0; i < 5; i++) {
+#ifdef QUAVIS_FACE_SIZES
+					// texels outside of the resolution of the face are not rendered
+					if (x >= uint(face_size[i].x) || gl_WorkGroupID.y >= uint(face_size[i].y)) continue;
+					n = float(face_size[i].x);
+					m = float(face_size[i].y);
+					weight = cube_weight(float(x), j, n, m);
+					v = 2*((float(x) + 0.5)/n - 0.5);
+					u = 2*((float(gl_WorkGroupID.y) + 0.5)/m - 0.5);
+#endif
+					float sky = sky_fraction(ivec3(x, gl_WorkGroupID.y, i));
+					if (sky == 0) continue;
+
+					pv = project(face_direction(int(i), v, u));
 					// pixel parameters
 					azimuth = pv[0];
 					altitude = pv[1];
 
 					if (azimuth == 0) continue;
-					if (altitude == 0) continue;
+					if (altitude <= 0) continue;
 
 					// Compute CIE model
 					Z = PI/2.0 - altitude;
@@ -354,7 +405,7 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeSun::create_compute_stage
 					phiz = 1 + CIE_A * exp(CIE_B / Z);
 
 					float val = fchi*phiz/(fzs*phi0)*parameters.zenith_luminance;
-					if (val > 0) tmp += val*weight;
+					if (val > 0) tmp += val*weight*sky;
 				}
 		  }
 			tmp_local[gl_LocalInvocationID.x] = tmp;
@@ -391,7 +442,14 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeSun::create_compute_stage
 
 		layout (local_size_x = 1, local_size_y = N_LOCAL, local_size_z = 1) in;
 
-		layout (binding = 0, rgba32f) uniform readonly image2DArray colorImage;
+#ifndef QUAVIS_TARGET_FORMAT
+		#define QUAVIS_TARGET_FORMAT rgba32f
+#endif
+#ifdef QUAVIS_SAMPLES
+		layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DMSArray colorImage;
+#else
+		layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DArray colorImage;
+#endif
 		// layout (binding = 1, rg32f) uniform readonly image2DArray depthImage;
 		layout (binding = 2) buffer InputBuffer { 
 			float values[];
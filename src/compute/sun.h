@@ -7,7 +7,6 @@ namespace quavis {
 struct ComputeSunParams {
   int width;
   int height;
-  float r_max;
   float sun_azimuth_rad; // 0 = north, 1/2pi = east, pi = south, 3/2pi = west
   float sun_altitude_rad; // 0 = horizon, 1/2pi = zenith
   float zenith_luminance;
@@ -15,12 +14,15 @@ struct ComputeSunParams {
 
 class ComputeSun : public ComputeBaseGPU<ComputeSunParams> {
  public:
-  ComputeSun(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2& image_dim, const bool use_v2);
+  ComputeSun(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2& image_dim, const bool use_v2,
+             const std::vector<std::string>& defines = {});
 
   virtual const ComputeSunParams get_parameter() override;
+  virtual void set_resolution(const glm::ivec2& resolution) override { image_dim_ = resolution; }
+  virtual DirectionDomain get_direction_domain() const override { return DirectionDomain::UPPER_HEMISPHERE; }
 
  private:
-  const glm::ivec2 image_dim_;
+  glm::ivec2 image_dim_;
 
   std::vector<ComputeShaderStage> create_compute_stages(const glm::ivec2& image_dim, const bool use_v2);
   std::vector<ComputeShaderStage> create_compute_stages_v1(const glm::ivec2& image_dim);
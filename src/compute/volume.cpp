@@ -2,9 +2,9 @@
 
 using namespace quavis;
 
-quavis::ComputeVolume::ComputeVolume(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2 &image_dim)
+quavis::ComputeVolume::ComputeVolume(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2 &image_dim, const std::vector<std::string> &defines)
   : image_dim_{image_dim}
-  , ComputeBaseGPU<ComputeVolumeParams>(device_ptr, create_compute_stages(image_dim))
+  , ComputeBaseGPU<ComputeVolumeParams>(device_ptr, create_compute_stages(image_dim), defines)
 {
 }
 
@@ -31,7 +31,16 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeVolume::create_compute_st
 
 		layout (local_size_x = N_LOCAL, local_size_y = 1, local_size_z = 1) in;
 
-		layout (binding = 0, rgba32f) uniform readonly image2DArray colorImage;
+#ifndef QUAVIS_TARGET_FORMAT
+		// color and distance (see TargetLayout)
+		#define QUAVIS_TARGET_FORMAT rgba32f
+		#define QUAVIS_TARGET_DISTANCE a
+#endif
+#ifdef QUAVIS_SAMPLES
+		layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DMSArray colorImage;
+#else
+		layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DArray colorImage;
+#endif
 		layout (binding = 1, rg32f) uniform readonly image2DArray depthImage;
 		// layout (binding = 2) buffer InputBuffer { } input;
 		layout (binding = 3) buffer OutputBuffer {
@@ -46,8 +55,56 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeVolume::create_compute_st
 
 		shared float tmp_local[N_LOCAL];
 
+		// face_size, triangle_solid_angle and cube_weight
+		#include "cube_faces.glsl"
+
+		// cubed distance of the texel p, the mean over the samples of a multisampled target
+		float cubed_distance(ivec3 p) {
+#if defined(QUAVIS_REDUCED)
+			// a level of the reduction pyramid holds the mean cubed distance in g
+			return pow(parameters.r_max, 3)*imageLoad(colorImage, p).g;
+#elif defined(QUAVIS_SAMPLES)
+			float d = 0.0f;
+			for (int s = 0; s < QUAVIS_SAMPLES; s++) {
+				d += pow(parameters.r_max*imageLoad(colorImage, p, s).QUAVIS_TARGET_DISTANCE, 3);
+			}
+			return d / float(QUAVIS_SAMPLES);
+#else
+			return pow(parameters.r_max*imageLoad(colorImage, p).QUAVIS_TARGET_DISTANCE, 3);
+#endif
+		}
+
+#ifdef QUAVIS_OCTAHEDRAL
+		// point on the octahedron |x|+|y|+|z| = 1 at the octahedral map coordinates q in [-1, 1]^2
+		vec3 octahedron_point(vec2 q) {
+			float z = 1.0f - abs(q.x) - abs(q.y);
+			// the lower hemisphere is folded into the corners
+			return z >= 0.0f ? vec3(q, z) : vec3(sign(q.x)*(1.0f - abs(q.y)), sign(q.y)*(1.0f - abs(q.x)), z);
+		}
+
+		// exact solid angle of the texel (i, j) of an n x m octahedral map (n, m even). The texel is split along its diagonal parallel to the
+		// folding edge of its quadrant, so both halves lie in one octant and are flat triangles on the octahedron
+		float octahedral_weight(float i, float j, float n, float m) {
+			vec2 q0 = vec2(2.0f*i/n - 1.0f, 2.0f*j/m - 1.0f);
+			vec2 q1 = q0 + vec2(2.0f/n, 2.0f/m);
+			vec3 p00 = octahedron_point(q0);
+			vec3 p10 = octahedron_point(vec2(q1.x, q0.y));
+			vec3 p01 = octahedron_point(vec2(q0.x, q1.y));
+			vec3 p11 = octahedron_point(q1);
+
+			vec2 s = sign(q0 + q1);
+			if (s.x == s.y) {
+				return triangle_solid_angle(p10, p01 - p10, p00 - p10) + triangle_solid_angle(p10, p11 - p10, p01 - p10);
+			}
+			return triangle_solid_angle(p00, p10 - p00, p11 - p00) + triangle_solid_angle(p00, p11 - p00, p01 - p00);
+		}
+#endif
+
 		void main()
 		{
+		  // lower resolution levels only fill the first rows of the image
+		  if (gl_WorkGroupID.y >= uint(parameters.height)) return;
+
 		  uint chunksize = parameters.width/N_LOCAL;
 
 		  // compute sum per item
@@ -59,16 +116,36 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeVolume::create_compute_st
 			  j = float(gl_WorkGroupID.y);
 			  n = float(parameters.width);
 			  m = float(parameters.height);
-			  float weight =  4.0f/n/m/sqrt(pow((3.0f + 4.0f*j*(j-m)/m/m + 4.0f*i*(i-n)/n/n), 3.0f));
-
-			  float d0 = pow(parameters.r_max*imageLoad(colorImage, ivec3(x, gl_WorkGroupID.y, 0)).a, 3);
-			  float d1 = pow(parameters.r_max*imageLoad(colorImage, ivec3(x, gl_WorkGroupID.y, 1)).a, 3);
-			  float d2 = pow(parameters.r_max*imageLoad(colorImage, ivec3(x, gl_WorkGroupID.y, 2)).a, 3);
-			  float d3 = pow(parameters.r_max*imageLoad(colorImage, ivec3(x, gl_WorkGroupID.y, 3)).a, 3);
-			  float d4 = pow(parameters.r_max*imageLoad(colorImage, ivec3(x, gl_WorkGroupID.y, 4)).a, 3);
-			  float d5 = pow(parameters.r_max*imageLoad(colorImage, ivec3(x, gl_WorkGroupID.y, 5)).a, 3);
+#ifdef QUAVIS_OCTAHEDRAL
+			  float weight = octahedral_weight(i, j, n, m);
+
+			  float d0 = cubed_distance(ivec3(x, gl_WorkGroupID.y, 0));
+
+			  tmp += d0*weight/3.0f;
+#elif defined(QUAVIS_FACE_SIZES)
+			  for (int f = 0; f < 6; f++) {
+				// texels outside of the resolution of the face are not rendered
+				if (x >= uint(face_size[f].x) || gl_WorkGroupID.y >= uint(face_size[f].y)) continue;
+				n = float(face_size[f].x);
+				m = float(face_size[f].y);
+				float weight = cube_weight(i, j, n, m);
+
+				float d = cubed_distance(ivec3(x, gl_WorkGroupID.y, f));
+
+				tmp += d*weight/3.0f;
+			  }
+#else
+			  float weight = cube_weight(i, j, n, m);
+
+			  float d0 = cubed_distance(ivec3(x, gl_WorkGroupID.y, 0));
+			  float d1 = cubed_distance(ivec3(x, gl_WorkGroupID.y, 1));
+			  float d2 = cubed_distance(ivec3(x, gl_WorkGroupID.y, 2));
+			  float d3 = cubed_distance(ivec3(x, gl_WorkGroupID.y, 3));
+			  float d4 = cubed_distance(ivec3(x, gl_WorkGroupID.y, 4));
+			  float d5 = cubed_distance(ivec3(x, gl_WorkGroupID.y, 5));
 
 			  tmp += (d0+d1+d2+d3+d4+d5)*weight/3.0f;
+#endif
 		  }
 		  tmp_local[gl_LocalInvocationID.x] = tmp;
 		  barrier();
@@ -104,7 +181,14 @@ std::vector<quavis::ComputeShaderStage> quavis::ComputeVolume::create_compute_st
 
 		layout (local_size_x = 1, local_size_y = N_LOCAL, local_size_z = 1) in;
 
-		layout (binding = 0, rgba32f) uniform readonly image2DArray colorImage;
+#ifndef QUAVIS_TARGET_FORMAT
+		#define QUAVIS_TARGET_FORMAT rgba32f
+#endif
+#ifdef QUAVIS_SAMPLES
+		layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DMSArray colorImage;
+#else
+		layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DArray colorImage;
+#endif
 		// layout (binding = 1, rg32f) uniform readonly image2DArray depthImage;
 		layout (binding = 2) buffer InputBuffer { 
 			float values[];
@@ -1,6 +1,10 @@
 #include "quavis_service.h"
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
+#include <limits>
+#include <tuple>
 
 #include <glm/gtc/type_ptr.hpp>
 #include <json/json.hpp>
@@ -14,6 +18,10 @@
 #include "compute/area.h"
 #include "compute/groups.h"
 #include "compute/sun.h"
+#include "compute/horizon.h"
+#include "compute/sky_patches.h"
+#include "compute/sky_matrix.h"
+#include "compute/result_interpolation.h"
 
 using namespace quavis;
 using namespace std::string_literals;
@@ -38,12 +46,113 @@ QuavisService::QuavisService(const std::shared_ptr<nlohmann::json> &config)
   render_height_ = j_render.value("renderHeight", 512u);
   auto deviceNumber  = j_render.value("gpu", 0u);
 
+  std::string projection = j_render.value("projection", "cube");
+  if (projection == "cube") {
+    projection_ = Projection::CUBE;
+  } else if (projection == "octahedral") {
+    projection_ = Projection::OCTAHEDRAL;
+  } else {
+    logger_->error("JSON: projection {} unknown", projection);
+    throw std::runtime_error("JSON: rendering failed");
+  }
+
+  // faces of different resolution share the layers of the largest face
+  std::array<glm::ivec2, 6> face_sizes;
+  const bool has_face_sizes = j_render.count("faceSizes") != 0;
+  if (has_face_sizes) {
+    auto &j_face_sizes = j_render["faceSizes"];
+    if (!j_face_sizes.is_array() || j_face_sizes.size() != 6 || projection_ != Projection::CUBE) {
+      logger_->error("JSON: faceSizes has to be 6 [width, height] pairs with the cube projection");
+      throw std::runtime_error("JSON: rendering failed");
+    }
+    render_width_  = 0;
+    render_height_ = 0;
+    for (size_t f = 0; f < 6; f++) {
+      face_sizes[f]  = glm::ivec2(j_face_sizes[f][0].get<int>(), j_face_sizes[f][1].get<int>());
+      render_width_  = std::max(render_width_, face_sizes[f].x);
+      render_height_ = std::max(render_height_, face_sizes[f].y);
+    }
+  }
+
   logger_->debug("Create renderer: {1}x{2}", render_width_, render_height_);
-  render_ = std::make_shared<quavis::Render>(glm::ivec2(render_width_, render_height_), deviceNumber);
+  render_ = std::make_shared<quavis::Render>(glm::ivec2(render_width_, render_height_), deviceNumber, projection_);
+  if (has_face_sizes) render_->set_face_sizes(face_sizes);
+
+  // multisampling, the compute stages resolve the fractional coverage of each texel
+  const uint32_t samples = j_render.value("samples", 1u);
+  if (samples > 1 && j_render.value("impostorRadius", 0.0f) > 0.0f) {
+    logger_->error("JSON: samples > 1 is not supported with impostors");
+    throw std::runtime_error("JSON: rendering failed");
+  }
+  render_->set_samples(samples);
+
+  // adaptive resolution, each level halves the render size
+  adaptive_tolerance_ = j_render.value("adaptiveTolerance", 0.0f);
+  if (adaptive_tolerance_ > 0.0f) {
+    adaptive_levels_          = j_render.value("adaptiveLevels", 3u);
+    const int coarsest_factor = 16 << adaptive_levels_;  // the compute stages need multiples of 16 texels
+    if (has_face_sizes || render_width_ % coarsest_factor != 0 || render_height_ % coarsest_factor != 0) {
+      logger_->error("JSON: adaptiveLevels needs a render size divisible by 16*2^adaptiveLevels and no faceSizes");
+      throw std::runtime_error("JSON: rendering failed");
+    }
+  }
+
+  vertex_compression_.quantize_positions = j_render.value("quantizePositions", false);
+  std::string vertex_data_format         = j_render.value("vertexDataFormat", "float32");
+  if (vertex_data_format == "float32") {
+    vertex_compression_.vertex_data_format = VK_FORMAT_R32G32B32A32_SFLOAT;
+  } else if (vertex_data_format == "float16") {
+    vertex_compression_.vertex_data_format = VK_FORMAT_R16G16B16A16_SFLOAT;
+  } else if (vertex_data_format == "unorm8") {
+    vertex_compression_.vertex_data_format = VK_FORMAT_R8G8B8A8_UNORM;
+  } else {
+    logger_->error("JSON: vertexDataFormat {} unknown", vertex_data_format);
+    throw std::runtime_error("JSON: rendering failed");
+  }
+
+  optimize_meshes_       = j_render.value("optimizeMeshes", false);
+  meshlet_min_triangles_ = j_render.value("meshletMinTriangles", 65536u);
+  meshlet_triangles_     = j_render.value("meshletTriangles", 512u);
+  lod_levels_            = j_render.value("lodLevels", 0u);
+  render_->set_lod_tolerance(j_render.value("lodTolerance", 0.5f));
+
+  const float impostor_radius = j_render.value("impostorRadius", 0.0f);
+  if (impostor_radius > 0.0f) {
+    const float impostor_spacing = j_render.value("impostorSpacing", impostor_radius / 4.0f);
+    if (impostor_spacing <= 0.0f) {
+      logger_->error("JSON: impostorSpacing has to be larger than 0");
+      throw std::runtime_error("JSON: rendering failed");
+    }
+    render_->set_impostors(impostor_radius, impostor_spacing);
+  }
+
+  const float streaming_tile_size = j_render.value("streamingTileSize", 0.0f);
+  if (streaming_tile_size > 0.0f) {
+    const float streaming_radius = j_render.value("streamingRadius", 0.0f);
+    if (streaming_radius <= 0.0f) {
+      logger_->error("JSON: streamingRadius has to be larger than 0 if streamingTileSize is set");
+      throw std::runtime_error("JSON: rendering failed");
+    }
+    // the far field is drawn as impostor, without it all tiles would be drawn and stay on the GPU
+    if (impostor_radius <= 0.0f) {
+      logger_->error("JSON: streamingTileSize needs impostorRadius");
+      throw std::runtime_error("JSON: rendering failed");
+    }
+    const VkDeviceSize budget = static_cast<VkDeviceSize>(j_render.value("streamingBudgetMB", 1024u)) * 1024 * 1024;
+    render_->set_streaming(streaming_tile_size, streaming_radius, budget);
+  }
+  if (meshlet_triangles_ == 0) {
+    logger_->error("JSON: meshletTriangles has to be larger than 0");
+    throw std::runtime_error("JSON: rendering failed");
+  }
 
   auto &j_objects = json["sceneObjects"];
   create_objects(j_objects);
 
+  if (json.count("portalCulling") != 0) {
+    create_portal_culling(json["portalCulling"]);
+  }
+
   auto &j_observations = json["observationPoints"];
   create_observations(j_observations);
 
@@ -57,6 +166,10 @@ void QuavisService::create_objects(nlohmann::json &j_objects)
 
   logger_->info("Reading {} scene objects", j_objects.size());
 
+  MeshOptimizer::Statistics mesh_stats;
+  size_t meshlet_count = 0;
+  size_t lod_count     = 0;
+
   for (auto &obj : j_objects) {
     // modelMatrix
     glm::mat4 model_matrix{1};
@@ -67,6 +180,14 @@ void QuavisService::create_objects(nlohmann::json &j_objects)
       model_matrix = glm::make_mat4(m.data());
     }
 
+    // objectData, used by the material if there is no vertexData
+    glm::vec4 object_data{0};
+
+    if (obj["objectData"].is_array() && obj["objectData"].size() == 4) {
+      std::vector<float> d = obj["objectData"];
+      object_data          = glm::make_vec4(d.data());
+    }
+
     // material
     auto material = create_material(obj["material"]);
 
@@ -74,8 +195,12 @@ void QuavisService::create_objects(nlohmann::json &j_objects)
     std::string type = obj["type"];
     if (type == "indexedArray"s) {
       std::vector<float> positions   = obj["positions"];
-      std::vector<float> vertex_data = obj["vertexData"];
+      std::vector<float> vertex_data = obj.value("vertexData", std::vector<float>());
       std::vector<uint32_t> indices  = obj["indices"];
+      if (!vertex_data.empty() && vertex_data.size() / 4 != positions.size() / 3) {
+        logger_->error("JSON: vertexData has {} entries but needs 4 per vertex ({} vertices)", vertex_data.size(), positions.size() / 3);
+        throw std::runtime_error("JSON: sceneObjects failed");
+      }
       geom                           = std::make_shared<DrawableGeometry>(std::move(positions), std::move(vertex_data), std::move(indices));
     } else if (type == "unitCube"s) {
       geom = DrawableGeometry::create_unit_cube();
@@ -84,8 +209,99 @@ void QuavisService::create_objects(nlohmann::json &j_objects)
       throw std::runtime_error("JSON: sceneObjects failed");
     }
 
-    render_->add_static_scene_object(std::make_shared<SceneObject>(geom, material, model_matrix));
+    if (optimize_meshes_) {
+      const auto stats = geom->optimize();
+      mesh_stats.vertices_before += stats.vertices_before;
+      mesh_stats.vertices_after += stats.vertices_after;
+      mesh_stats.triangles_before += stats.triangles_before;
+      mesh_stats.triangles_after += stats.triangles_after;
+    }
+
+    if (meshlet_min_triangles_ > 0) {
+      geom->build_meshlets(meshlet_min_triangles_, meshlet_triangles_);
+      meshlet_count += geom->get_meshlets().size();
+    }
+
+    if (lod_levels_ > 0) {
+      geom->build_lod_chain(lod_levels_);
+      lod_count += geom->get_lod_levels().empty() ? 0 : geom->get_lod_levels().size() - 1;
+    }
+
+    geom->set_vertex_compression(vertex_compression_);
+
+    const bool closed_solid = obj.value("closedSolid", false);
+    object_cells_.push_back(obj.value("cell", PortalCulling::exterior));
+
+    render_->add_static_scene_object(std::make_shared<SceneObject>(geom, material, model_matrix, object_data, closed_solid));
+  }
+
+  if (optimize_meshes_) {
+    logger_->info("Optimized meshes: {} -> {} vertices, {} -> {} triangles", mesh_stats.vertices_before, mesh_stats.vertices_after,
+                  mesh_stats.triangles_before, mesh_stats.triangles_after);
+  }
+
+  if (meshlet_count > 0) {
+    logger_->info("Split large meshes into {} meshlets", meshlet_count);
+  }
+
+  if (lod_levels_ > 0) {
+    logger_->info("Created {} levels of detail", lod_count);
+  }
+}
+
+void QuavisService::create_portal_culling(nlohmann::json &j_portal_culling)
+{
+  if (!j_portal_culling.is_object()) throw std::runtime_error("JSON: portalCulling is not an object");
+
+  auto culling = std::make_shared<PortalCulling>();
+  culling->set_max_depth(j_portal_culling.value("maxDepth", 8u));
+
+  auto &j_cells = j_portal_culling["cells"];
+  if (!j_cells.is_array()) throw std::runtime_error("JSON: portalCulling.cells is not an array");
+
+  for (auto &j_cell : j_cells) {
+    std::vector<std::pair<glm::vec3, glm::vec3>> boxes;
+    for (auto &j_box : j_cell["boxes"]) {
+      std::vector<float> b = j_box;
+      if (b.size() != 6) throw std::runtime_error("JSON: portalCulling.cells.boxes needs 6 values (min, max)");
+      boxes.emplace_back(glm::vec3(b[0], b[1], b[2]), glm::vec3(b[3], b[4], b[5]));
+    }
+    culling->add_cell(boxes);
+  }
+
+  auto &j_portals = j_portal_culling["portals"];
+  if (!j_portals.is_array()) throw std::runtime_error("JSON: portalCulling.portals is not an array");
+
+  const int cell_count = static_cast<int>(culling->cells_size());
+  for (auto &j_portal : j_portals) {
+    std::vector<int> cells  = j_portal["cells"];
+    std::vector<float> poly = j_portal["polygon"];
+    if (cells.size() != 2 || poly.size() < 9 || poly.size() % 3 != 0) throw std::runtime_error("JSON: portalCulling.portals is not valid");
+
+    for (auto c : cells) {
+      if (c < PortalCulling::exterior || c >= cell_count) {
+        logger_->error("JSON: portal cell {} unknown", c);
+        throw std::runtime_error("JSON: portalCulling failed");
+      }
+    }
+
+    std::vector<glm::vec3> polygon;
+    for (size_t i = 0; i < poly.size(); i += 3) {
+      polygon.emplace_back(poly[i + 0], poly[i + 1], poly[i + 2]);
+    }
+    culling->add_portal(cells[0], cells[1], polygon);
   }
+
+  for (auto c : object_cells_) {
+    if (c < PortalCulling::exterior || c >= cell_count) {
+      logger_->error("JSON: sceneObjects cell {} unknown", c);
+      throw std::runtime_error("JSON: portalCulling failed");
+    }
+  }
+  culling->set_object_cells(object_cells_);
+
+  logger_->info("Portal culling with {} cells and {} portals", culling->cells_size(), culling->portals_size());
+  render_->set_portal_culling(culling);
 }
 
 void QuavisService::create_observations(nlohmann::json &j_observations)
@@ -141,6 +357,10 @@ void QuavisService::create_observations(nlohmann::json &j_observations)
   }
 
   render_->add_observations(std::move(observations));
+
+  // approximate mode, interpolates between a subset of exactly computed observations
+  interpolation_spacing_   = j_observations.value("interpolationSpacing", 0.0f);
+  interpolation_tolerance_ = j_observations.value("interpolationTolerance", 0.02f);
 }
 
 void QuavisService::create_compute_stages(nlohmann::json &j_computes)
@@ -149,32 +369,130 @@ void QuavisService::create_compute_stages(nlohmann::json &j_computes)
 
   logger_->info("Reading {} compute stages", j_computes.size());
 
+  // the render target only stores the channels the stages read, groups and sun read the red channel
+  auto layout = TargetLayout::DISTANCE;
+  for (auto &stage : j_computes) {
+    const std::string type = stage.value("type", "");
+    if (type == "groups"s || type == "sun"s || type == "sunv2"s) {
+      layout = std::max(layout, TargetLayout::RED_DISTANCE);
+    } else if (type != "volume"s && type != "area"s && type != "horizon"s && type != "directSun"s && type != "horizonSun"s &&
+               type != "skyPatches"s && type != "skyLuminance"s) {
+      layout = TargetLayout::COLOR_DISTANCE;
+    }
+  }
+  render_->set_target_layout(layout);
+
+  uint32_t max_level = 0;
   for (auto &stage : j_computes) {
     std::string name = stage["name"];
 
-    if (name == "" || compute_stages_.find(name) != compute_stages_.end()) {
+    const bool taken = compute_stages_.count(name) > 0 || direct_sun_stages_.count(name) > 0 || horizon_sun_stages_.count(name) > 0 ||
+                       sky_luminance_stages_.count(name) > 0;
+    if (name == "" || taken) {
       logger_->error("JSON: compute stages name {} is invalid", name);
       throw std::runtime_error("JSON: compute stages name is invalid");
     }
 
     std::string type = stage["type"];
+    const bool renders = type != "directSun"s && type != "horizonSun"s && type != "skyLuminance"s;
+    if (projection_ != Projection::CUBE && type != "volume"s && type != "area"s && type != "cubeMap"s && renders) {
+      logger_->error("JSON: compute stage type {} needs the cube projection", type);
+      throw std::runtime_error("JSON: compute stages failed");
+    }
+    if ((adaptive_levels_ > 0 || interpolation_spacing_ > 0.0f) && type == "cubeMap"s) {
+      logger_->error("JSON: compute stage type {} is not supported with adaptive resolution or interpolation", type);
+      throw std::runtime_error("JSON: compute stages failed");
+    }
+    if (render_->get_samples() > 1 && type == "cubeMap"s) {
+      logger_->error("JSON: compute stage type {} is not supported with samples > 1", type);
+      throw std::runtime_error("JSON: compute stages failed");
+    }
+
+    // area and volume can read a coarser level of the reduction pyramid, the other stages need the individual texels
+    const uint32_t level = stage.value("level", 0u);
+    if (level > 0 && (type != "volume"s && type != "area"s)) {
+      logger_->error("JSON: compute stage type {} needs level 0", type);
+      throw std::runtime_error("JSON: compute stages failed");
+    }
+    if (level > 0 && (adaptive_levels_ > 0 || render_->has_face_sizes() || render_width_ % (16 << level) != 0 || render_height_ % (16 << level) != 0)) {
+      logger_->error("JSON: compute stage level needs a render size divisible by 16*2^level, no adaptive resolution and no faceSizes");
+      throw std::runtime_error("JSON: compute stages failed");
+    }
+    stage_levels_[name] = level;
+    max_level           = std::max(max_level, level);
+
     if (type == "volume"s) {
-      compute_stages_[name] = std::make_shared<ComputeVolume>(render_->get_device(), render_->get_render_size());
+      compute_stages_[name] = std::make_shared<ComputeVolume>(render_->get_device(), render_->get_level_size(level), render_->get_shader_defines(level));
     } else if (type == "area"s) {
-      compute_stages_[name] = std::make_shared<ComputeArea>(render_->get_device(), render_->get_render_size());
+      compute_stages_[name] = std::make_shared<ComputeArea>(render_->get_device(), render_->get_level_size(level), render_->get_shader_defines(level));
     } else if (type == "groups"s) {
-      compute_stages_[name] = std::make_shared<ComputeGroups>(render_->get_device(), render_->get_render_size());
+      compute_stages_[name] = std::make_shared<ComputeGroups>(render_->get_device(), render_->get_render_size(), render_->get_shader_defines());
     } else if (type == "sun"s) {
-      compute_stages_[name] = std::make_shared<ComputeSun>(render_->get_device(), render_->get_render_size(), false);
+      compute_stages_[name] = std::make_shared<ComputeSun>(render_->get_device(), render_->get_render_size(), false, render_->get_shader_defines());
     } else if (type == "sunv2"s) {
-      compute_stages_[name] = std::make_shared<ComputeSun>(render_->get_device(), render_->get_render_size(), true);
+      compute_stages_[name] = std::make_shared<ComputeSun>(render_->get_device(), render_->get_render_size(), true, render_->get_shader_defines());
     } else if (type == "cubeMap"s) {
       compute_stages_[name] = std::make_shared<ComputeCubeMap>(stage["pretty"].get<bool>());
+    } else if (type == "directSun"s) {
+      // computed for all observations at once after the rendered stages, see run
+      direct_sun_stages_[name] = std::make_shared<ComputeDirectSun>(render_->get_device(), stage.value("resolution", 2048u),
+                                                                    stage.value("texelSize", 0.0f), stage.value("depthBias", 0.01f));
+    } else if (type == "horizon"s) {
+      compute_stages_[name] =
+        std::make_shared<ComputeHorizon>(render_->get_device(), render_->get_render_size(), stage.value("bins", 720u), render_->get_shader_defines());
+    } else if (type == "horizonSun"s) {
+      // the profiles of a previous run with a horizon stage, tested against the sun positions of the observations after the rendered stages
+      auto profiles = std::make_shared<HorizonProfiles>(stage.at("profiles").get<std::vector<std::vector<float>>>());
+      if (profiles->size() != observations_.size()) {
+        logger_->error("JSON: compute stage {} needs one horizon profile per observation point", name);
+        throw std::runtime_error("JSON: compute stages failed");
+      }
+      horizon_sun_stages_[name] = profiles;
+    } else if (type == "skyPatches"s) {
+      compute_stages_[name] = std::make_shared<ComputeSkyPatches>(render_->get_device(), render_->get_render_size(), render_->get_shader_defines());
+    } else if (type == "skyLuminance"s) {
+      // the visible sky per patch of a skyPatches stage of this run or of a previous one, multiplied with the sky matrix after the rendered stages
+      SkyLuminanceStage sky;
+      sky.patches_stage = stage.value("patchesStage", "");
+      if (sky.patches_stage == "") {
+        for (const auto &patches : stage.at("patches").get<std::vector<std::vector<float>>>()) {
+          if (patches.size() != SkyMatrix::PATCHES) {
+            logger_->error("JSON: compute stage {} needs {} values per sky patches entry", name, SkyMatrix::PATCHES);
+            throw std::runtime_error("JSON: compute stages failed");
+          }
+          sky.patches.insert(sky.patches.end(), patches.begin(), patches.end());
+        }
+        if (sky.patches.size() != observations_.size() * SkyMatrix::PATCHES) {
+          logger_->error("JSON: compute stage {} needs the sky patches of each observation point", name);
+          throw std::runtime_error("JSON: compute stages failed");
+        }
+      }
+      sky_luminance_stages_[name] = sky;
     } else {
       logger_->error("JSON: type {} unknown for computeStages", type);
       throw std::runtime_error("JSON: sceneObjects failed");
     }
   }
+
+  render_->set_reduction_levels(max_level);
+
+  for (const auto &sl : sky_luminance_stages_) {
+    const std::string &patches_stage = sl.second.patches_stage;
+    const auto patches               = compute_stages_.find(patches_stage);
+    if (patches_stage != "" && (patches == compute_stages_.end() || std::dynamic_pointer_cast<ComputeSkyPatches>(patches->second) == nullptr)) {
+      logger_->error("JSON: compute stage {} needs patchesStage to name a skyPatches stage", sl.first);
+      throw std::runtime_error("JSON: compute stages failed");
+    }
+  }
+
+  // only render the cube faces some stage reads, the view cone of the observation is passed to the stage named groups only
+  std::vector<DirectionDomain> domains;
+  for (const auto &cs : compute_stages_) {
+    auto domain = cs.second->get_direction_domain();
+    if (domain == DirectionDomain::VIEW_CONE && cs.first != "groups") domain = DirectionDomain::FULL_SPHERE;
+    domains.push_back(domain);
+  }
+  render_->set_direction_domains(domains);
 }
 
 std::shared_ptr<quavis::MaterialBase> quavis::QuavisService::create_material(nlohmann::json &j_material)
@@ -230,58 +548,273 @@ std::shared_future<std::string> quavis::QuavisService::save_image(size_t i, cons
   return image->wrtie_and_release_async(filename, store_format_);
 }
 
-void QuavisService::run()
+namespace {
+/// largest change of the values of a compute stage between a coarse and a fine result, relative to the magnitude of the fine values
+float get_relative_change(const std::map<std::string, std::shared_ptr<ComputeResult>> &coarse,
+                          const std::map<std::string, std::shared_ptr<ComputeResult>> &fine)
+{
+  float change = 0.0f;
+  for (const auto &r : fine) {
+    const auto &fine_values   = r.second->values;
+    const auto &coarse_values = coarse.at(r.first)->values;
+
+    float difference = 0.0f;
+    float magnitude  = 0.0f;
+    for (size_t v = 0; v < fine_values.size(); v++) {
+      difference += std::abs(fine_values[v] - coarse_values[v]);
+      magnitude += std::abs(fine_values[v]);
+    }
+    if (difference > 0.0f) change = std::max(change, difference / std::max(magnitude, std::numeric_limits<float>::min()));
+  }
+  return change;
+}
+}  // namespace
+
+std::map<std::string, std::shared_ptr<ComputeResult>> QuavisService::compute_observation(size_t i, uint32_t level, std::shared_ptr<CubeImages> image)
 {
-  for (size_t i = 0; i < render_->observations_size(); i++) {
-    if (i % 50 == 0)
-      logger_->info("Observation: {}", i);
+  const glm::ivec2 size = render_->get_level_size(level);
+
+  if (image == nullptr) {
     logger_->debug("Rendering");
-    auto image = render_->draw(i);
-    logger_->debug("Computing");
-    std::map<std::string, std::shared_ptr<ComputeResult>> results;
-    std::shared_ptr<ComputeResult> result;
-    for (const auto &cs : compute_stages_) {
-      logger_->debug("Compute stage '{}'", cs.first);
-      if (cs.first == "groups") {
-        const ComputeGroupsParams par = {
-          render_width_,
-          render_height_,
-          observations_[i].field_of_view,
-          observations_[i].view_direction.x,
-          observations_[i].view_direction.y,
-          observations_[i].view_direction.z
+    image = render_->draw(i, level);
+  }
+  logger_->debug("Computing");
+  std::map<std::string, std::shared_ptr<ComputeResult>> results;
+  std::shared_ptr<ComputeResult> result;
+  for (const auto &cs : compute_stages_) {
+    logger_->debug("Compute stage '{}'", cs.first);
+    const uint32_t stage_level = stage_levels_[cs.first];
+    if (stage_level > 0) {
+      // a coarser level of the reduction pyramid of the full resolution view
+      auto reduced = render_->get_reduced_image(stage_level);
+      cs.second->set_resolution(render_->get_level_size(stage_level));
+      result = results[cs.first] = cs.second->compute(reduced, reduced);
+      continue;
+    }
+    cs.second->set_resolution(size);
+    if (cs.first == "groups") {
+      const ComputeGroupsParams par = {
+        size.x,
+        size.y,
+        observations_[i].field_of_view,
+        observations_[i].view_direction.x,
+        observations_[i].view_direction.y,
+        observations_[i].view_direction.z,
+        render_->get_face_mask(i)
+      };
+      std::shared_ptr<ComputeBase> a = cs.second;
+      std::shared_ptr<ComputeGroups> b = std::dynamic_pointer_cast<ComputeGroups>(a);
+      result = results[cs.first] = b->compute(par, image, image);
+    }
+    else if (cs.first == "sun") {
+      result = std::make_shared<ComputeResult>();
+      for(size_t j = 0; j < observations_[i].solar_azimuth.size(); j++) {
+        const ComputeSunParams par = {
+          size.x,
+          size.y,
+          observations_[i].solar_azimuth[j],
+          observations_[i].solar_altitude[j],
+          observations_[i].solar_zenith_luminance[j]
         };
         std::shared_ptr<ComputeBase> a = cs.second;
-        std::shared_ptr<ComputeGroups> b = std::dynamic_pointer_cast<ComputeGroups>(a);
-        result = results[cs.first] = b->compute(par, image, image);
+        std::shared_ptr<ComputeSun> b = std::dynamic_pointer_cast<ComputeSun>(a);
+        result->values.push_back(b->compute(par, image, image)->values[0]);
+      }
+      results[cs.first] = result;
+    }
+    else {
+      result = results[cs.first] = cs.second->compute(image, image);
+    }
+
+    // save images if needed in multithread
+    if (result->image != nullptr) {
+      save_image(i, cs.first, result->image);
+    }
+  }
+  return results;
+}
+
+std::map<std::string, std::shared_ptr<ComputeResult>> QuavisService::compute_adaptive(size_t i, std::shared_ptr<CubeImages> image)
+{
+  // adaptive resolution: start at the coarsest level and refine until two consecutive levels agree within the tolerance
+  uint32_t level = adaptive_levels_;
+  auto results   = compute_observation(i, level, image);
+  renders_++;
+  while (level > 0) {
+    auto finer = compute_observation(i, --level);
+    renders_++;
+
+    const float change = get_relative_change(results, finer);
+    results            = std::move(finer);
+    if (change <= adaptive_tolerance_) break;
+  }
+
+  exact_observations_++;
+  return results;
+}
+
+void QuavisService::compute_interpolated(const std::vector<size_t> &order)
+{
+  std::vector<size_t> rank(order.size());
+  for (size_t n = 0; n < order.size(); n++) {
+    rank[order[n]] = n;
+  }
+
+  // only observations with the same view and sun are interpolated from each other
+  typedef std::tuple<float, float, float, float, std::vector<float>, std::vector<float>, std::vector<float>> ObservationKey;
+  std::map<ObservationKey, size_t> key_indices;
+  std::vector<glm::vec3> positions;
+  std::vector<size_t> keys;
+  for (const auto &obs : observations_) {
+    const ObservationKey key{obs.view_direction.x, obs.view_direction.y, obs.view_direction.z,  obs.field_of_view,
+                             obs.solar_azimuth,    obs.solar_altitude,   obs.solar_zenith_luminance};
+    positions.push_back(obs.position);
+    keys.push_back(key_indices.emplace(key, key_indices.size()).first->second);
+  }
+
+  ResultInterpolation interpolation(positions, keys, interpolation_spacing_, interpolation_tolerance_);
+  auto batch = interpolation.get_coarse_samples();
+  while (!batch.empty()) {
+    std::sort(batch.begin(), batch.end(), [&](size_t a, size_t b) { return rank[a] < rank[b]; });
+    for (auto i : batch) {
+      if (exact_observations_ % 50 == 0)
+        logger_->info("Observation: {}", exact_observations_);
+      compute_results_[i] = compute_adaptive(i);
+
+      std::vector<std::vector<float>> values;
+      for (const auto &r : compute_results_[i]) {
+        values.push_back(r.second->values);
+      }
+      interpolation.set_exact(i, values);
+    }
+    batch = interpolation.get_refinement();
+  }
+
+  interpolated_.assign(observations_.size(), false);
+  for (size_t i = 0; i < observations_.size(); i++) {
+    if (interpolation.is_exact(i)) continue;
+
+    const auto weights = interpolation.get_weights(i);
+    std::map<std::string, std::shared_ptr<ComputeResult>> results;
+    for (const auto &r : compute_results_[weights.front().first]) {
+      auto result = std::make_shared<ComputeResult>();
+      result->values.assign(r.second->values.size(), 0.0f);
+      for (const auto &w : weights) {
+        const auto &values = compute_results_[w.first].at(r.first)->values;
+        for (size_t v = 0; v < values.size(); v++) {
+          result->values[v] += w.second * values[v];
+        }
       }
-      else if (cs.first == "sun") {
-        result = std::make_shared<ComputeResult>();
-        for(size_t j = 0; j < observations_[i].solar_azimuth.size(); j++) {
-          const ComputeSunParams par = {
-            render_width_,
-            render_height_,
-            observations_[i].solar_azimuth[j],
-            observations_[i].solar_altitude[j],
-            observations_[i].solar_zenith_luminance[j]
-          };
-          std::shared_ptr<ComputeBase> a = cs.second;
-          std::shared_ptr<ComputeSun> b = std::dynamic_pointer_cast<ComputeSun>(a);
-          result->values.push_back(b->compute(par, image, image)->values[0]);
+      results[r.first] = result;
+    }
+    compute_results_[i] = std::move(results);
+    interpolated_[i]    = true;
+  }
+
+  logger_->info("Interpolation: {} of {} observations computed exactly", exact_observations_, observations_.size());
+}
+
+void QuavisService::run()
+{
+  compute_results_.resize(render_->observations_size());
+  renders_            = 0;
+  exact_observations_ = 0;
+
+  const auto order = render_->get_observation_order();
+  if (compute_stages_.empty()) {
+    // only direct sun, horizon sun and sky luminance stages, nothing is rendered
+  } else if (interpolation_spacing_ > 0.0f) {
+    compute_interpolated(order);
+  } else {
+    // with async compute the next observation is drawn while the stages compute the current one. Not with adaptive resolution, whose next draw
+    // depends on the results, nor with reduction levels, which are rebuilt by each draw
+    const bool prefetch = render_->has_async_compute() && adaptive_levels_ == 0 && render_->get_reduction_levels() == 0;
+    std::shared_ptr<CubeImages> next;
+    if (prefetch && !order.empty()) next = render_->draw(order[0]);
+
+    for (size_t n = 0; n < order.size(); n++) {
+      const size_t i = order[n];
+      if (n % 50 == 0)
+        logger_->info("Observation: {}", n);
+      auto image = next;
+      if (prefetch && n + 1 < order.size()) next = render_->draw(order[n + 1]);
+      compute_results_[i] = compute_adaptive(i, image);
+    }
+  }
+
+  for (const auto &ds : direct_sun_stages_) {
+    logger_->info("Direct sun: {}", ds.first);
+    const auto results = ds.second->compute(render_->get_scene_objects(), observations_);
+    for (size_t i = 0; i < results.size(); i++) {
+      compute_results_[i][ds.first] = results[i];
+    }
+  }
+
+  for (const auto &hs : horizon_sun_stages_) {
+    // the distinct sun positions are tested for all observations at once
+    std::map<std::pair<float, float>, size_t> sun_indices;
+    std::vector<float> azimuths, altitudes;
+    for (const auto &obs : observations_) {
+      for (size_t j = 0; j < obs.solar_azimuth.size(); j++) {
+        if (sun_indices.emplace(std::make_pair(obs.solar_azimuth[j], obs.solar_altitude[j]), azimuths.size()).second) {
+          azimuths.push_back(obs.solar_azimuth[j]);
+          altitudes.push_back(obs.solar_altitude[j]);
         }
-        results[cs.first] = result;
       }
-      else {
-        result = results[cs.first] = cs.second->compute(image, image);
+    }
+    const auto sunlit = hs.second->compute_sunlit(azimuths, altitudes);
+
+    for (size_t i = 0; i < observations_.size(); i++) {
+      const auto &obs = observations_[i];
+      auto result     = std::make_shared<ComputeResult>();
+      for (size_t j = 0; j < obs.solar_azimuth.size(); j++) {
+        const size_t s = sun_indices.at(std::make_pair(obs.solar_azimuth[j], obs.solar_altitude[j]));
+        result->values.push_back(static_cast<float>(sunlit[s * observations_.size() + i]));
       }
+      compute_results_[i][hs.first] = result;
+    }
+  }
 
-      // save images if needed in multithread
-      if (result->image != nullptr) {
-        save_image(i, cs.first, result->image);
+  for (const auto &sl : sky_luminance_stages_) {
+    // the distinct skies of all observations are the time steps of a single sky matrix
+    std::map<std::tuple<float, float, float>, size_t> sky_indices;
+    std::vector<float> azimuths, altitudes, zenith_luminances;
+    for (const auto &obs : observations_) {
+      for (size_t j = 0; j < obs.solar_azimuth.size(); j++) {
+        const auto sky = std::make_tuple(obs.solar_azimuth[j], obs.solar_altitude[j], obs.solar_zenith_luminance[j]);
+        if (sky_indices.emplace(sky, azimuths.size()).second) {
+          azimuths.push_back(obs.solar_azimuth[j]);
+          altitudes.push_back(obs.solar_altitude[j]);
+          zenith_luminances.push_back(obs.solar_zenith_luminance[j]);
+        }
+      }
+    }
+    const SkyMatrix sky_matrix(azimuths, altitudes, zenith_luminances);
+
+    std::vector<float> visibility = sl.second.patches;
+    if (sl.second.patches_stage != "") {
+      visibility.reserve(observations_.size() * SkyMatrix::PATCHES);
+      for (size_t i = 0; i < observations_.size(); i++) {
+        const auto &values = compute_results_[i].at(sl.second.patches_stage)->values;
+        visibility.insert(visibility.end(), values.begin(), values.end());
       }
     }
+    logger_->info("Sky luminance: {} for {} skies", sl.first, sky_matrix.get_timesteps());
+    const auto luminances = sky_matrix.integrate(visibility);
+
+    for (size_t i = 0; i < observations_.size(); i++) {
+      const auto &obs = observations_[i];
+      auto result     = std::make_shared<ComputeResult>();
+      for (size_t j = 0; j < obs.solar_azimuth.size(); j++) {
+        const size_t t = sky_indices.at(std::make_tuple(obs.solar_azimuth[j], obs.solar_altitude[j], obs.solar_zenith_luminance[j]));
+        result->values.push_back(luminances[i * sky_matrix.get_timesteps() + t]);
+      }
+      compute_results_[i][sl.first] = result;
+    }
+  }
 
-    compute_results_.push_back(std::move(results));
+  if (adaptive_levels_ > 0 && exact_observations_ > 0) {
+    logger_->info("Adaptive resolution: {:.2f} renders per observation", static_cast<float>(renders_) / static_cast<float>(exact_observations_));
   }
 }
 
@@ -353,6 +886,9 @@ std::shared_ptr<nlohmann::json> QuavisService::get_output_json()
   result["header"] = config_->at("quavis")["header"];
 
   result["results"] = compute_results_;
+  if (interpolation_spacing_ > 0.0f) {
+    result["interpolated"] = interpolated_;
+  }
 
   return result_ptr;
 }
@@ -9,6 +9,8 @@
 #include <json/json.hpp>
 
 #include "compute/compute_base.h"
+#include "compute/direct_sun.h"
+#include "compute/horizon_profiles.h"
 #include "logger.h"
 #include "render/render.h"
 
@@ -35,10 +37,18 @@ class QuavisService : UseLogger {
  private:  // functions
   /// parses JSON and adds all scene objects to the renderer
   void create_objects(nlohmann::json &j_objects);
+  /// parses JSON cells and portals and enables portal culling in the renderer
+  void create_portal_culling(nlohmann::json &j_portal_culling);
   /// parses JSON and add observation points to renderer
   void create_observations(nlohmann::json &j_observations);
   /// parses JSON and creates compute stages
   void create_compute_stages(nlohmann::json &j_computes);
+  /// renders observation i at resolution level (see Render::draw) and runs all compute stages, on the already drawn image if not nullptr
+  std::map<std::string, std::shared_ptr<ComputeResult>> compute_observation(size_t i, uint32_t level, std::shared_ptr<CubeImages> image = nullptr);
+  /// computes observation i, refining the resolution level when adaptive. Without adaptive levels image can be observation i already drawn
+  std::map<std::string, std::shared_ptr<ComputeResult>> compute_adaptive(size_t i, std::shared_ptr<CubeImages> image = nullptr);
+  /// computes a subset of the observations (in order) and interpolates the others
+  void compute_interpolated(const std::vector<size_t> &order);
   /// saves the image of observation obs_i of compute stage named stage_name
   std::shared_future<std::string> save_image(size_t obs_i, const std::string &stage_name, std::shared_ptr<ImageCPU> &image);
   /// parses JSON and creates materials
@@ -49,6 +59,14 @@ class QuavisService : UseLogger {
 
   std::shared_ptr<Render> render_;
   std::map<std::string, std::shared_ptr<ComputeBase>> compute_stages_;
+  std::map<std::string, std::shared_ptr<ComputeDirectSun>> direct_sun_stages_;  ///< computed for all observations at once, without rendering
+  std::map<std::string, std::shared_ptr<HorizonProfiles>> horizon_sun_stages_;  ///< stored horizon profiles tested against the sun positions
+  struct SkyLuminanceStage {
+    std::string patches_stage;   ///< skyPatches stage of this run providing the visible sky per patch, empty for stored patches
+    std::vector<float> patches;  ///< stored visible sky, SkyMatrix::PATCHES values per observation
+  };
+  std::map<std::string, SkyLuminanceStage> sky_luminance_stages_;  ///< visible sky per patch multiplied with the sky matrix of the sun positions
+  std::map<std::string, uint32_t> stage_levels_;  ///< per compute stage, the reduction level it reads (see Render::set_reduction_levels)
   std::vector<std::map<std::string, std::shared_ptr<ComputeResult>>> compute_results_;
 
   ImageCPU::StoreFormat store_format_;
@@ -57,6 +75,20 @@ class QuavisService : UseLogger {
   std::vector<Observation> observations_;
   int render_width_;
   int render_height_;
+  Projection projection_;
+  uint32_t adaptive_levels_{0};  ///< number of coarser resolution levels tried first, 0 renders at full resolution only
+  float adaptive_tolerance_{0.0f};
+  float interpolation_spacing_{0.0f};  ///< cell size of the first exactly computed observations, 0 computes all exactly
+  float interpolation_tolerance_{0.0f};
+  std::vector<bool> interpolated_;  ///< per observation, true if its results are interpolated
+  size_t renders_{0};
+  size_t exact_observations_{0};
+  VertexCompression vertex_compression_;
+  bool optimize_meshes_;
+  uint32_t meshlet_min_triangles_;
+  uint32_t meshlet_triangles_;
+  uint32_t lod_levels_;
+  std::vector<int> object_cells_;
 };
 }  // namespace quavis
 
@@ -6,6 +6,7 @@
 #include "wrappers/descriptor_set_layout.h"
 #include "wrappers/device.h"
 #include "wrappers/event.h"
+#include "wrappers/fence.h"
 #include "wrappers/framebuffer.h"
 #include "wrappers/graphics_pipeline_manager.h"
 #include "wrappers/image.h"
@@ -13,6 +14,8 @@
 #include "wrappers/instance.h"
 #include "wrappers/memory_block.h"
 #include "wrappers/physical_device.h"
+#include "wrappers/pipeline_layout.h"
+#include "wrappers/queue.h"
 #include "wrappers/render_pass.h"
 #include "wrappers/rendering_surface.h"
 #include "wrappers/semaphore.h"
@@ -2,21 +2,27 @@
 #include "cube_images.h"
 
 #include "./anvil.h"
+#include "./device_queues.h"
 
 using namespace std;
 
 namespace quavis {
 
-CubeImages::CubeImages(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2& render_size_, const CubeImages::Usages usage)
+CubeImages::CubeImages(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2& render_size_, const CubeImages::Usages usage, uint32_t layers,
+                       VkSampleCountFlagBits samples, VkFormat color_format)
   : device_ptr_(device_ptr)
   , render_size_(render_size_)
   , usage_(usage)
+  , layers_(layers)
+  , samples_(samples)
 {
+  assert(samples_ == VK_SAMPLE_COUNT_1_BIT || usage_ == USAGE_COLOR_ATTACHMENT || usage_ == USAGE_DEPTH_ATTACHMENT);
+
   // for now switch later derive maybe
   switch (usage_) {
     case quavis::CubeImages::USAGE_COLOR_ATTACHMENT:
-      image_format_         = VK_FORMAT_R32G32B32A32_SFLOAT;
-      compute_image_format_ = VK_FORMAT_R32G32B32A32_SFLOAT;
+      image_format_         = color_format;
+      compute_image_format_ = color_format;
       image_usage_          = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
       image_aspects_        = VK_IMAGE_ASPECT_COLOR_BIT;
       image_layout_         = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
@@ -26,32 +32,47 @@ CubeImages::CubeImages(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::i
     case quavis::CubeImages::USAGE_DEPTH_ATTACHMENT:
       image_format_         = VK_FORMAT_D32_SFLOAT;
       compute_image_format_ = VK_FORMAT_R32G32_SFLOAT;
-      image_usage_          = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+      image_usage_          = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
       image_aspects_        = VK_IMAGE_ASPECT_DEPTH_BIT;
       image_layout_         = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-      memory_features_      = 0;
+      memory_features_      = has_lazily_allocated_memory() ? Anvil::MEMORY_FEATURE_FLAG_LAZILY_ALLOCATED : 0;
       tiling_               = VK_IMAGE_TILING_OPTIMAL;
       break;
     case quavis::CubeImages::USAGE_COLOR_TEXTURE:
-      image_format_         = VK_FORMAT_R32G32B32A32_SFLOAT;
-      compute_image_format_ = VK_FORMAT_R32G32B32A32_SFLOAT;
+      image_format_         = color_format;
+      compute_image_format_ = color_format;
       image_usage_          = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
       image_aspects_        = VK_IMAGE_ASPECT_COLOR_BIT;
       image_layout_         = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
       memory_features_      = 0;
       tiling_               = VK_IMAGE_TILING_OPTIMAL;
       break;
+    case quavis::CubeImages::USAGE_STORAGE:
+      image_format_         = color_format;
+      compute_image_format_ = color_format;
+      image_usage_          = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+      image_aspects_        = VK_IMAGE_ASPECT_COLOR_BIT;
+      image_layout_         = VK_IMAGE_LAYOUT_GENERAL;
+      memory_features_      = 0;
+      tiling_               = VK_IMAGE_TILING_OPTIMAL;
+      break;
     default:
       throw std::logic_error("usage not implemented");
   }
 
+  // render targets and storage images are read by the compute and transfer queues, which can be of other families than the universal queue
+  const auto queues = get_device_queues(device_ptr_.lock());
+  const bool shared = usage_ == USAGE_COLOR_ATTACHMENT || usage_ == USAGE_STORAGE;
+  const Anvil::QueueFamilyBits families =
+    shared ? queues.get_queue_families() : Anvil::QUEUE_FAMILY_GRAPHICS_BIT | Anvil::QUEUE_FAMILY_COMPUTE_BIT;
+  sharing_mode_ = shared ? queues.get_sharing_mode() : VK_SHARING_MODE_EXCLUSIVE;
+
   images_ = Anvil::Image::create_nonsparse(device_ptr_, VK_IMAGE_TYPE_2D, get_image_format(), tiling_, get_image_usage(), render_size_.x,
                                            render_size_.y, 1, /* in_base_mipmap_depth */
-                                           6,                 /* in_n_layers          */
-                                           VK_SAMPLE_COUNT_1_BIT, Anvil::QUEUE_FAMILY_GRAPHICS_BIT | Anvil::QUEUE_FAMILY_COMPUTE_BIT,
-                                           VK_SHARING_MODE_EXCLUSIVE, false,             /* in_use_full_mipmap_chain */
-                                           memory_features_,                             /* in_memory_features  */
-                                           Anvil::IMAGE_CREATE_FLAG_CUBE_COMPATIBLE_BIT, /* in_create_flags          */
+                                           layers_,           /* in_n_layers          */
+                                           samples_, families, sharing_mode_, false,                          /* in_use_full_mipmap_chain */
+                                           memory_features_,                                                  /* in_memory_features  */
+                                           is_cube() ? Anvil::IMAGE_CREATE_FLAG_CUBE_COMPATIBLE_BIT : 0u, /* in_create_flags          */
                                            get_image_layout(), nullptr);
 }
 
@@ -66,8 +87,8 @@ void CubeImages::prepare_for_render(std::shared_ptr<Anvil::PrimaryCommandBuffer>
   auto view = get_view_texture_array();
 
   Anvil::ImageBarrier image_barrier(VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, true, /* in_by_region_barrier */
-                                    this->get_image_layout(), VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, queue->get_queue_family_index(),
-                                    queue->get_queue_family_index(), images_, view->get_subresource_range());
+                                    this->get_image_layout(), VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, get_barrier_family(queue),
+                                    get_barrier_family(queue), images_, view->get_subresource_range());
 
   // lets hope the command_buffer is submitted
   image_layout_ = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
@@ -81,38 +102,65 @@ void CubeImages::prepare_for_render(std::shared_ptr<Anvil::PrimaryCommandBuffer>
                                           &image_barrier);
 }
 
-std::shared_ptr<Anvil::ImageView> CubeImages::get_view_cubemap()
+bool CubeImages::has_lazily_allocated_memory() const
 {
-  return Anvil::ImageView::create_cube_map(device_ptr_,
-                                           images_,  // image memory
-                                           0,        // base_layer
-                                           0,        // mipmap layer
-                                           1,        // mipmap count
-                                           get_image_aspects(), images_->get_image_format(), VK_COMPONENT_SWIZZLE_IDENTITY,
-                                           VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY);
+  // tile based GPUs can keep transient attachments in on chip memory, desktop GPUs have no such memory type
+  for (const auto &type : device_ptr_.lock()->get_physical_device_memory_properties().types) {
+    if (type.features & Anvil::MEMORY_FEATURE_FLAG_LAZILY_ALLOCATED) return true;
+  }
+  return false;
 }
 
-std::shared_ptr<Anvil::ImageView> CubeImages::get_view_single_face(uint32_t face)
+bool CubeImages::is_cube() const
+{
+  // cube compatible images cannot be multisampled
+  return layers_ == 6 && samples_ == VK_SAMPLE_COUNT_1_BIT;
+}
+
+std::shared_ptr<Anvil::ImageView> CubeImages::get_view_cubemap()
 {
   if (view_cube_map_ != nullptr) return view_cube_map_;
 
-  return view_cube_map_ = Anvil::ImageView::create_2D(device_ptr_,
-                                                      images_,  // image memory
-                                                      face,     // base_layer
-                                                      0,        // mipmap layer
-                                                      1,        // mipmap count
-                                                      get_image_aspects(), images_->get_image_format(), VK_COMPONENT_SWIZZLE_IDENTITY,
-                                                      VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY);
+  if (!is_cube()) {
+    return view_cube_map_ = Anvil::ImageView::create_2D_array(device_ptr_, images_, 0, layers_, 0, 1, get_image_aspects(),
+                                                              images_->get_image_format(), VK_COMPONENT_SWIZZLE_IDENTITY,
+                                                              VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+                                                              VK_COMPONENT_SWIZZLE_IDENTITY);
+  }
+
+  return view_cube_map_ = Anvil::ImageView::create_cube_map(device_ptr_,
+                                                            images_,  // image memory
+                                                            0,        // base_layer
+                                                            0,        // mipmap layer
+                                                            1,        // mipmap count
+                                                            get_image_aspects(), images_->get_image_format(), VK_COMPONENT_SWIZZLE_IDENTITY,
+                                                            VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+                                                            VK_COMPONENT_SWIZZLE_IDENTITY);
+}
+
+std::shared_ptr<Anvil::ImageView> CubeImages::get_view_single_face(uint32_t face)
+{
+  if (views_faces_.size() < layers_) views_faces_.resize(layers_);
+  if (views_faces_[face] != nullptr) return views_faces_[face];
+
+  return views_faces_[face] = Anvil::ImageView::create_2D(device_ptr_,
+                                                          images_,  // image memory
+                                                          face,     // base_layer
+                                                          0,        // mipmap layer
+                                                          1,        // mipmap count
+                                                          get_image_aspects(), images_->get_image_format(), VK_COMPONENT_SWIZZLE_IDENTITY,
+                                                          VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+                                                          VK_COMPONENT_SWIZZLE_IDENTITY);
 }
 
-std::shared_ptr<Anvil::ImageView> CubeImages::get_view_texture_array(uint32_t baseLayer /*= 0*/, uint32_t layers /*= 6*/)
+std::shared_ptr<Anvil::ImageView> CubeImages::get_view_texture_array()
 {
   if (view_texture_array_ != nullptr) return view_texture_array_;
 
   return view_texture_array_ =
            Anvil::ImageView::create_2D_array(device_ptr_,
                                              images_,  // image memory
-                                             baseLayer, layers, 0, 1, get_image_aspects(), images_->get_image_format(), VK_COMPONENT_SWIZZLE_IDENTITY,
+                                             0, layers_, 0, 1, get_image_aspects(), images_->get_image_format(), VK_COMPONENT_SWIZZLE_IDENTITY,
                                              VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY);
 }
 
@@ -148,15 +196,56 @@ void CubeImages::clear_images(const glm::vec4& color)
   queue->submit_command_buffer(command_buffer, true, nullptr);
 }
 
+void CubeImages::copy_from(std::shared_ptr<CubeImages> source)
+{
+  assert(source->render_size_ == render_size_ && source->get_image_format() == get_image_format() && source->layers_ == layers_ &&
+         source->samples_ == VK_SAMPLE_COUNT_1_BIT);
+
+  auto device{device_ptr_.lock()};
+  auto command_pool{device->get_command_pool(Anvil::QUEUE_FAMILY_TYPE_UNIVERSAL)};
+  auto queue = device->get_universal_queue(0);
+
+  source->images_->change_image_layout(queue, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, source->image_layout_, VK_ACCESS_TRANSFER_READ_BIT,
+                                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, source->get_subressource_range_cube());
+  images_->change_image_layout(queue, VK_ACCESS_SHADER_READ_BIT, image_layout_, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               get_subressource_range_cube());
+
+  auto command_buffer{command_pool->alloc_primary_level_command_buffer()};
+  command_buffer->start_recording(true, false);
+
+  VkImageCopy region;
+  region.srcOffset.x               = 0;
+  region.srcOffset.y               = 0;
+  region.srcOffset.z               = 0;
+  region.dstOffset                 = region.srcOffset;
+  region.srcSubresource.aspectMask = region.dstSubresource.aspectMask = get_image_aspects();
+  region.srcSubresource.baseArrayLayer = region.dstSubresource.baseArrayLayer = 0;
+  region.srcSubresource.layerCount = region.dstSubresource.layerCount = layers_;
+  region.srcSubresource.mipLevel = region.dstSubresource.mipLevel = 0;
+  region.extent.depth                                             = 1;
+  region.extent.width                                             = render_size_.x;
+  region.extent.height                                            = render_size_.y;
+
+  command_buffer->record_copy_image(source->images_, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, images_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+  command_buffer->stop_recording();
+
+  queue->submit_command_buffer(command_buffer, true, nullptr);
+
+  source->images_->change_image_layout(queue, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                                       source->image_layout_, source->get_subressource_range_cube());
+  images_->change_image_layout(queue, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, image_layout_,
+                               get_subressource_range_cube());
+}
+
 std::shared_ptr<Anvil::ImageView> CubeImages::get_storage_image_view(std::shared_ptr<Anvil::PrimaryCommandBuffer> command_buffer,
                                                                      std::shared_ptr<Anvil::Queue> queue)
 {
   if (images_->get_image_usage() & VK_IMAGE_USAGE_STORAGE_BIT && image_format_ == compute_image_format_) {
     auto view = get_view_texture_array();
 
-    Anvil::ImageBarrier image_barrier(VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, true, /* in_by_region_barrier */
-                                      this->get_image_layout(), VK_IMAGE_LAYOUT_GENERAL, queue->get_queue_family_index(),
-                                      queue->get_queue_family_index(), images_, view->get_subresource_range());
+    Anvil::ImageBarrier image_barrier(get_write_access(queue), VK_ACCESS_SHADER_READ_BIT, true, /* in_by_region_barrier */
+                                      this->get_image_layout(), VK_IMAGE_LAYOUT_GENERAL, get_barrier_family(queue), get_barrier_family(queue),
+                                      images_, view->get_subresource_range());
 
     // lets hope the command_buffer is submitted
     image_layout_ = VK_IMAGE_LAYOUT_GENERAL;
@@ -172,14 +261,38 @@ std::shared_ptr<Anvil::ImageView> CubeImages::get_storage_image_view(std::shared
     return view;
   }
 
-  auto staging = Anvil::Image::create_nonsparse(
-    device_ptr_, VK_IMAGE_TYPE_2D, compute_image_format_, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-    render_size_.x, render_size_.y, 1,                                                        /* in_base_mipmap_depth */
-    8,                                                                                        /* in_n_layers          */
-    VK_SAMPLE_COUNT_1_BIT, Anvil::QUEUE_FAMILY_COMPUTE_BIT, VK_SHARING_MODE_EXCLUSIVE, false, /* in_use_full_mipmap_chain */
-    0,                                                                                        /* in_memory_features  */
-    0,                                                                                        /* in_create_flags          */
-    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, nullptr);
+  // images that cannot be bound as storage image are blitted into a staging image, which is allocated once. Its initial layout is set on the
+  // universal queue, so it is shared like the render targets
+  if (staging_ == nullptr) {
+    const auto queues = get_device_queues(device_ptr_.lock());
+    staging_          = Anvil::Image::create_nonsparse(
+      device_ptr_, VK_IMAGE_TYPE_2D, compute_image_format_, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+      render_size_.x, render_size_.y, 1,                                                    /* in_base_mipmap_depth */
+      layers_,                                                                              /* in_n_layers          */
+      VK_SAMPLE_COUNT_1_BIT, queues.get_queue_families(), queues.get_sharing_mode(), false, /* in_use_full_mipmap_chain */
+      0,                                                                                    /* in_memory_features  */
+      0,                                                                                    /* in_create_flags          */
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, nullptr);
+
+    staging_view_ = Anvil::ImageView::create_2D_array(device_ptr_,
+                                                      staging_,  // image memory
+                                                      0, layers_, 0, 1, get_image_aspects(), staging_->get_image_format(),
+                                                      VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+                                                      VK_COMPONENT_SWIZZLE_IDENTITY);
+  }
+
+  // the previous content is overwritten
+  Anvil::ImageBarrier transfer_barrier(VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, true, /* in_by_region_barrier */
+                                       VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, get_barrier_family(queue),
+                                       get_barrier_family(queue), staging_, staging_view_->get_subresource_range());
+
+  command_buffer->record_pipeline_barrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_FALSE, /* in_by_region */
+                                          0,       /* in_memory_barrier_count        */
+                                          nullptr, /* in_memory_barrier_ptrs         */
+                                          0,       /* in_buffer_memory_barrier_count */
+                                          nullptr, /* in_buffer_memory_barrier_ptrs  */
+                                          1,       /* in_image_memory_barrier_count  */
+                                          &transfer_barrier);
 
   VkImageBlit region;
 
@@ -187,29 +300,25 @@ std::shared_ptr<Anvil::ImageView> CubeImages::get_storage_image_view(std::shared
   region.srcOffsets[0].y = 0;
   region.srcOffsets[0].z = 0;
 
+  // the layers are selected by the subresource
   region.srcOffsets[1].x = render_size_.x;
   region.srcOffsets[1].y = render_size_.y;
-  region.srcOffsets[1].z = 5;
+  region.srcOffsets[1].z = 1;
 
   region.dstOffsets[0] = region.srcOffsets[0];
   region.dstOffsets[1] = region.srcOffsets[1];
 
   region.srcSubresource.aspectMask     = get_image_aspects();
   region.srcSubresource.baseArrayLayer = 0;
-  region.srcSubresource.layerCount     = 6;
+  region.srcSubresource.layerCount     = layers_;
   region.srcSubresource.mipLevel       = 0;
   region.dstSubresource                = region.srcSubresource;
 
-  command_buffer->record_blit_image(images_, image_layout_, staging, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_NEAREST);
+  command_buffer->record_blit_image(images_, image_layout_, staging_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_NEAREST);
 
-  auto view = Anvil::ImageView::create_2D_array(device_ptr_,
-                                                staging,  // image memory
-                                                0, 6, 0, 1, get_image_aspects(), staging->get_image_format(), VK_COMPONENT_SWIZZLE_IDENTITY,
-                                                VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY);
-
-  Anvil::ImageBarrier image_barrier(VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, true, /* in_by_region_barrier */
-                                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL, queue->get_queue_family_index(),
-                                    queue->get_queue_family_index(), staging, view->get_subresource_range());
+  Anvil::ImageBarrier image_barrier(VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, true, /* in_by_region_barrier */
+                                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL, get_barrier_family(queue),
+                                    get_barrier_family(queue), staging_, staging_view_->get_subresource_range());
 
   command_buffer->record_pipeline_barrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_FALSE, /* in_by_region */
                                           0,       /* in_memory_barrier_count        */
@@ -219,40 +328,21 @@ std::shared_ptr<Anvil::ImageView> CubeImages::get_storage_image_view(std::shared
                                           1,       /* in_image_memory_barrier_count  */
                                           &image_barrier);
 
-  return view;
+  return staging_view_;
 }
 
-// TODO much better implementation
-
 std::shared_ptr<ImageCPU> CubeImages::retrieve_images(bool pretty)
 {
-  auto device{device_ptr_.lock()};
-
-  auto command_pool{device->get_command_pool(Anvil::QUEUE_FAMILY_TYPE_UNIVERSAL)};
-  auto queue = device->get_universal_queue(0);
-
-  // 		auto command_buffer{ command_pool->alloc_primary_level_command_buffer() };
-  // 		command_buffer->start_recording(true, false);
-
-  images_->change_image_layout(queue, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, image_layout_, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, get_subressource_range_cube());
-  image_layout_ = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  assert(samples_ == VK_SAMPLE_COUNT_1_BIT);
 
   auto flat = get_flattened(pretty);
 
-  queue = device->get_universal_queue(0);
-  flat->change_image_layout(queue, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-                            VK_IMAGE_LAYOUT_GENERAL, flat->get_subresource_range());
-
   const auto memory_req = flat->get_memory_requirements();
   auto memory           = flat->get_memory_block();
 
   auto dim   = flat->get_image_extent_2D(0);
   auto image = std::make_shared<ImageCPU>(glm::ivec2(dim.width, dim.height));
 
-  // memory->map(0, memory_req.size, &mapedPixels);
-  // memcpy(&pixels[0], mapedPixels, memory_req.size);
-  // memory->unmap();
   memory->read(0, memory_req.size, image->get_pixel_data());
 
   return image;
@@ -260,23 +350,37 @@ std::shared_ptr<ImageCPU> CubeImages::retrieve_images(bool pretty)
 
 std::shared_ptr<Anvil::Image> CubeImages::get_flattened(bool nice)
 {
+  auto device{device_ptr_.lock()};
+  const auto queues = get_device_queues(device);
+
+  // images shared by the queue families are copied on the transfer queue, the others on the universal queue that owns them. The staging image
+  // is shared in the same way, as its initial layout is set on the universal queue
+  const bool shared = sharing_mode_ == VK_SHARING_MODE_CONCURRENT;
+  auto queue        = shared ? queues.transfer : queues.graphics;
+  auto command_pool = shared ? queues.transfer_pool : queues.graphics_pool;
+  const Anvil::QueueFamilyBits families = shared ? queues.get_queue_families() : Anvil::QUEUE_FAMILY_GRAPHICS_BIT;
+
   auto staging = Anvil::Image::create_nonsparse(
     device_ptr_, VK_IMAGE_TYPE_2D, get_image_format(), VK_IMAGE_TILING_LINEAR, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-    nice ? render_size_.x * 4 : render_size_.x * 3, nice ? render_size_.y * 3 : render_size_.y * 2, 1, /* in_base_mipmap_depth */
-    1,                                                                                                 /* in_n_layers          */
-    VK_SAMPLE_COUNT_1_BIT, Anvil::QUEUE_FAMILY_GRAPHICS_BIT, VK_SHARING_MODE_EXCLUSIVE, false,         /* in_use_full_mipmap_chain */
-    Anvil::MEMORY_FEATURE_FLAG_MAPPABLE,                                                               /* in_memory_features  */
-    0,                                                                                                 /* in_create_flags          */
+    layers_ == 1 ? render_size_.x : nice ? render_size_.x * 4 : render_size_.x * 3,
+    layers_ == 1 ? render_size_.y : nice ? render_size_.y * 3 : render_size_.y * 2, 1, /* in_base_mipmap_depth */
+    1,                                                                                  /* in_n_layers          */
+    VK_SAMPLE_COUNT_1_BIT, families, sharing_mode_, false,                              /* in_use_full_mipmap_chain */
+    Anvil::MEMORY_FEATURE_FLAG_MAPPABLE,                                                /* in_memory_features  */
+    0,                                                                                  /* in_create_flags          */
     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, nullptr);
 
-  auto device{device_ptr_.lock()};
-
-  auto command_pool{device->get_command_pool(Anvil::QUEUE_FAMILY_TYPE_UNIVERSAL)};
-  auto queue = device->get_universal_queue(0);
-
   auto command_buffer{command_pool->alloc_primary_level_command_buffer()};
   command_buffer->start_recording(true, false);
 
+  // the layout transitions are recorded with the copy, so all of it waits for the pending rendering into the image
+  Anvil::ImageBarrier source_barrier(get_write_access(queue), VK_ACCESS_TRANSFER_READ_BIT, true, /* in_by_region_barrier */
+                                     image_layout_, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, get_barrier_family(queue), get_barrier_family(queue),
+                                     images_, get_subressource_range_cube());
+  command_buffer->record_pipeline_barrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_FALSE, /* in_by_region */
+                                          0, nullptr, 0, nullptr, 1, &source_barrier);
+  image_layout_ = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
   std::vector<VkImageCopy> regions;
   VkImageCopy region;
   region.srcOffset.x               = 0;
@@ -291,7 +395,11 @@ std::shared_ptr<Anvil::Image> CubeImages::get_flattened(bool nice)
   region.extent.width                                             = render_size_.y;
   region.extent.height                                            = render_size_.x;
 
-  if (nice) {
+  if (layers_ == 1) {
+    region.dstOffset.x = 0;
+    region.dstOffset.y = 0;
+    regions.push_back(region);
+  } else if (nice) {
     for (auto i = 0; i < 6; i++) {
       switch (i) {
         case 0:
@@ -336,16 +444,51 @@ std::shared_ptr<Anvil::Image> CubeImages::get_flattened(bool nice)
   command_buffer->record_copy_image(images_, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, staging, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                     static_cast<uint32_t>(regions.size()), regions.data());
 
+  // the host reads the linear image in the general layout
+  Anvil::ImageBarrier host_barrier(VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT, false, /* in_by_region_barrier */
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL, get_barrier_family(queue),
+                                   get_barrier_family(queue), staging, staging->get_subresource_range());
+  command_buffer->record_pipeline_barrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_FALSE, /* in_by_region */
+                                          0, nullptr, 0, nullptr, 1, &host_barrier);
+
   command_buffer->stop_recording();
 
-  queue->submit_command_buffer(command_buffer, true, nullptr);
+  submit_after_writes(queue, command_buffer);
 
   return staging;
 }
 
+void CubeImages::submit_after_writes(std::shared_ptr<Anvil::Queue> queue, std::shared_ptr<Anvil::PrimaryCommandBuffer> command_buffer)
+{
+  if (write_semaphore_ == nullptr) {
+    queue->submit_command_buffer(command_buffer, true, nullptr);
+    return;
+  }
+
+  // the semaphore is waited for once, the submissions after this one are ordered by blocking
+  const VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+  queue->submit_command_buffer_with_wait_semaphores(command_buffer, 1, &write_semaphore_, &wait_stage, true, nullptr);
+  write_semaphore_ = nullptr;
+}
+
+uint32_t CubeImages::get_barrier_family(const std::shared_ptr<Anvil::Queue> &queue) const
+{
+  return sharing_mode_ == VK_SHARING_MODE_CONCURRENT ? VK_QUEUE_FAMILY_IGNORED : queue->get_queue_family_index();
+}
+
+VkAccessFlags CubeImages::get_write_access(const std::shared_ptr<Anvil::Queue> &queue) const
+{
+  if (usage_ == USAGE_STORAGE) return VK_ACCESS_SHADER_WRITE_BIT;
+
+  // attachment writes cannot be named on compute or transfer queues, the write semaphore makes them visible there
+  auto device{device_ptr_.lock()};
+  const bool universal = queue->get_queue_family_index() == device->get_queue_family_index(Anvil::QUEUE_FAMILY_TYPE_UNIVERSAL);
+  return universal ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : 0;
+}
+
 void CubeImages::upload_images(const std::vector<std::shared_ptr<ImageCPU>>& faces)
 {
-  assert(faces.size() == 6);
+  assert(faces.size() == 6 && layers_ == 6);
 
   // create a flat image all images below (behind) each other
   // if max image size limit is reached (prob 16k / 6) ~= 2048 then rewrite this algo
@@ -438,7 +581,7 @@ VkImageSubresourceRange CubeImages::get_subressource_range_cube() const
   range.aspectMask     = get_image_aspects();
   range.baseArrayLayer = 0;
   range.baseMipLevel   = 0;
-  range.layerCount     = 6;
+  range.layerCount     = layers_;
   range.levelCount     = 1;
 
   return range;
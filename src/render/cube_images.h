@@ -1,6 +1,8 @@
 #ifndef QUAVIS_RENDER_CUBE_IMAGES
 #define QUAVIS_RENDER_CUBE_IMAGES
 
+#include <vector>
+
 #include <glm/glm.hpp>
 
 #include "../utils/image_cpu.h"
@@ -8,6 +10,7 @@
 
 namespace quavis {
 
+/// the 6 faces of a cube map as layers of one image, or a single layer for projections that fit the sphere into one image
 class CubeImages {
  public:
   /// different ways to use this image cube
@@ -15,11 +18,14 @@ class CubeImages {
     USAGE_COLOR_ATTACHMENT = 0,
     USAGE_DEPTH_ATTACHMENT = 1,
     USAGE_COLOR_TEXTURE    = 2,
+    USAGE_STORAGE          = 3,  ///< written and read by compute shaders
 
   };
 
-  /// create an empty texture that can be used for usage
-  CubeImages(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2 &render_size_, const Usages usage);
+  /// create an empty texture that can be used for usage, with 6 layers (cube) or 1 layer. Attachments can be multisampled, their cube map view
+  /// is then a 2d array view. Color images have color_format, the depth attachment is transient and its content is not kept after rendering
+  CubeImages(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2 &render_size_, const Usages usage, uint32_t layers = 6,
+             VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT, VkFormat color_format = VK_FORMAT_R32G32B32A32_SFLOAT);
 
   /// creates a cube image for pre initialized with ImageCPU faces, can be used as color texture.
   CubeImages(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const std::vector<std::shared_ptr<ImageCPU>> &faces);
@@ -30,37 +36,66 @@ class CubeImages {
   /// prepares the image cube to be used as an attachment next.
   void prepare_for_render(std::shared_ptr<Anvil::PrimaryCommandBuffer> &command_buffer, std::shared_ptr<Anvil::Queue> &queue);
 
-  /// get cube map view
+  /// get cube map view, a 2d array view if there are not 6 layers or the image is multisampled. The views are created once and reused
   std::shared_ptr<Anvil::ImageView> get_view_cubemap();
   /// get a 2d view of one face
   std::shared_ptr<Anvil::ImageView> get_view_single_face(uint32_t face);
-  /// get a texture array view with 6 layers
-  std::shared_ptr<Anvil::ImageView> get_view_texture_array(uint32_t baseLayer = 0, uint32_t layers = 6);
-  /// get a storage image view with 6 layers
+  /// get a texture array view with all layers
+  std::shared_ptr<Anvil::ImageView> get_view_texture_array();
+  /// get a storage image view with all layers
   std::shared_ptr<Anvil::ImageView> get_storage_image_view(std::shared_ptr<Anvil::PrimaryCommandBuffer> command_buffer,
                                                            std::shared_ptr<Anvil::Queue> queue);
 
+  /// the next submission reading the image waits for semaphore, which is signalled when the pending rendering into the image is done. Needed
+  /// when the image is read on another queue than the one it was rendered on
+  void set_write_semaphore(std::shared_ptr<Anvil::Semaphore> semaphore) { write_semaphore_ = semaphore; }
+  /// true if the semaphore of set_write_semaphore was not waited for yet
+  bool has_write_semaphore() const { return write_semaphore_ != nullptr; }
+  /// submits command_buffer reading the image to queue after the pending rendering into the image, blocks until it is done
+  void submit_after_writes(std::shared_ptr<Anvil::Queue> queue, std::shared_ptr<Anvil::PrimaryCommandBuffer> command_buffer);
+
+  /// copies all faces of source (same size and format, single sampled) into this image, both images keep their layout
+  void copy_from(std::shared_ptr<CubeImages> source);
+
   /// clear image, normally not needed use render pass clear instead.
   void clear_images(const glm::vec4 &color);
 
   /// upload the image as one single cpu image, pretty false gives two row of each 3 images for all 6 faces, pretty true gives an unfolded view.
+  /// A single layer is returned as it is. Not available for multisampled images.
   std::shared_ptr<ImageCPU> retrieve_images(bool pretty = false);
 
   const VkFormat get_image_format() const;
   const VkImageUsageFlags get_image_usage() const;
   const VkImageAspectFlagBits get_image_aspects() const;
   const VkImageLayout get_image_layout() const;
+  /// sets the layout the image is in after a command buffer recorded once (with get_storage_image_view or prepare_for_render) is submitted again
+  void set_image_layout(VkImageLayout layout) { image_layout_ = layout; }
 
   VkImageSubresourceRange get_subressource_range_cube() const;
   VkImageSubresourceRange get_subressource_range_face(uint32_t face) const;
-  VkImageSubresourceRange get_subressource_range_face(uint32_t baseLayer = 0, uint32_t layers = 6) const;
+  VkImageSubresourceRange get_subressource_range_face(uint32_t baseLayer, uint32_t layers) const;
+
+  /// number of layers, 6 for a cube
+  uint32_t get_layers() const { return layers_; }
+  /// samples per texel
+  VkSampleCountFlagBits get_samples() const { return samples_; }
 
  private:
   std::shared_ptr<Anvil::Image> get_flattened(bool nice = false);
+  /// family index of queue for barriers, ignored if the image is shared by several queue families
+  uint32_t get_barrier_family(const std::shared_ptr<Anvil::Queue> &queue) const;
+  /// access of the last writes to the image as named by barriers on queue, writes on other queues are made visible by the write semaphore
+  VkAccessFlags get_write_access(const std::shared_ptr<Anvil::Queue> &queue) const;
+  /// true if the image can be viewed as a cube map
+  bool is_cube() const;
+  /// true if the device has memory that is only allocated when used
+  bool has_lazily_allocated_memory() const;
 
   VkFormat compute_image_format_;
   glm::ivec2 render_size_;
   Usages usage_;
+  uint32_t layers_;
+  VkSampleCountFlagBits samples_;
 
   std::weak_ptr<Anvil::SGPUDevice> device_ptr_;
   std::shared_ptr<Anvil::Image> images_;
@@ -72,10 +107,19 @@ class CubeImages {
 
   Anvil::MemoryFeatureFlags memory_features_;
   VkImageTiling tiling_;
+  VkSharingMode sharing_mode_;
+
+  /// signalled when the pending rendering into the image is done, waited for by the next submission reading it
+  std::shared_ptr<Anvil::Semaphore> write_semaphore_;
 
   // views
   std::shared_ptr<Anvil::ImageView> view_cube_map_;
   std::shared_ptr<Anvil::ImageView> view_texture_array_;
+  std::vector<std::shared_ptr<Anvil::ImageView>> views_faces_;
+
+  /// copy of the image for get_storage_image_view if the image itself cannot be bound as storage image
+  std::shared_ptr<Anvil::Image> staging_;
+  std::shared_ptr<Anvil::ImageView> staging_view_;
 };
 }  // namespace quavis
 
@@ -0,0 +1,58 @@
+#ifndef QUAVIS_RENDER_DEVICE_QUEUES
+#define QUAVIS_RENDER_DEVICE_QUEUES
+
+#include <memory>
+
+#include "./anvil.h"
+
+namespace quavis {
+
+/// the queues work is submitted to. Rendering uses the universal queue, compute stages and readbacks use a dedicated compute and transfer queue
+/// where the GPU has one, so they run while the next view is rendered. Without them all work falls back to the universal queue
+struct DeviceQueues {
+  std::shared_ptr<Anvil::Queue> graphics;
+  std::shared_ptr<Anvil::Queue> compute;
+  std::shared_ptr<Anvil::Queue> transfer;
+
+  std::shared_ptr<Anvil::CommandPool> graphics_pool;
+  std::shared_ptr<Anvil::CommandPool> compute_pool;
+  std::shared_ptr<Anvil::CommandPool> transfer_pool;
+
+  /// true if the compute stages run on their own queue
+  bool has_async_compute() const { return compute != graphics; }
+  /// true if more than one queue family is used, images written on one and read on another need a semaphore and concurrent sharing
+  bool is_shared() const { return compute != graphics || transfer != graphics; }
+
+  /// the families of all queues, for resources used by each of them (without a compute family the compute bit maps to the universal family)
+  Anvil::QueueFamilyBits get_queue_families() const
+  {
+    return Anvil::QUEUE_FAMILY_GRAPHICS_BIT | Anvil::QUEUE_FAMILY_COMPUTE_BIT | (transfer != graphics ? Anvil::QUEUE_FAMILY_DMA_BIT : 0);
+  }
+  VkSharingMode get_sharing_mode() const { return is_shared() ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE; }
+};
+
+/// the queues of device, compute and transfer are the universal queue if the device has no queue family of their own
+inline DeviceQueues get_device_queues(std::shared_ptr<Anvil::SGPUDevice> device)
+{
+  DeviceQueues queues;
+  queues.graphics      = device->get_universal_queue(0);
+  queues.graphics_pool = device->get_command_pool(Anvil::QUEUE_FAMILY_TYPE_UNIVERSAL);
+
+  queues.compute      = queues.graphics;
+  queues.compute_pool = queues.graphics_pool;
+  if (device->get_n_compute_queues() > 0) {
+    queues.compute      = device->get_compute_queue(0);
+    queues.compute_pool = device->get_command_pool(Anvil::QUEUE_FAMILY_TYPE_COMPUTE);
+  }
+
+  queues.transfer      = queues.graphics;
+  queues.transfer_pool = queues.graphics_pool;
+  if (device->get_n_transfer_queues() > 0) {
+    queues.transfer      = device->get_transfer_queue(0);
+    queues.transfer_pool = device->get_command_pool(Anvil::QUEUE_FAMILY_TYPE_TRANSFER);
+  }
+  return queues;
+}
+}  // namespace quavis
+
+#endif
@@ -1,11 +1,17 @@
 #include "drawable_geometry.h"
 
+#include <cstring>
+#include <limits>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
 quavis::DrawableGeometry::DrawableGeometry(std::vector<glm::vec3>&& positions, std::vector<glm::vec4>&& per_vertex_data,
                                            std::vector<uint32_t>&& indicies)
   : indicies_(std::move(indicies))
 {
-  assert(indicies.size() % 3 == 0);                    // because we draw triangles
-  assert(positions.size() == per_vertex_data.size());  // because we need same amount of vertex data
+  assert(indicies_.size() % 3 == 0);                                           // because we draw triangles
+  assert(per_vertex_data.empty() || positions.size() == per_vertex_data.size());  // because we need same amount of vertex data or none
 
   for (const auto& p : positions) {
     positions_.push_back(p.x);
@@ -19,6 +25,8 @@ quavis::DrawableGeometry::DrawableGeometry(std::vector<glm::vec3>&& positions, s
     per_vertex_data_.push_back(p.z);
     per_vertex_data_.push_back(p.w);
   }
+
+  compute_bounds();
 }
 
 quavis::DrawableGeometry::DrawableGeometry(std::vector<float>&& positions, std::vector<float>&& per_vertex_data, std::vector<uint32_t>&& indicies)
@@ -26,11 +34,101 @@ quavis::DrawableGeometry::DrawableGeometry(std::vector<float>&& positions, std::
   , per_vertex_data_(std::move(per_vertex_data))
   , indicies_(std::move(indicies))
 {
-  assert(positions.size() % 3 == 0);                           // because we need 3 coordiantes
-  assert(per_vertex_data.size() % 4 == 0);                     // because we need 4 coordiantes
-  assert(indicies.size() % 3 == 0);                            // because we draw triangles
-  assert(positions.size() / 3 == per_vertex_data.size() % 4);  // because we need same amount of vertex data
+  assert(positions_.size() % 3 == 0);        // because we need 3 coordiantes
+  assert(per_vertex_data_.size() % 4 == 0);  // because we need 4 coordiantes
+  assert(indicies_.size() % 3 == 0);         // because we draw triangles
+  assert(per_vertex_data_.empty() || positions_.size() / 3 == per_vertex_data_.size() / 4);  // because we need same amount of vertex data or none
+
+  compute_bounds();
+}
+
+quavis::MeshOptimizer::Statistics quavis::DrawableGeometry::optimize()
+{
+  assert(vbos_.empty());         // because the data is already uploaded
+  assert(lod_levels_.empty());  // because the levels are ranges of the indices
+
+  const auto stats = MeshOptimizer::optimize(positions_, per_vertex_data_, indicies_);
+  compute_bounds();
+  return stats;
+}
+
+void quavis::DrawableGeometry::build_meshlets(size_t min_triangles, uint32_t triangles_per_meshlet)
+{
+  assert(vbos_.empty());         // because the data is already uploaded
+  assert(lod_levels_.empty());  // because the levels are ranges of the indices
+
+  if (indicies_.size() / 3 <= min_triangles) return;
+
+  meshlets_ = MeshOptimizer::build_meshlets(positions_, indicies_, triangles_per_meshlet);
+  // the morton order changed the index order, keep the vertices in the same order
+  MeshOptimizer::reorder_vertices_by_first_use(positions_, per_vertex_data_, indicies_);
+}
+
+void quavis::DrawableGeometry::build_lod_chain(size_t max_levels)
+{
+  assert(vbos_.empty());  // because the data is already uploaded
+  assert(lod_levels_.empty());
+
+  if (max_levels == 0 || indicies_.empty()) return;
+
+  const auto base_count = static_cast<uint32_t>(indicies_.size());
+  std::vector<LodLevel> levels{{0, base_count, 0.0f}};
+
+  // halve the grid resolution per level, levels that do not remove at least a quarter of the triangles are skipped
+  uint32_t last_count = base_count;
+  for (uint32_t cells = 128; cells >= 2 && levels.size() <= max_levels; cells /= 2) {
+    const float cell_size = 2.0f * bounds_radius_ / static_cast<float>(cells);
+    if (cell_size <= 0.0f) break;
+
+    auto lod = MeshOptimizer::simplify_vertex_clustering(positions_, per_vertex_data_, std::vector<uint32_t>(indicies_.begin(), indicies_.begin() + base_count),
+                                                         cell_size);
+    if (lod.empty()) break;
+    if (lod.size() * 4 > last_count * 3) continue;
+
+    MeshOptimizer::reorder_for_vertex_cache(positions_.size() / 3, lod);
+
+    levels.push_back({static_cast<uint32_t>(indicies_.size()), static_cast<uint32_t>(lod.size()), glm::sqrt(3.0f) * cell_size});
+    indicies_.insert(indicies_.end(), lod.begin(), lod.end());
+    last_count = static_cast<uint32_t>(lod.size());
+  }
+
+  if (levels.size() > 1) {
+    lod_levels_ = std::move(levels);
+  }
+}
+
+void quavis::DrawableGeometry::compute_bounds()
+{
+  glm::vec3 min_pos(std::numeric_limits<float>::max());
+  glm::vec3 max_pos(std::numeric_limits<float>::lowest());
+  for (size_t i = 0; i < positions_.size(); i += 3) {
+    const glm::vec3 p(positions_[i + 0], positions_[i + 1], positions_[i + 2]);
+    min_pos = glm::min(min_pos, p);
+    max_pos = glm::max(max_pos, p);
+  }
+
+  if (positions_.empty()) {
+    min_pos = max_pos = glm::vec3(0);
+  }
+
+  bounds_center_ = (min_pos + max_pos) * 0.5f;
+  bounds_radius_ = glm::distance(min_pos, max_pos) * 0.5f;
+}
+
+size_t quavis::DrawableGeometry::select_lod(float distance, float max_angle) const
+{
+  // distance to the nearest point of the bounding sphere
+  const float surface_distance = distance - bounds_radius_;
+  if (surface_distance <= 0.0f) return 0;
+
+  size_t level = 0;
+  for (size_t i = 1; i < lod_levels_.size(); i++) {
+    if (lod_levels_[i].error > max_angle * surface_distance) break;
+    level = i;
+  }
+  return level;
 }
+
 #if 0  // first version not optimized
 void quavis::DrawableGeometry::prepare_for_draw(std::weak_ptr<Anvil::SGPUDevice> device_ptr)
 {
@@ -52,13 +150,22 @@ void quavis::DrawableGeometry::prepare_for_draw(std::weak_ptr<Anvil::SGPUDevice>
 {
   auto allocator{Anvil::MemoryAllocator::create_vma(device_ptr)};
 
+  vbos_.clear();
+  vbos_offsets_.clear();
+
+  const auto positions   = encode_positions();
+  const auto vertex_data = encode_vertex_data();
+  const auto indices     = encode_indices();
+
   // vertex buffer data
   VkDeviceSize size_data = 0;
   vbos_offsets_.push_back(size_data);
-  size_data += positions_.size() * sizeof(positions_[0]);
+  size_data += positions.size();
 
-  vbos_offsets_.push_back(size_data);
-  size_data += per_vertex_data_.size() * sizeof(per_vertex_data_[0]);
+  if (has_vertex_data()) {
+    vbos_offsets_.push_back(size_data);
+    size_data += vertex_data.size();
+  }
 
   auto vbo = Anvil::Buffer::create_nonsparse(device_ptr, size_data, Anvil::QUEUE_FAMILY_GRAPHICS_BIT, VK_SHARING_MODE_EXCLUSIVE,
                                              VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
@@ -67,29 +174,245 @@ void quavis::DrawableGeometry::prepare_for_draw(std::weak_ptr<Anvil::SGPUDevice>
 
   // now push it twice (for position and data)
   vbos_.push_back(vbo);
-  vbos_.push_back(vbo);
+  if (has_vertex_data()) {
+    vbos_.push_back(vbo);
+  }
 
   assert(vbos_offsets_.size() == vbos_.size());
 
   // create ibo
   // this is the first write so here memory is really reserved. other writes behind this
-  indicies_vbo_ = download_to_new_vbo(device_ptr, allocator, indicies_, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+  indicies_vbo_ = download_to_new_vbo(device_ptr, allocator, indices, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
 
   vbo->write(vbos_offsets_[0], /* start_offset */
-             positions_.size() * sizeof(positions_[0]), positions_.data());
+             positions.size(), positions.data());
+
+  if (has_vertex_data()) {
+    vbo->write(vbos_offsets_[1], /* start_offset */
+               vertex_data.size(), vertex_data.data());
+  }
 
-  vbo->write(vbos_offsets_[1], /* start_offset */
-             per_vertex_data_.size() * sizeof(per_vertex_data_[0]), per_vertex_data_.data());
+  gpu_byte_size_ = size_data + indices.size();
+
+  vbo_handles_.clear();
+  for (const auto &buffer : vbos_) {
+    vbo_handles_.push_back(buffer->get_buffer());
+  }
+  indices_handle_ = indicies_vbo_->get_buffer();
 }
 
 #endif
 
-void quavis::DrawableGeometry::draw(std::weak_ptr<Anvil::SGPUDevice> device_ptr, std::shared_ptr<Anvil::PrimaryCommandBuffer> command_buffer)
+void quavis::DrawableGeometry::release_gpu()
+{
+  vbos_.clear();
+  vbos_offsets_.clear();
+  indicies_vbo_.reset();
+  vbo_handles_.clear();
+  indices_handle_ = VK_NULL_HANDLE;
+  gpu_byte_size_  = 0;
+}
+
+void quavis::DrawableGeometry::draw(const std::weak_ptr<Anvil::SGPUDevice> &device_ptr,
+                                    const std::shared_ptr<Anvil::CommandBufferBase> &command_buffer, size_t lod_level)
+{
+  // raw commands, the wrappers search all buffers referenced by the command buffer on each call. The buffers are kept alive by this geometry,
+  // release_gpu is only called between draws
+  const auto commands = command_buffer->get_command_buffer();
+  vkCmdBindVertexBuffers(commands, 0, static_cast<uint32_t>(vbo_handles_.size()), vbo_handles_.data(), vbos_offsets_.data());
+  vkCmdBindIndexBuffer(commands, indices_handle_, 0, get_index_type());
+  if (lod_levels_.empty()) {
+    vkCmdDrawIndexed(commands, static_cast<uint32_t>(indicies_.size()), 1, 0, 0, 0);
+  } else {
+    const auto &lod = lod_levels_[lod_level];
+    vkCmdDrawIndexed(commands, lod.index_count, 1, lod.first_index, 0, 0);
+  }
+}
+
+size_t quavis::DrawableGeometry::draw_culled(const std::weak_ptr<Anvil::SGPUDevice> &device_ptr,
+                                             const std::shared_ptr<Anvil::CommandBufferBase> &command_buffer, const glm::vec3& eye)
+{
+  if (meshlets_.empty()) {
+    draw(device_ptr, command_buffer);
+    return 0;
+  }
+
+  const auto commands = command_buffer->get_command_buffer();
+  vkCmdBindVertexBuffers(commands, 0, static_cast<uint32_t>(vbo_handles_.size()), vbo_handles_.data(), vbos_offsets_.data());
+  vkCmdBindIndexBuffer(commands, indices_handle_, 0, get_index_type());
+
+  // neighbouring visible meshlets are drawn in one call
+  size_t culled      = 0;
+  uint32_t first     = 0;
+  uint32_t count     = 0;
+  for (const auto& m : meshlets_) {
+    if (MeshOptimizer::is_backfacing(m, eye)) {
+      culled++;
+      continue;
+    }
+
+    if (count > 0 && first + count == m.first_index) {
+      count += m.index_count;
+    } else {
+      if (count > 0) vkCmdDrawIndexed(commands, count, 1, first, 0, 0);
+      first = m.first_index;
+      count = m.index_count;
+    }
+  }
+  if (count > 0) vkCmdDrawIndexed(commands, count, 1, first, 0, 0);
+
+  return culled;
+}
+
+void quavis::DrawableGeometry::set_vertex_compression(const VertexCompression& compression)
+{
+  assert(vbos_.empty());  // because the formats are fixed once uploaded
+
+  compression_ = compression;
+
+  if (compression_.vertex_data_format == VK_FORMAT_R8G8B8A8_UNORM) {
+    // 8 bit normalized can only hold [0, 1], group ids or other data would be clamped
+    for (const auto& d : per_vertex_data_) {
+      if (d < 0.0f || d > 1.0f) {
+        compression_.vertex_data_format = VK_FORMAT_R16G16B16A16_SFLOAT;
+        break;
+      }
+    }
+  }
+}
+
+VkFormat quavis::DrawableGeometry::get_position_format() const
+{
+  return compression_.quantize_positions ? VK_FORMAT_R16G16B16A16_UNORM : VK_FORMAT_R32G32B32_SFLOAT;
+}
+
+uint32_t quavis::DrawableGeometry::get_position_stride() const
+{
+  return compression_.quantize_positions ? 4 * sizeof(uint16_t) : sizeof(glm::vec3);
+}
+
+VkFormat quavis::DrawableGeometry::get_vertex_data_format() const
+{
+  return has_vertex_data() ? compression_.vertex_data_format : VK_FORMAT_UNDEFINED;
+}
+
+uint32_t quavis::DrawableGeometry::get_vertex_data_stride() const
+{
+  switch (get_vertex_data_format()) {
+    case VK_FORMAT_UNDEFINED:
+      return 0;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+      return 4 * sizeof(uint8_t);
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+      return 4 * sizeof(uint16_t);
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+      return sizeof(glm::vec4);
+    default:
+      throw std::logic_error("vertex data format not implemented");
+  }
+}
+
+VkIndexType quavis::DrawableGeometry::get_index_type() const
+{
+  // 16 bit indices address at most 65536 vertices
+  return positions_.size() / 3 <= 0x10000 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+std::string quavis::DrawableGeometry::get_vertex_layout_name() const
+{
+  return std::to_string(get_position_format()) + "_" + std::to_string(get_vertex_data_format());
+}
+
+std::vector<uint8_t> quavis::DrawableGeometry::encode_positions()
+{
+  std::vector<uint8_t> result;
+
+  if (!compression_.quantize_positions) {
+    dequantization_matrix_ = glm::mat4(1);
+    result.resize(positions_.size() * sizeof(positions_[0]));
+    memcpy(result.data(), positions_.data(), result.size());
+    return result;
+  }
+
+  // bounding box, quantized values are relative to it
+  glm::vec3 min_pos(std::numeric_limits<float>::max());
+  glm::vec3 max_pos(std::numeric_limits<float>::lowest());
+  for (size_t i = 0; i < positions_.size(); i += 3) {
+    const glm::vec3 p(positions_[i + 0], positions_[i + 1], positions_[i + 2]);
+    min_pos = glm::min(min_pos, p);
+    max_pos = glm::max(max_pos, p);
+  }
+
+  if (positions_.empty()) {
+    min_pos = max_pos = glm::vec3(0);
+  }
+
+  // flat boxes would divide by zero, any scale works for them
+  glm::vec3 extent = max_pos - min_pos;
+  for (auto i = 0; i < 3; i++) {
+    if (extent[i] <= 0.0f) extent[i] = 1.0f;
+  }
+
+  dequantization_matrix_ = glm::translate(glm::mat4(1), min_pos) * glm::scale(glm::mat4(1), extent);
+
+  std::vector<uint16_t> quantized;
+  quantized.reserve(positions_.size() / 3 * 4);
+  for (size_t i = 0; i < positions_.size(); i += 3) {
+    const glm::vec3 p = (glm::vec3(positions_[i + 0], positions_[i + 1], positions_[i + 2]) - min_pos) / extent;
+    quantized.push_back(glm::packUnorm1x16(p.x));
+    quantized.push_back(glm::packUnorm1x16(p.y));
+    quantized.push_back(glm::packUnorm1x16(p.z));
+    quantized.push_back(0);  // 3 component 16 bit formats are rarely supported as vertex input
+  }
+
+  result.resize(quantized.size() * sizeof(quantized[0]));
+  memcpy(result.data(), quantized.data(), result.size());
+  return result;
+}
+
+std::vector<uint8_t> quavis::DrawableGeometry::encode_vertex_data() const
+{
+  std::vector<uint8_t> result;
+
+  switch (compression_.vertex_data_format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+      result.reserve(per_vertex_data_.size());
+      for (const auto& d : per_vertex_data_) {
+        result.push_back(static_cast<uint8_t>(glm::round(glm::clamp(d, 0.0f, 1.0f) * 255.0f)));
+      }
+      break;
+    case VK_FORMAT_R16G16B16A16_SFLOAT: {
+      std::vector<uint16_t> half;
+      half.reserve(per_vertex_data_.size());
+      for (const auto& d : per_vertex_data_) {
+        half.push_back(glm::packHalf1x16(d));
+      }
+      result.resize(half.size() * sizeof(half[0]));
+      memcpy(result.data(), half.data(), result.size());
+    } break;
+    default:
+      result.resize(per_vertex_data_.size() * sizeof(per_vertex_data_[0]));
+      memcpy(result.data(), per_vertex_data_.data(), result.size());
+      break;
+  }
+
+  return result;
+}
+
+std::vector<uint8_t> quavis::DrawableGeometry::encode_indices() const
 {
-  command_buffer->record_bind_vertex_buffers(0, static_cast<uint32_t>(vbos_.size()), vbos_.data(), vbos_offsets_.data());
+  std::vector<uint8_t> result;
+
+  if (get_index_type() == VK_INDEX_TYPE_UINT16) {
+    std::vector<uint16_t> small(indicies_.begin(), indicies_.end());
+    result.resize(small.size() * sizeof(small[0]));
+    memcpy(result.data(), small.data(), result.size());
+  } else {
+    result.resize(indicies_.size() * sizeof(indicies_[0]));
+    memcpy(result.data(), indicies_.data(), result.size());
+  }
 
-  command_buffer->record_bind_index_buffer(indicies_vbo_, 0, VK_INDEX_TYPE_UINT32);
-  command_buffer->record_draw_indexed(static_cast<uint32_t>(indicies_.size()), 1, 0, 0, 0);
+  return result;
 }
 
 std::shared_ptr<quavis::DrawableGeometry> quavis::DrawableGeometry::create_unit_cube()
@@ -1,40 +1,134 @@
 #ifndef QUAVIS_RENDER_DRAWABLE_GEOMETRY
 #define QUAVIS_RENDER_DRAWABLE_GEOMETRY
 
+#include <string>
 #include <vector>
 
 #include <glm/glm.hpp>
 
 #include "./anvil.h"
+#include "./mesh_optimizer.h"
 
 namespace quavis {
-/// Something that can be drawn. A set of vertex position/index based triangles with an additional 4 floats per vertex that can be used by the material
+/// How the vertex attributes of a DrawableGeometry are stored on the GPU. Indices are always stored as 16 bit if the mesh is small enough.
+struct VertexCompression {
+  /// store positions as 16 bit normalized values relative to the bounding box of the geometry, the dequantization is folded into the model matrix
+  bool quantize_positions = false;
+  /// format of the per vertex data: VK_FORMAT_R32G32B32A32_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT or VK_FORMAT_R8G8B8A8_UNORM (values in [0, 1] only)
+  VkFormat vertex_data_format = VK_FORMAT_R32G32B32A32_SFLOAT;
+};
+
+/// Something that can be drawn. A set of vertex position/index based triangles with optional additional 4 floats per vertex that can be used by the
+/// material. Without per vertex data the material uses the object data of the scene object instead.
 class DrawableGeometry {
  public:
-  /// Slow constructor(vector data is copied) that supports glm types
+  /// Slow constructor(vector data is copied) that supports glm types, per_vertex_data may be empty
   DrawableGeometry(std::vector<glm::vec3> &&positions, std::vector<glm::vec4> &&per_vertex_data, std::vector<uint32_t> &&indices);
-  /// Fast (move) constructor. needs positions.size() % 3 and per_vertex_data.size() % 4
+  /// Fast (move) constructor. needs positions.size() % 3 and per_vertex_data.size() % 4, per_vertex_data may be empty
   DrawableGeometry(std::vector<float> &&positions, std::vector<float> &&per_vertex_data, std::vector<uint32_t> &&indices);
   /// creates a unit cube (coordinates from -0.5 to +0.5)
   static std::shared_ptr<DrawableGeometry> create_unit_cube();
 
+  /// selects the GPU storage formats, has to be called before prepare_for_draw
+  void set_vertex_compression(const VertexCompression &compression);
+
+  /// welds vertices, removes degenerated triangles and reorders for the vertex cache, has to be called before prepare_for_draw
+  MeshOptimizer::Statistics optimize();
+
+  /// splits the mesh into spatially coherent meshlets if it has more than min_triangles triangles, has to be called before prepare_for_draw
+  void build_meshlets(size_t min_triangles, uint32_t triangles_per_meshlet);
+
+  /// meshlets of the mesh, empty if the mesh is not split
+  const std::vector<Meshlet> &get_meshlets() const { return meshlets_; }
+
+  /// one level of detail, a range of the index buffer
+  struct LodLevel {
+    uint32_t first_index;
+    uint32_t index_count;
+    float error;  ///< maximal distance a surface point moved compared to level 0 (object space)
+  };
+
+  /// simplifies the mesh into at most max_levels coarser levels that share the vertices with level 0, has to be called last before
+  /// prepare_for_draw
+  void build_lod_chain(size_t max_levels);
+
+  /// levels of detail, empty if there are none
+  const std::vector<LodLevel> &get_lod_levels() const { return lod_levels_; }
+
+  /// the coarsest level whose error is below max_angle (radians) seen from distance (object space) to the bounding sphere center
+  size_t select_lod(float distance, float max_angle) const;
+  /// bounding sphere (object space)
+  const glm::vec3 &get_bounds_center() const { return bounds_center_; }
+  float get_bounds_radius() const { return bounds_radius_; }
+
   /// sends data to the GPU
   void prepare_for_draw(std::weak_ptr<Anvil::SGPUDevice> device_pt);
 
-  /// draws the triangles
-  void draw(std::weak_ptr<Anvil::SGPUDevice> device_ptr, std::shared_ptr<Anvil::PrimaryCommandBuffer> command_buffer);
+  /// frees the GPU data, prepare_for_draw uploads it again
+  void release_gpu();
+
+  /// true between prepare_for_draw and release_gpu
+  bool is_resident() const { return !vbos_.empty(); }
+
+  /// draws the triangles of the given level of detail
+  void draw(const std::weak_ptr<Anvil::SGPUDevice> &device_ptr, const std::shared_ptr<Anvil::CommandBufferBase> &command_buffer,
+            size_t lod_level = 0);
+
+  /// draws the triangles without the meshlets facing away from the eye (object space), only valid for closed solids seen from outside. Returns the
+  /// number of culled meshlets
+  size_t draw_culled(const std::weak_ptr<Anvil::SGPUDevice> &device_ptr, const std::shared_ptr<Anvil::CommandBufferBase> &command_buffer,
+                     const glm::vec3 &eye);
+
+  /// maps the stored (maybe quantized) positions to the object space positions, identity if positions are not quantized
+  const glm::mat4 &get_dequantization_matrix() const { return dequantization_matrix_; }
+
+  /// false if the geometry has no per vertex data and relies on the object data
+  bool has_vertex_data() const { return !per_vertex_data_.empty(); }
+
+  /// vertex attribute formats and strides as they are uploaded, used to configure the pipeline, VK_FORMAT_UNDEFINED for missing vertex data
+  VkFormat get_position_format() const;
+  uint32_t get_position_stride() const;
+  VkFormat get_vertex_data_format() const;
+  uint32_t get_vertex_data_stride() const;
+  VkIndexType get_index_type() const;
+
+  /// unique name of the vertex attribute formats, geometries with the same name can share a pipeline
+  std::string get_vertex_layout_name() const;
+
+  /// number of bytes uploaded to the GPU (0 before prepare_for_draw)
+  VkDeviceSize get_gpu_byte_size() const { return gpu_byte_size_; }
 
  private:
   std::vector<float> positions_;
   std::vector<float> per_vertex_data_;
   std::vector<uint32_t> indicies_;
+  std::vector<Meshlet> meshlets_;
+  std::vector<LodLevel> lod_levels_;
+  glm::vec3 bounds_center_{0};
+  float bounds_radius_{0};
+
+  VertexCompression compression_;
+  glm::mat4 dequantization_matrix_{1};
 
   // gpu data
   std::vector<std::shared_ptr<Anvil::Buffer>> vbos_;
   std::vector<VkDeviceSize> vbos_offsets_;
   std::shared_ptr<Anvil::Buffer> indicies_vbo_;
+  VkDeviceSize gpu_byte_size_{0};
+  /// the handles of the buffers above, the draws bind them with raw commands
+  std::vector<VkBuffer> vbo_handles_;
+  VkBuffer indices_handle_{VK_NULL_HANDLE};
 
   // helper functions
+  /// computes the bounding sphere from the positions
+  void compute_bounds();
+  /// converts the positions into the uploaded format and computes the dequantization matrix
+  std::vector<uint8_t> encode_positions();
+  /// converts the per vertex data into the uploaded format
+  std::vector<uint8_t> encode_vertex_data() const;
+  /// converts the indices into the uploaded format
+  std::vector<uint8_t> encode_indices() const;
+
   /// Creates a new buffer and download data. Because data is directly downlaoded GPU memory has to be  allocated immediately and can not be shared
   /// with other buffers
   template <class T>
@@ -54,4 +148,4 @@ class DrawableGeometry {
 };
 }  // namespace quavis
 
-#endif
\ No newline at end of file
+#endif
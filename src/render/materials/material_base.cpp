@@ -7,7 +7,7 @@ void quavis::MaterialBase::add_per_material_description(std::weak_ptr<Anvil::SGP
 }
 
 void quavis::MaterialBase::set_material_properties(std::weak_ptr<Anvil::SGPUDevice> device_pt,
-                                                   std::shared_ptr<Anvil::PrimaryCommandBuffer> command_buffer,
+                                                   std::shared_ptr<Anvil::CommandBufferBase> command_buffer,
                                                    std::shared_ptr<Anvil::PipelineLayout> pipeline_layout)
 {
 }
@@ -22,18 +22,31 @@ const char *quavis::MaterialBase::get_shader_src_fragment()
   
   // } worldProp;
 
-  // SET: 1  Per View Matrices
-  layout(set = 1, binding = 0) uniform WiewProp {
-      mat4 view_projection_matrix[6];
-      vec4 position;
+  // SET: 1  Per View Data, the drawn view is views[cubeProp.view_index]
+  layout(set = 1, binding = 0) uniform CubeProp {
+      mat4 face_projection_matrix[6];  // of the cube faces, relative to the view position
+      uint view_index;
+  } cubeProp;
+
+  struct ViewProp {
+      vec3 position;
+      uint face_mask;  // layers needed by the computations
       vec3 view_direction;
       float field_of_view;
-  } viewProp;
+  };
+  layout(std430, set = 1, binding = 1) readonly buffer Views {
+      ViewProp views[];
+  };
+  #define viewProp views[cubeProp.view_index]
 
-  // SET: 2  Shader Config (setting for this material for all objs)
-  // layout(set = 2, binding = 0) uniform ShaderProp {
+#ifndef QUAVIS_MATERIAL_TEXTURES
+  #define QUAVIS_MATERIAL_TEXTURES 0
+#endif
 
-  // } shaderProp;
+  // SET: 2  Shader Config, the cube map textures of all materials drawn by this pipeline
+#if QUAVIS_MATERIAL_TEXTURES > 0
+  layout(set = 2, binding = 0) uniform samplerCube materialTextures[QUAVIS_MATERIAL_TEXTURES];
+#endif
 
   // SET: 3  Per Object Material Parameters
   // layout(set = 3, binding = 0) uniform MaterialProp {
@@ -43,6 +56,8 @@ const char *quavis::MaterialBase::get_shader_src_fragment()
   // push_constants Per Object Parameters 
   layout(push_constant) uniform ObjProp {
     mat4 model_mat;
+    vec4 object_data;
+    uint material_index;  // texture of the material plus one, 0 without texture
   } objProp;
 
 
@@ -55,8 +70,21 @@ const char *quavis::MaterialBase::get_shader_src_fragment()
      vec3 worldPos;
   };
 
+#ifndef QUAVIS_TARGET_DISTANCE
+  // color and distance (see TargetLayout)
+  #define QUAVIS_TARGET_DISTANCE a
+#endif
+
   void main() {
-    fColor = vec4(color.xyz, distance(worldPos, viewProp.position.xyz));
+    // channels that are not in the render target are dropped
+    fColor = vec4(color.xyz, 0.0);
+#if QUAVIS_MATERIAL_TEXTURES > 0
+    // materials with a texture look up their color in the direction of the vertex data
+    if (objProp.material_index > 0u) {
+      fColor = texture(materialTextures[objProp.material_index - 1u], normalize(color.xyz - vec3(0.5, 0.5, 0.5)));
+    }
+#endif
+    fColor.QUAVIS_TARGET_DISTANCE = distance(worldPos, viewProp.position);
   }
 )";
 }
@@ -67,20 +95,38 @@ const char *quavis::MaterialBase::get_shader_src_geometry()
   #version 450
 
   layout(triangles) in;
+#ifdef QUAVIS_OCTAHEDRAL
+  layout(triangle_strip, max_vertices = 24) out;
+
+  out gl_PerVertex {
+    vec4 gl_Position;
+    float gl_ClipDistance[3];
+  };
+#else
   layout(triangle_strip, max_vertices = 18) out;
+#endif
 
   // SET: 0  World Static variables (lights,...)
   // layout(set = 0, binding = 0) uniform WorldProp {
   
   // } worldProp;
 
-  // SET: 1  Per View Matrices
-  layout(set = 1, binding = 0) uniform WiewProp {
-      mat4 view_projection_matrix[6];
-      vec4 position;
+  // SET: 1  Per View Data, the drawn view is views[cubeProp.view_index]
+  layout(set = 1, binding = 0) uniform CubeProp {
+      mat4 face_projection_matrix[6];  // of the cube faces, relative to the view position
+      uint view_index;
+  } cubeProp;
+
+  struct ViewProp {
+      vec3 position;
+      uint face_mask;  // layers needed by the computations
       vec3 view_direction;
       float field_of_view;
-  } viewProp;
+  };
+  layout(std430, set = 1, binding = 1) readonly buffer Views {
+      ViewProp views[];
+  };
+  #define viewProp views[cubeProp.view_index]
 
   // SET: 2  Shader Config (setting for this material for all objs)
   // layout(set = 2, binding = 0) uniform ShaderProp {
@@ -96,6 +142,8 @@ const char *quavis::MaterialBase::get_shader_src_geometry()
   // push_constants Per Object Parameters 
   layout(push_constant) uniform ObjProp {
     mat4 model_mat;
+    vec4 object_data;
+    uint material_index;  // texture of the material plus one, 0 without texture
   } objProp;
 
 
@@ -112,19 +160,60 @@ const char *quavis::MaterialBase::get_shader_src_geometry()
     vec3 worldPos;
   } frag;
 
+#ifdef QUAVIS_OCTAHEDRAL
+  // near and far plane of the cube projection
+  const float near = 0.01;
+  const float far  = 100001.0;
+
+  void main() {
+    vec3 rel[3];
+    for(int i = 0; i < 3; ++i) {
+      rel[i] = gl_in[i].gl_Position.xyz - viewProp.position;
+    }
+
+    // within one octant the octahedral map is a perspective projection onto the octahedron face, so the triangle is drawn once per octant
+    // it touches and clipped to the octant
+    for(int octant = 0; octant < 8; ++octant) {
+      vec3 s = vec3((octant & 1) == 0 ? 1.0 : -1.0, (octant & 2) == 0 ? 1.0 : -1.0, (octant & 4) == 0 ? 1.0 : -1.0);
+      if (any(lessThan(max(max(s * rel[0], s * rel[1]), s * rel[2]), vec3(0.0)))) continue;
+
+      gl_Layer = 0;
+      for(int i = 0; i < 3; ++i) {
+        vec3 r  = s * rel[i];
+        float w = r.x + r.y + r.z;  // point on the octahedron is rel / w
+        // the upper hemisphere fills the inner diamond, the lower hemisphere is folded over its edges into the corners
+        vec2 xy = s.z > 0.0 ? rel[i].xy : s.xy * vec2(w - r.y, w - r.x);
+
+        frag.color = vertices[i].color;
+        frag.worldPos = vertices[i].worldPos;
+        gl_Position = vec4(xy, far * (w - near) / (far - near), w);
+        gl_ClipDistance[0] = r.x;
+        gl_ClipDistance[1] = r.y;
+        gl_ClipDistance[2] = r.z;
+        EmitVertex();
+      }
+      EndPrimitive();
+    }
+  }
+#else
   void main() {
     for(int layer = 0; layer < 6; ++layer) {
+      if ((viewProp.face_mask & (1u << layer)) == 0u) continue;
       gl_Layer = layer;
       for(int i = 0; i < gl_in.length(); ++i) {
+#ifdef QUAVIS_FACE_SIZES
+        gl_ViewportIndex = layer;  // each face has a viewport of its own resolution
+#endif
         frag.color = vertices[i].color;
         frag.worldPos = vertices[i].worldPos;
         // frag = vertices[i];
-        gl_Position = viewProp.view_projection_matrix[layer] * gl_in[i].gl_Position;
+        gl_Position = cubeProp.face_projection_matrix[layer] * vec4(gl_in[i].gl_Position.xyz - viewProp.position, 1.0);
         EmitVertex();
       }
       EndPrimitive();
     }
   }
+#endif
 )";
 }
 
@@ -147,13 +236,22 @@ const char *quavis::MaterialBase::get_shader_src_vertex()
   
   // } worldProp;
 
-  // SET: 1  Per View Matrices
-  layout(set = 1, binding = 0) uniform WiewProp {
-      mat4 view_projection_matrix[6];
-      vec4 position;
+  // SET: 1  Per View Data, the drawn view is views[cubeProp.view_index]
+  layout(set = 1, binding = 0) uniform CubeProp {
+      mat4 face_projection_matrix[6];  // of the cube faces, relative to the view position
+      uint view_index;
+  } cubeProp;
+
+  struct ViewProp {
+      vec3 position;
+      uint face_mask;  // layers needed by the computations
       vec3 view_direction;
       float field_of_view;
-  } viewProp;
+  };
+  layout(std430, set = 1, binding = 1) readonly buffer Views {
+      ViewProp views[];
+  };
+  #define viewProp views[cubeProp.view_index]
 
   // SET: 2  Shader Config (setting for this material for all objs)
   // layout(set = 2, binding = 0) uniform ShaderProp {
@@ -168,6 +266,8 @@ const char *quavis::MaterialBase::get_shader_src_vertex()
   // push_constants Per Object Parameters 
   layout(push_constant) uniform ObjProp {
     mat4 model_mat;
+    vec4 object_data;
+    uint material_index;  // texture of the material plus one, 0 without texture
   } objProp;
 
   
@@ -186,4 +286,49 @@ const char *quavis::MaterialBase::get_shader_src_vertex()
     worldPos = gl_Position.xyz;
   }
 )";
-}
\ No newline at end of file
+}
+const char *quavis::MaterialBase::get_shader_src_vertex_object_data()
+{
+  return R"(
+  #version 450
+
+  // SET: 1  Per View Data, the drawn view is views[cubeProp.view_index]
+  layout(set = 1, binding = 0) uniform CubeProp {
+      mat4 face_projection_matrix[6];  // of the cube faces, relative to the view position
+      uint view_index;
+  } cubeProp;
+
+  struct ViewProp {
+      vec3 position;
+      uint face_mask;  // layers needed by the computations
+      vec3 view_direction;
+      float field_of_view;
+  };
+  layout(std430, set = 1, binding = 1) readonly buffer Views {
+      ViewProp views[];
+  };
+  #define viewProp views[cubeProp.view_index]
+
+  // push_constants Per Object Parameters 
+  layout(push_constant) uniform ObjProp {
+    mat4 model_mat;
+    vec4 object_data;
+    uint material_index;  // texture of the material plus one, 0 without texture
+  } objProp;
+
+  
+  layout(location = 0) in vec3 inPosition;
+  
+  out layout(location = 0) vData
+  {
+    vec4 color;
+    vec3 worldPos;
+  };
+
+  void main() {
+    gl_Position =  objProp.model_mat * vec4(inPosition, 1.0);
+    color = objProp.object_data;
+    worldPos = gl_Position.xyz;
+  }
+)";
+}
@@ -4,6 +4,7 @@
 #include <string>
 
 #include "../anvil.h"
+#include "../cube_images.h"
 
 namespace quavis {
 /// the most simple base material use by the renderer, it supports output to the 6 layers of a cube map at once.
@@ -16,7 +17,14 @@ class MaterialBase {
   virtual const std::string get_name() { return "default"; };
 
   /// called immediately before the material is used in a rendering call
-  virtual void use(std::weak_ptr<Anvil::SGPUDevice> device_ptr, std::shared_ptr<Anvil::PrimaryCommandBuffer> command_buffer){};
+  virtual void use(std::weak_ptr<Anvil::SGPUDevice> device_ptr, std::shared_ptr<Anvil::CommandBufferBase> command_buffer){};
+
+  /// cube map looked up by the vertex data, materials with a texture share the pipeline of the base material which selects the texture by the
+  /// material index of the object
+  virtual std::shared_ptr<CubeImages> get_texture() const { return nullptr; }
+
+  /// true if the material has shaders or descriptors of its own and cannot be drawn by the shared pipeline
+  virtual bool has_own_pipeline() const { return false; }
 
   void set_pipline(const Anvil::GraphicsPipelineID pipeline) { pipeline_ = pipeline; }
 
@@ -27,7 +35,7 @@ class MaterialBase {
                                             std::shared_ptr<Anvil::DescriptorSetGroup> desc, Anvil::PipelineID pipline);
 
   /// called before each drawing for each material instance to set resources to the pipline (texturesampler,...)
-  virtual void set_material_properties(std::weak_ptr<Anvil::SGPUDevice> device_pt, std::shared_ptr<Anvil::PrimaryCommandBuffer> command_buffer,
+  virtual void set_material_properties(std::weak_ptr<Anvil::SGPUDevice> device_pt, std::shared_ptr<Anvil::CommandBufferBase> command_buffer,
                                        std::shared_ptr<Anvil::PipelineLayout> pipeline_layout);
 
  private:
@@ -39,6 +47,7 @@ class MaterialBase {
   virtual const char *get_shader_src_tess_control();            ///< source code or nullptr if stage is not used
   virtual const char *get_shader_src_tess_evaluation_shader();  ///< source code or nullptr if stage is not used
   virtual const char *get_shader_src_vertex();                  ///< source code or nullptr if stage is not used
+  virtual const char *get_shader_src_vertex_object_data();      ///< vertex stage for geometry without per vertex data, uses the object data instead
 };
 };  // namespace quavis
 
@@ -0,0 +1,110 @@
+#include "material_impostor.h"
+
+void quavis::MaterialImpostor::add_per_material_description(std::weak_ptr<Anvil::SGPUDevice> device_pt,
+                                                            std::shared_ptr<Anvil::GraphicsPipelineManager> &gfx_pipeline_manager_ptr_,
+                                                            std::shared_ptr<Anvil::DescriptorSetGroup> desc_group, Anvil::PipelineID pipline)
+{
+  // add texture
+  desc_group->add_binding(2, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_ALL_GRAPHICS, nullptr);
+
+  parent_group_ = desc_group;
+  groups_.clear();
+
+  sampler_ = Anvil::Sampler::create(device_pt, VkFilter::VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_MIPMAP_MODE_NEAREST,
+                                    VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, 0,
+                                    0, false, VK_COMPARE_OP_NEVER, 0.0, 0.0, VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK, false);
+}
+
+void quavis::MaterialImpostor::set_material_properties(std::weak_ptr<Anvil::SGPUDevice> device_pt,
+                                                       std::shared_ptr<Anvil::CommandBufferBase> command_buffer,
+                                                       std::shared_ptr<Anvil::PipelineLayout> pipeline_layout)
+{
+  assert(cube_image_ != nullptr);
+
+  auto &group = groups_[cube_image_.get()];
+  if (group == nullptr) {
+    group = Anvil::DescriptorSetGroup::create(parent_group_, false /* releaseable_sets */);
+    group->get_descriptor_set(2)->set_binding_item(
+      0, Anvil::DescriptorSet::CombinedImageSamplerBindingElement(cube_image_->get_image_layout(), cube_image_->get_view_texture_array(), sampler_));
+    group->get_descriptor_set(2)->bake();
+  }
+
+  auto set = group->get_descriptor_set(2);
+  command_buffer->record_bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 2, 1, &set, 0, nullptr);
+}
+
+const char *quavis::MaterialImpostor::get_shader_src_fragment()
+{
+  return R"(
+  #version 450
+
+  // SET: 1  Per View Data, the drawn view is views[cubeProp.view_index]
+  layout(set = 1, binding = 0) uniform CubeProp {
+      mat4 face_projection_matrix[6];  // of the cube faces, relative to the view position
+      uint view_index;
+  } cubeProp;
+
+  struct ViewProp {
+      vec3 position;
+      uint face_mask;  // layers needed by the computations
+      vec3 view_direction;
+      float field_of_view;
+  };
+  layout(std430, set = 1, binding = 1) readonly buffer Views {
+      ViewProp views[];
+  };
+  #define viewProp views[cubeProp.view_index]
+
+  // SET: 2  Shader Config (setting for this material for all objs)
+  layout(set = 2, binding = 0) uniform sampler2DArray impostorMap;
+
+  // push_constants Per Object Parameters
+  layout(push_constant) uniform ObjProp {
+    mat4 model_mat;
+    vec4 object_data;  // anchor position of the impostor
+  } objProp;
+
+
+
+  layout(location = 0) out vec4 fColor;
+
+  in layout(location = 0) fData
+  {
+     vec4 color;
+     vec3 worldPos;
+  };
+
+  // axes of the cube layers as rendered (+x, -x, +y, -y, +z, -z), texture coordinates grow along right and down
+  const vec3 faceForward[6] = vec3[](vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1));
+  const vec3 faceRight[6]   = vec3[](vec3(0, 1, 0), vec3(0, -1, 0), vec3(-1, 0, 0), vec3(1, 0, 0), vec3(0, 1, 0), vec3(0, 1, 0));
+  const vec3 faceDown[6]    = vec3[](vec3(0, 0, -1), vec3(0, 0, -1), vec3(0, 0, -1), vec3(0, 0, -1), vec3(1, 0, 0), vec3(-1, 0, 0));
+
+  // face_size
+  #include "cube_faces.glsl"
+
+#ifndef QUAVIS_TARGET_DISTANCE
+  // color and distance (see TargetLayout)
+  #define QUAVIS_TARGET_DISTANCE a
+#endif
+
+  void main() {
+    vec3 dir = normalize(worldPos - viewProp.position);
+
+    vec3 a = abs(dir);
+    int face = a.x >= a.y && a.x >= a.z ? (dir.x > 0 ? 0 : 1) : (a.y >= a.z ? (dir.y > 0 ? 2 : 3) : (dir.z > 0 ? 4 : 5));
+    vec2 st = 0.5 + 0.5 * vec2(dot(dir, faceRight[face]), dot(dir, faceDown[face])) / dot(dir, faceForward[face]);
+#ifdef QUAVIS_FACE_SIZES
+    st *= vec2(face_size[face]) / vec2(textureSize(impostorMap, 0).xy);
+#endif
+
+    // the impostor cube has the layout of the render target
+    vec4 far = texture(impostorMap, vec3(st, face));
+    if (far.QUAVIS_TARGET_DISTANCE <= 0.0) discard;  // nothing baked in this direction
+
+    // the baked distance is relative to the anchor
+    fColor = far;
+    fColor.QUAVIS_TARGET_DISTANCE = distance(objProp.object_data.xyz + dir * far.QUAVIS_TARGET_DISTANCE, viewProp.position);
+    gl_FragDepth = 1.0;
+  }
+)";
+}
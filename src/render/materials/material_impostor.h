@@ -0,0 +1,45 @@
+#ifndef QUAVIS_RENDER_MATERIALS_IMPOSTOR
+#define QUAVIS_RENDER_MATERIALS_IMPOSTOR
+
+#include <map>
+#include <string>
+
+#include "./material_base.h"
+
+#include "../cube_images.h"
+
+namespace quavis {
+/// background material that draws the far field baked into an impostor cube at an anchor point. The object data holds the anchor position, the
+/// distance (alpha) is reconstructed relative to the observation point. Drawn at the far plane, so all other geometry is in front of it.
+class MaterialImpostor : public MaterialBase {
+ public:
+  virtual const std::string get_name() override { return "impostor"; };
+
+  virtual bool has_own_pipeline() const override { return true; }
+
+  /// the impostor cube that is used by the next set_material_properties
+  void set_impostor(std::shared_ptr<CubeImages> cube_image) { cube_image_ = cube_image; }
+
+  /// prepare the pipline to hold a texture array sampler with the 6 faces
+  virtual void add_per_material_description(std::weak_ptr<Anvil::SGPUDevice> device_pt,
+                                            std::shared_ptr<Anvil::GraphicsPipelineManager> &gfx_pipeline_manager_ptr_,
+                                            std::shared_ptr<Anvil::DescriptorSetGroup> desc_group, Anvil::PipelineID pipline) override;
+
+  /// set pipline to point to the current impostor cube
+  virtual void set_material_properties(std::weak_ptr<Anvil::SGPUDevice> device_pt, std::shared_ptr<Anvil::CommandBufferBase> command_buffer,
+                                       std::shared_ptr<Anvil::PipelineLayout> pipeline_layout) override;
+
+  // Shader Sources
+ public:
+  virtual const char *get_shader_src_fragment() override;
+
+ private:
+  std::shared_ptr<CubeImages> cube_image_;
+  std::shared_ptr<Anvil::DescriptorSetGroup> parent_group_;
+  std::shared_ptr<Anvil::Sampler> sampler_;
+  /// one descriptor set group (sharing the layout of the pipeline) for each impostor cube
+  std::map<CubeImages *, std::shared_ptr<Anvil::DescriptorSetGroup>> groups_;
+};
+};  // namespace quavis
+
+#endif
@@ -0,0 +1,445 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <numeric>
+
+#include <glm/glm.hpp>
+
+const uint32_t quavis::MeshOptimizer::invalid_index;
+
+quavis::MeshOptimizer::Statistics quavis::MeshOptimizer::optimize(std::vector<float> &positions, std::vector<float> &per_vertex_data,
+                                                                  std::vector<uint32_t> &indices)
+{
+  Statistics stats;
+  stats.vertices_before  = positions.size() / 3;
+  stats.triangles_before = indices.size() / 3;
+
+  weld_vertices(positions, per_vertex_data, indices);
+  remove_degenerated_triangles(positions, indices);
+  reorder_for_vertex_cache(positions.size() / 3, indices);
+  reorder_vertices_by_first_use(positions, per_vertex_data, indices);
+
+  stats.vertices_after  = positions.size() / 3;
+  stats.triangles_after = indices.size() / 3;
+  return stats;
+}
+
+void quavis::MeshOptimizer::weld_vertices(std::vector<float> &positions, std::vector<float> &per_vertex_data, std::vector<uint32_t> &indices)
+{
+  const size_t vertex_count = positions.size() / 3;
+  const bool has_data       = !per_vertex_data.empty();
+
+  // compares position and data of two vertices
+  auto less = [&](uint32_t a, uint32_t b) {
+    for (size_t i = 0; i < 3; i++) {
+      if (positions[a * 3 + i] != positions[b * 3 + i]) return positions[a * 3 + i] < positions[b * 3 + i];
+    }
+    if (has_data) {
+      for (size_t i = 0; i < 4; i++) {
+        if (per_vertex_data[a * 4 + i] != per_vertex_data[b * 4 + i]) return per_vertex_data[a * 4 + i] < per_vertex_data[b * 4 + i];
+      }
+    }
+    return a < b;  // keeps the first vertex of a group in front
+  };
+  auto equal = [&](uint32_t a, uint32_t b) {
+    for (size_t i = 0; i < 3; i++) {
+      if (positions[a * 3 + i] != positions[b * 3 + i]) return false;
+    }
+    if (has_data) {
+      for (size_t i = 0; i < 4; i++) {
+        if (per_vertex_data[a * 4 + i] != per_vertex_data[b * 4 + i]) return false;
+      }
+    }
+    return true;
+  };
+
+  std::vector<uint32_t> order(vertex_count);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), less);
+
+  // all vertices of a group of equal vertices point to the first of the group
+  std::vector<uint32_t> remap(vertex_count, invalid_index);
+  size_t unique_count = 0;
+  for (size_t i = 0; i < order.size(); i++) {
+    if (i == 0 || !equal(order[i - 1], order[i])) {
+      unique_count++;
+    }
+    remap[order[i]] = static_cast<uint32_t>(unique_count - 1);
+  }
+
+  remap_vertices(positions, per_vertex_data, indices, remap, unique_count);
+}
+
+void quavis::MeshOptimizer::remove_degenerated_triangles(const std::vector<float> &positions, std::vector<uint32_t> &indices)
+{
+  size_t out = 0;
+  for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+    const uint32_t i0 = indices[t + 0];
+    const uint32_t i1 = indices[t + 1];
+    const uint32_t i2 = indices[t + 2];
+
+    if (i0 == i1 || i1 == i2 || i2 == i0) continue;
+
+    const glm::vec3 p0(positions[i0 * 3 + 0], positions[i0 * 3 + 1], positions[i0 * 3 + 2]);
+    const glm::vec3 p1(positions[i1 * 3 + 0], positions[i1 * 3 + 1], positions[i1 * 3 + 2]);
+    const glm::vec3 p2(positions[i2 * 3 + 0], positions[i2 * 3 + 1], positions[i2 * 3 + 2]);
+
+    // zero area relative to the triangle size, so small but valid triangles are kept
+    const glm::vec3 e0       = p1 - p0;
+    const glm::vec3 e1       = p2 - p0;
+    const float max_edge_sq  = glm::max(glm::max(glm::dot(e0, e0), glm::dot(e1, e1)), glm::dot(p2 - p1, p2 - p1));
+    const float double_area  = glm::length(glm::cross(e0, e1));
+    if (double_area <= 1e-6f * max_edge_sq) continue;
+
+    indices[out++] = i0;
+    indices[out++] = i1;
+    indices[out++] = i2;
+  }
+  indices.resize(out);
+}
+
+void quavis::MeshOptimizer::reorder_for_vertex_cache(size_t vertex_count, std::vector<uint32_t> &indices, uint32_t cache_size)
+{
+  const size_t triangle_count = indices.size() / 3;
+  if (triangle_count == 0) return;
+
+  // vertex -> triangles adjacency in compressed form
+  std::vector<uint32_t> live(vertex_count, 0);
+  for (auto i : indices) {
+    live[i]++;
+  }
+  std::vector<uint32_t> adjacency_offset(vertex_count + 1, 0);
+  for (size_t v = 0; v < vertex_count; v++) {
+    adjacency_offset[v + 1] = adjacency_offset[v] + live[v];
+  }
+  std::vector<uint32_t> adjacency(indices.size());
+  {
+    std::vector<uint32_t> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+      adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+  }
+
+  std::vector<uint32_t> cache_time(vertex_count, 0);
+  std::vector<bool> emitted(triangle_count, false);
+  std::vector<uint32_t> dead_end;
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+
+  uint32_t time   = cache_size + 1;
+  size_t cursor   = 0;
+  int64_t fanning = 0;
+
+  while (fanning >= 0) {
+    candidates.clear();
+
+    // emit all triangles around the fanning vertex
+    for (auto a = adjacency_offset[fanning]; a < adjacency_offset[fanning + 1]; a++) {
+      const auto t = adjacency[a];
+      if (emitted[t]) continue;
+
+      for (size_t k = 0; k < 3; k++) {
+        const auto v = indices[t * 3 + k];
+        result.push_back(v);
+        dead_end.push_back(v);
+        candidates.push_back(v);
+        live[v]--;
+        if (time - cache_time[v] > cache_size) {
+          cache_time[v] = time++;
+        }
+      }
+      emitted[t] = true;
+    }
+
+    // next fanning vertex: the candidate that stays longest in the cache after its remaining triangles are emitted
+    int64_t best          = -1;
+    int64_t best_priority = -1;
+    for (auto v : candidates) {
+      if (live[v] == 0) continue;
+
+      int64_t priority = 0;
+      if (time - cache_time[v] + 2 * live[v] <= cache_size) {
+        priority = time - cache_time[v];
+      }
+      if (priority > best_priority) {
+        best_priority = priority;
+        best          = v;
+      }
+    }
+
+    // dead end: take a recently used vertex or the next vertex with triangles left
+    while (best < 0 && !dead_end.empty()) {
+      const auto v = dead_end.back();
+      dead_end.pop_back();
+      if (live[v] > 0) best = v;
+    }
+    while (best < 0 && cursor < vertex_count) {
+      if (live[cursor] > 0) best = static_cast<int64_t>(cursor);
+      cursor++;
+    }
+
+    fanning = best;
+  }
+
+  assert(result.size() == indices.size());
+  indices = std::move(result);
+}
+
+std::vector<quavis::Meshlet> quavis::MeshOptimizer::build_meshlets(const std::vector<float> &positions, std::vector<uint32_t> &indices,
+                                                                   uint32_t triangles_per_meshlet)
+{
+  assert(triangles_per_meshlet > 0);
+
+  const size_t triangle_count = indices.size() / 3;
+  auto position               = [&](uint32_t i) { return glm::vec3(positions[i * 3 + 0], positions[i * 3 + 1], positions[i * 3 + 2]); };
+
+  // bounding box of the mesh, the morton codes are relative to it
+  glm::vec3 min_pos(std::numeric_limits<float>::max());
+  glm::vec3 max_pos(std::numeric_limits<float>::lowest());
+  for (auto i : indices) {
+    min_pos = glm::min(min_pos, position(i));
+    max_pos = glm::max(max_pos, position(i));
+  }
+  const glm::vec3 extent = glm::max(max_pos - min_pos, glm::vec3(std::numeric_limits<float>::min()));
+
+  // spreads 10 bits so that there are two zero bits between each
+  auto spread_bits = [](uint32_t v) {
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+  };
+
+  std::vector<std::pair<uint32_t, uint32_t>> codes(triangle_count);  // morton code of the centroid, triangle
+  for (size_t t = 0; t < triangle_count; t++) {
+    const glm::vec3 centroid = (position(indices[t * 3 + 0]) + position(indices[t * 3 + 1]) + position(indices[t * 3 + 2])) / 3.0f;
+    const glm::uvec3 q       = glm::uvec3(glm::clamp((centroid - min_pos) / extent, 0.0f, 1.0f) * 1023.0f);
+    codes[t]                 = {spread_bits(q.x) | (spread_bits(q.y) << 1) | (spread_bits(q.z) << 2), static_cast<uint32_t>(t)};
+  }
+  std::stable_sort(codes.begin(), codes.end(), [](const std::pair<uint32_t, uint32_t> &a, const std::pair<uint32_t, uint32_t> &b) {
+    return a.first < b.first;
+  });
+
+  std::vector<uint32_t> sorted;
+  sorted.reserve(indices.size());
+  for (const auto &c : codes) {
+    sorted.insert(sorted.end(), indices.begin() + c.second * 3, indices.begin() + c.second * 3 + 3);
+  }
+  indices = std::move(sorted);
+
+  // the morton order only chooses the triangles of a meshlet, inside of it they are ordered for the vertex cache again. The vertices of a meshlet
+  // get compact local indices, so each pass only costs the size of its meshlet
+  std::vector<uint32_t> local_index(positions.size() / 3, invalid_index);
+  std::vector<uint32_t> global_index;
+  std::vector<uint32_t> local;
+  for (size_t first = 0; first < triangle_count; first += triangles_per_meshlet) {
+    const size_t last = std::min(triangle_count, first + triangles_per_meshlet);
+
+    global_index.clear();
+    local.clear();
+    for (size_t i = first * 3; i < last * 3; i++) {
+      if (local_index[indices[i]] == invalid_index) {
+        local_index[indices[i]] = static_cast<uint32_t>(global_index.size());
+        global_index.push_back(indices[i]);
+      }
+      local.push_back(local_index[indices[i]]);
+    }
+
+    reorder_for_vertex_cache(global_index.size(), local);
+    for (size_t i = 0; i < local.size(); i++) {
+      indices[first * 3 + i] = global_index[local[i]];
+    }
+    for (auto v : global_index) {
+      local_index[v] = invalid_index;
+    }
+  }
+
+  // split and compute bounds
+  std::vector<Meshlet> meshlets;
+  for (size_t first = 0; first < triangle_count; first += triangles_per_meshlet) {
+    const size_t last = std::min(triangle_count, first + triangles_per_meshlet);
+
+    Meshlet m;
+    m.first_index = static_cast<uint32_t>(first * 3);
+    m.index_count = static_cast<uint32_t>((last - first) * 3);
+
+    glm::vec3 box_min(std::numeric_limits<float>::max());
+    glm::vec3 box_max(std::numeric_limits<float>::lowest());
+    glm::vec3 normal_sum(0);
+    std::vector<glm::vec3> normals;
+    normals.reserve(last - first);
+
+    for (size_t t = first; t < last; t++) {
+      const glm::vec3 p0 = position(indices[t * 3 + 0]);
+      const glm::vec3 p1 = position(indices[t * 3 + 1]);
+      const glm::vec3 p2 = position(indices[t * 3 + 2]);
+      box_min            = glm::min(box_min, glm::min(p0, glm::min(p1, p2)));
+      box_max            = glm::max(box_max, glm::max(p0, glm::max(p1, p2)));
+
+      const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+      const float len   = glm::length(n);
+      if (len > 0.0f) {
+        normals.push_back(n / len);
+        normal_sum += n / len;
+      }
+    }
+
+    m.center = (box_min + box_max) * 0.5f;
+    m.radius = 0.0f;
+    for (auto i = m.first_index; i < m.first_index + m.index_count; i++) {
+      m.radius = glm::max(m.radius, glm::distance(m.center, position(indices[i])));
+    }
+
+    // normal cone, clusters with normals spreading over more than 90 degrees are never culled
+    m.cone_axis   = glm::vec3(0, 0, 1);
+    m.cone_cutoff = 1.0f;
+    if (!normals.empty() && glm::length(normal_sum) > 0.0f) {
+      m.cone_axis     = glm::normalize(normal_sum);
+      float min_cos   = 1.0f;
+      for (const auto &n : normals) {
+        min_cos = glm::min(min_cos, glm::dot(n, m.cone_axis));
+      }
+      if (min_cos > 0.0f) {
+        m.cone_cutoff = glm::sqrt(1.0f - min_cos * min_cos);
+      }
+    }
+
+    meshlets.push_back(m);
+  }
+
+  return meshlets;
+}
+
+bool quavis::MeshOptimizer::is_backfacing(const Meshlet &meshlet, const glm::vec3 &eye)
+{
+  // the view directions to all points of the bounding sphere are within cone_cutoff of the normal cone
+  const glm::vec3 to_center = meshlet.center - eye;
+  return glm::dot(to_center, meshlet.cone_axis) >= meshlet.cone_cutoff * glm::length(to_center) + meshlet.radius;
+}
+
+std::vector<uint32_t> quavis::MeshOptimizer::simplify_vertex_clustering(const std::vector<float> &positions, const std::vector<float> &per_vertex_data,
+                                                                        const std::vector<uint32_t> &indices, float cell_size)
+{
+  assert(cell_size > 0.0f);
+
+  const size_t vertex_count = positions.size() / 3;
+  const bool has_data       = !per_vertex_data.empty();
+  auto position             = [&](uint32_t i) { return glm::vec3(positions[i * 3 + 0], positions[i * 3 + 1], positions[i * 3 + 2]); };
+
+  glm::vec3 min_pos(std::numeric_limits<float>::max());
+  for (size_t v = 0; v < vertex_count; v++) {
+    min_pos = glm::min(min_pos, position(static_cast<uint32_t>(v)));
+  }
+
+  // 21 bits per axis
+  std::vector<uint64_t> cell(vertex_count);
+  for (size_t v = 0; v < vertex_count; v++) {
+    const glm::vec3 c = glm::clamp(glm::floor((position(static_cast<uint32_t>(v)) - min_pos) / cell_size), 0.0f, 2097151.0f);
+    cell[v]           = static_cast<uint64_t>(c.x) | (static_cast<uint64_t>(c.y) << 21) | (static_cast<uint64_t>(c.z) << 42);
+  }
+
+  // group the vertices by cell and vertex data, so different colors or groups are not merged
+  auto less = [&](uint32_t a, uint32_t b) {
+    if (cell[a] != cell[b]) return cell[a] < cell[b];
+    if (has_data) {
+      for (size_t i = 0; i < 4; i++) {
+        if (per_vertex_data[a * 4 + i] != per_vertex_data[b * 4 + i]) return per_vertex_data[a * 4 + i] < per_vertex_data[b * 4 + i];
+      }
+    }
+    return a < b;
+  };
+  auto same_group = [&](uint32_t a, uint32_t b) {
+    if (cell[a] != cell[b]) return false;
+    if (has_data) {
+      for (size_t i = 0; i < 4; i++) {
+        if (per_vertex_data[a * 4 + i] != per_vertex_data[b * 4 + i]) return false;
+      }
+    }
+    return true;
+  };
+
+  std::vector<uint32_t> order(vertex_count);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), less);
+
+  // the representative is the vertex closest to the mean of its group
+  std::vector<uint32_t> representative(vertex_count);
+  for (size_t first = 0; first < order.size();) {
+    size_t last = first + 1;
+    glm::vec3 mean(position(order[first]));
+    while (last < order.size() && same_group(order[first], order[last])) {
+      mean += position(order[last]);
+      last++;
+    }
+    mean /= static_cast<float>(last - first);
+
+    uint32_t best   = order[first];
+    float best_dist = std::numeric_limits<float>::max();
+    for (size_t i = first; i < last; i++) {
+      const float dist = glm::distance(mean, position(order[i]));
+      if (dist < best_dist) {
+        best_dist = dist;
+        best      = order[i];
+      }
+    }
+    for (size_t i = first; i < last; i++) {
+      representative[order[i]] = best;
+    }
+
+    first = last;
+  }
+
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+  for (auto i : indices) {
+    result.push_back(representative[i]);
+  }
+
+  remove_degenerated_triangles(positions, result);
+  return result;
+}
+
+void quavis::MeshOptimizer::reorder_vertices_by_first_use(std::vector<float> &positions, std::vector<float> &per_vertex_data,
+                                                          std::vector<uint32_t> &indices)
+{
+  std::vector<uint32_t> remap(positions.size() / 3, invalid_index);
+  uint32_t next = 0;
+  for (auto i : indices) {
+    if (remap[i] == invalid_index) {
+      remap[i] = next++;
+    }
+  }
+
+  remap_vertices(positions, per_vertex_data, indices, remap, next);
+}
+
+void quavis::MeshOptimizer::remap_vertices(std::vector<float> &positions, std::vector<float> &per_vertex_data, std::vector<uint32_t> &indices,
+                                           const std::vector<uint32_t> &remap, size_t new_vertex_count)
+{
+  const bool has_data = !per_vertex_data.empty();
+
+  std::vector<float> new_positions(new_vertex_count * 3);
+  std::vector<float> new_data(has_data ? new_vertex_count * 4 : 0);
+
+  for (size_t v = 0; v < remap.size(); v++) {
+    const auto n = remap[v];
+    if (n == invalid_index) continue;
+
+    std::copy_n(positions.begin() + v * 3, 3, new_positions.begin() + n * 3);
+    if (has_data) {
+      std::copy_n(per_vertex_data.begin() + v * 4, 4, new_data.begin() + n * 4);
+    }
+  }
+
+  for (auto &i : indices) {
+    i = remap[i];
+    assert(i != invalid_index);
+  }
+
+  positions       = std::move(new_positions);
+  per_vertex_data = std::move(new_data);
+}
@@ -0,0 +1,69 @@
+#ifndef QUAVIS_RENDER_MESH_OPTIMIZER
+#define QUAVIS_RENDER_MESH_OPTIMIZER
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace quavis {
+/// A spatially coherent cluster of triangles of a mesh, stored as a range of the index buffer
+struct Meshlet {
+  uint32_t first_index;  ///< first index in the index buffer
+  uint32_t index_count;  ///< number of indices (3 per triangle)
+  glm::vec3 center;      ///< bounding sphere of the triangles (object space)
+  float radius;
+  glm::vec3 cone_axis;  ///< average normal of the triangles (object space)
+  float cone_cutoff;    ///< sin of the largest angle between a normal and the axis, 1 if the cluster can not be culled by its normals
+};
+
+/// Cleans up and reorders indexed triangle meshes before they are uploaded. Works on the same flat arrays as DrawableGeometry (3 floats per
+/// position, 4 floats or nothing per vertex data, 3 indices per triangle).
+class MeshOptimizer {
+ public:
+  /// vertex and triangle counts before and after the optimization
+  struct Statistics {
+    size_t vertices_before  = 0;
+    size_t vertices_after   = 0;
+    size_t triangles_before = 0;
+    size_t triangles_after  = 0;
+  };
+
+  /// runs all steps: weld, remove degenerated triangles, reorder for the vertex cache and reorder the vertices by first use
+  static Statistics optimize(std::vector<float> &positions, std::vector<float> &per_vertex_data, std::vector<uint32_t> &indices);
+
+  /// merges vertices with identical position and vertex data, the indices are remapped
+  static void weld_vertices(std::vector<float> &positions, std::vector<float> &per_vertex_data, std::vector<uint32_t> &indices);
+
+  /// removes triangles that use a vertex twice or have (nearly) zero area
+  static void remove_degenerated_triangles(const std::vector<float> &positions, std::vector<uint32_t> &indices);
+
+  /// reorders the triangles for the post transform vertex cache (Tipsify, Sander et al. 2007)
+  static void reorder_for_vertex_cache(size_t vertex_count, std::vector<uint32_t> &indices, uint32_t cache_size = 16);
+
+  /// sorts the triangles along a morton curve and splits them into meshlets of at most triangles_per_meshlet triangles, the triangles of each
+  /// meshlet are then reordered for the vertex cache. Triangles are expected in counter clockwise order seen from outside
+  static std::vector<Meshlet> build_meshlets(const std::vector<float> &positions, std::vector<uint32_t> &indices, uint32_t triangles_per_meshlet);
+
+  /// true if all triangles of the meshlet face away from the eye (object space), a closed solid occludes them by its front faces
+  static bool is_backfacing(const Meshlet &meshlet, const glm::vec3 &eye);
+
+  /// simplifies the mesh by merging all vertices (with same vertex data) within a grid cell of size cell_size into one existing vertex of the cell.
+  /// Returns the new indices, every surface point moves by at most the cell diagonal
+  static std::vector<uint32_t> simplify_vertex_clustering(const std::vector<float> &positions, const std::vector<float> &per_vertex_data,
+                                                          const std::vector<uint32_t> &indices, float cell_size);
+
+  /// reorders the vertices in the order the indices use them first and drops unused vertices
+  static void reorder_vertices_by_first_use(std::vector<float> &positions, std::vector<float> &per_vertex_data, std::vector<uint32_t> &indices);
+
+ private:
+  /// moves the vertices to their new index, remap[old] = new or invalid_index if dropped
+  static void remap_vertices(std::vector<float> &positions, std::vector<float> &per_vertex_data, std::vector<uint32_t> &indices,
+                             const std::vector<uint32_t> &remap, size_t new_vertex_count);
+
+  static const uint32_t invalid_index = 0xffffffff;
+};
+}  // namespace quavis
+
+#endif
@@ -1,9 +1,18 @@
 #ifndef QUAVIS_RENDER_OBSERVATION
 #define QUAVIS_RENDER_OBSERVATION
 
+#include <vector>
+
 #include <glm/glm.hpp>
 
 namespace quavis {
+/// the directions seen from an observation point that a computation reads, cube faces outside the domain of all computations are not rendered
+enum class DirectionDomain {
+  FULL_SPHERE,       ///< all 6 faces
+  UPPER_HEMISPHERE,  ///< directions above the horizon (z >= 0), never the downward face
+  VIEW_CONE          ///< the cone of field_of_view (half angle in degrees) around view_direction
+};
+
 /// Info about one observation point. Here to add later maybe more infos than just position
 struct Observation {
   glm::vec3 position;
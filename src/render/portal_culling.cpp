@@ -0,0 +1,118 @@
+#include "portal_culling.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+size_t quavis::PortalCulling::add_cell(const std::vector<std::pair<glm::vec3, glm::vec3>> &boxes)
+{
+  Cell cell;
+  cell.boxes = boxes;
+  cells_.push_back(cell);
+  return cells_.size() - 1;
+}
+
+void quavis::PortalCulling::add_portal(int cell_a, int cell_b, const std::vector<glm::vec3> &polygon)
+{
+  assert(cell_a == exterior || static_cast<size_t>(cell_a) < cells_.size());
+  assert(cell_b == exterior || static_cast<size_t>(cell_b) < cells_.size());
+
+  Portal portal;
+  portal.cells[0] = cell_a;
+  portal.cells[1] = cell_b;
+  portal.polygon  = polygon;
+  portals_.push_back(portal);
+
+  (cell_a == exterior ? exterior_ : cells_[cell_a]).portals.push_back(portals_.size() - 1);
+  (cell_b == exterior ? exterior_ : cells_[cell_b]).portals.push_back(portals_.size() - 1);
+}
+
+int quavis::PortalCulling::find_cell(const glm::vec3 &position) const
+{
+  for (size_t c = 0; c < cells_.size(); c++) {
+    for (const auto &box : cells_[c].boxes) {
+      if (glm::all(glm::greaterThanEqual(position, box.first)) && glm::all(glm::lessThanEqual(position, box.second))) {
+        return static_cast<int>(c);
+      }
+    }
+  }
+  return exterior;
+}
+
+const std::vector<bool> &quavis::PortalCulling::compute_visible_objects(const glm::vec3 &eye, const std::array<glm::mat4, 6> &view_projection)
+{
+  const int start = find_cell(eye);
+
+  visible_objects_.assign(object_cells_.size(), start == exterior);
+  if (start == exterior) return visible_objects_;
+
+  visible_cells_.assign(cells_.size() + 1, false);
+  on_path_.assign(cells_.size() + 1, false);
+
+  FaceRects full;
+  full.fill(glm::vec4(-1.0f, -1.0f, 1.0f, 1.0f));
+  visit(start, full, 0, view_projection);
+
+  for (size_t o = 0; o < object_cells_.size(); o++) {
+    visible_objects_[o] = visible_cells_[slot(object_cells_[o])];
+  }
+  return visible_objects_;
+}
+
+void quavis::PortalCulling::visit(int cell, const FaceRects &rects, size_t depth, const std::array<glm::mat4, 6> &view_projection)
+{
+  visible_cells_[slot(cell)] = true;
+  if (depth >= max_depth_) return;
+
+  on_path_[slot(cell)] = true;
+
+  const auto &portals = (cell == exterior ? exterior_ : cells_[cell]).portals;
+  for (auto p : portals) {
+    const auto &portal = portals_[p];
+    const int next     = portal.cells[0] == cell ? portal.cells[1] : portal.cells[0];
+    if (on_path_[slot(next)]) continue;
+
+    // narrow the rectangle of each face to the projection of the portal
+    FaceRects next_rects;
+    bool any_visible = false;
+    for (size_t f = 0; f < 6; f++) {
+      next_rects[f] = glm::vec4(1.0f, 1.0f, -1.0f, -1.0f);
+      if (rects[f].x > rects[f].z || rects[f].y > rects[f].w) continue;
+
+      std::vector<glm::vec4> clip;
+      for (const auto &v : portal.polygon) {
+        clip.push_back(view_projection[f] * glm::vec4(v, 1.0f));
+      }
+
+      // clip against the near plane, w is the distance in front of the face
+      const float near_w = 1e-4f;
+      std::vector<glm::vec4> front;
+      for (size_t i = 0; i < clip.size(); i++) {
+        const auto &a = clip[i];
+        const auto &b = clip[(i + 1) % clip.size()];
+        if (a.w >= near_w) front.push_back(a);
+        if ((a.w >= near_w) != (b.w >= near_w)) {
+          front.push_back(glm::mix(a, b, (near_w - a.w) / (b.w - a.w)));
+        }
+      }
+      if (front.empty()) continue;
+
+      glm::vec2 min_ndc(std::numeric_limits<float>::max());
+      glm::vec2 max_ndc(std::numeric_limits<float>::lowest());
+      for (const auto &v : front) {
+        const glm::vec2 ndc = glm::vec2(v) / v.w;
+        min_ndc             = glm::min(min_ndc, ndc);
+        max_ndc             = glm::max(max_ndc, ndc);
+      }
+
+      next_rects[f] = glm::vec4(glm::max(min_ndc, glm::vec2(rects[f].x, rects[f].y)), glm::min(max_ndc, glm::vec2(rects[f].z, rects[f].w)));
+      any_visible |= next_rects[f].x <= next_rects[f].z && next_rects[f].y <= next_rects[f].w;
+    }
+
+    if (any_visible) {
+      visit(next, next_rects, depth + 1, view_projection);
+    }
+  }
+
+  on_path_[slot(cell)] = false;
+}
@@ -0,0 +1,72 @@
+#ifndef QUAVIS_RENDER_PORTAL_CULLING
+#define QUAVIS_RENDER_PORTAL_CULLING
+
+#include <array>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace quavis {
+/// Cell and portal visibility for building interiors. Cells are rooms given by boxes, portals are the polygons of openings (doors, windows)
+/// between two cells. Scene objects belong to one cell or to the exterior, which contains everything outside of all cells.
+class PortalCulling {
+ public:
+  /// index of the exterior cell in portals and object cells
+  static const int exterior = -1;
+
+  /// adds a cell made of axis aligned boxes (min, max) and returns its index
+  size_t add_cell(const std::vector<std::pair<glm::vec3, glm::vec3>> &boxes);
+
+  /// adds a portal (convex polygon) between cell_a and cell_b, a cell may be exterior
+  void add_portal(int cell_a, int cell_b, const std::vector<glm::vec3> &polygon);
+
+  /// the cell of each scene object (exterior for objects outside all cells)
+  void set_object_cells(const std::vector<int> &object_cells) { object_cells_ = object_cells; }
+
+  /// maximal number of portals on a path from the observation
+  void set_max_depth(size_t max_depth) { max_depth_ = max_depth; }
+
+  /// number of cells without the exterior
+  size_t cells_size() const { return cells_.size(); }
+  size_t portals_size() const { return portals_.size(); }
+
+  /// the cell containing the position or exterior
+  int find_cell(const glm::vec3 &position) const;
+
+  /// marks the objects of all cells visible from eye through portals, view_projection are the matrices of the 6 cube faces. An eye outside of all
+  /// cells sees everything
+  const std::vector<bool> &compute_visible_objects(const glm::vec3 &eye, const std::array<glm::mat4, 6> &view_projection);
+
+ private:
+  struct Cell {
+    std::vector<std::pair<glm::vec3, glm::vec3>> boxes;
+    std::vector<size_t> portals;
+  };
+
+  struct Portal {
+    int cells[2];
+    std::vector<glm::vec3> polygon;
+  };
+
+  /// screen rectangle (min x, min y, max x, max y in normalized device coordinates) per cube face, empty if min > max
+  typedef std::array<glm::vec4, 6> FaceRects;
+
+  /// visits cell seen through rects and follows its portals
+  void visit(int cell, const FaceRects &rects, size_t depth, const std::array<glm::mat4, 6> &view_projection);
+
+  /// index into cells_ (and visible cells) with exterior as the last entry
+  size_t slot(int cell) const { return cell == exterior ? cells_.size() : static_cast<size_t>(cell); }
+
+  std::vector<Cell> cells_;
+  Cell exterior_;
+  std::vector<Portal> portals_;
+  std::vector<int> object_cells_;
+  size_t max_depth_{8};
+
+  std::vector<bool> visible_cells_;
+  std::vector<bool> on_path_;
+  std::vector<bool> visible_objects_;
+};
+}  // namespace quavis
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef QUAVIS_RENDER_PROJECTION
+#define QUAVIS_RENDER_PROJECTION
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace quavis {
+/// how the directions around an observation point are laid out in the render target
+enum class Projection {
+  CUBE,       ///< 6 layers, one per cube face
+  OCTAHEDRAL  ///< 1 square layer, the sphere projected onto an octahedron and unfolded: the upper hemisphere fills the inner diamond, the lower
+              ///< hemisphere is folded into the corners
+};
+
+/// number of layers of the render target
+inline uint32_t get_projection_layers(Projection projection)
+{
+  return projection == Projection::OCTAHEDRAL ? 1 : 6;
+}
+
+/// preprocessor definitions that select the projection in the shaders
+inline std::vector<std::string> get_projection_defines(Projection projection)
+{
+  if (projection == Projection::OCTAHEDRAL) return {"QUAVIS_OCTAHEDRAL"};
+  return {};
+}
+}  // namespace quavis
+
+#endif
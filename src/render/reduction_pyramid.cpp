@@ -0,0 +1,160 @@
+#include "reduction_pyramid.h"
+
+#include "../utils/shader_loader.h"
+#include "./device_queues.h"
+
+namespace quavis {
+
+namespace {
+/// reduces 2x2 texels of the next finer level, the first level reads the render target
+const char *reduction_shader = R"(
+  #version 450
+
+  layout (local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+#ifdef QUAVIS_REDUCE_TARGET
+#ifndef QUAVIS_TARGET_FORMAT
+  #define QUAVIS_TARGET_FORMAT rgba32f
+  #define QUAVIS_TARGET_DISTANCE a
+#endif
+#ifdef QUAVIS_SAMPLES
+  layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DMSArray source;
+#else
+  layout (binding = 0, QUAVIS_TARGET_FORMAT) uniform readonly image2DArray source;
+#endif
+#else
+  layout (binding = 0, rg32f) uniform readonly image2DArray source;
+#endif
+  layout (binding = 1, rg32f) uniform writeonly image2DArray destination;
+
+  layout(push_constant) uniform Parameters {
+    int width;  // of the destination
+    int height;
+  } parameters;
+
+  // covered fraction and cubed distance of the source texel p
+  vec2 load(ivec3 p) {
+#ifdef QUAVIS_REDUCE_TARGET
+    vec2 value = vec2(0.0f);
+#ifdef QUAVIS_SAMPLES
+    for (int s = 0; s < QUAVIS_SAMPLES; s++) {
+      float d = imageLoad(source, p, s).QUAVIS_TARGET_DISTANCE;
+      value += vec2(d > 0 ? 1.0f : 0.0f, d*d*d);
+    }
+    return value / float(QUAVIS_SAMPLES);
+#else
+    float d = imageLoad(source, p).QUAVIS_TARGET_DISTANCE;
+    return vec2(d > 0 ? 1.0f : 0.0f, d*d*d);
+#endif
+#else
+    return imageLoad(source, p).rg;
+#endif
+  }
+
+  void main() {
+    ivec3 p = ivec3(gl_GlobalInvocationID);
+    if (p.x >= parameters.width || p.y >= parameters.height) return;
+
+    ivec3 q = ivec3(2*p.xy, p.z);
+    vec2 value = load(q) + load(q + ivec3(1, 0, 0)) + load(q + ivec3(0, 1, 0)) + load(q + ivec3(1, 1, 0));
+    imageStore(destination, p, vec4(0.25f*value, 0.0f, 0.0f));
+  }
+)";
+}  // namespace
+
+ReductionPyramid::ReductionPyramid(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2 &render_size, uint32_t layers, uint32_t levels,
+                                   const std::vector<std::string> &target_defines)
+  : device_ptr_{device_ptr}
+  , layers_{layers}
+{
+  auto device{device_ptr_.lock()};
+  auto pipeline_manager{device->get_compute_pipeline_manager()};
+  const auto queues = get_device_queues(device);
+  queue_            = queues.compute;
+  command_pool_     = queues.compute_pool;
+
+  std::vector<std::string> first_defines(target_defines);
+  first_defines.push_back("QUAVIS_REDUCE_TARGET");
+
+  for (uint32_t l = 1; l <= levels; l++) {
+    Level level;
+    level.size  = render_size / (1 << l);
+    level.image = std::make_shared<CubeImages>(device_ptr_, level.size, CubeImages::USAGE_STORAGE, layers_, VK_SAMPLE_COUNT_1_BIT,
+                                               VK_FORMAT_R32G32_SFLOAT);
+
+    level.shader = ShaderLoader::create_shader_entry(device_ptr_, reduction_shader, Anvil::ShaderStage::SHADER_STAGE_COMPUTE,
+                                                     l == 1 ? first_defines : std::vector<std::string>());
+    pipeline_manager->add_regular_pipeline(false, false, *level.shader, &level.pipeline);
+    pipeline_manager->attach_push_constant_range_to_pipeline(level.pipeline, 0, sizeof(glm::ivec2), VK_SHADER_STAGE_COMPUTE_BIT);
+
+    level.descriptor_group = Anvil::DescriptorSetGroup::create(device_ptr_, false, 1);
+    level.descriptor_group->add_binding(0, 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr);
+    level.descriptor_group->add_binding(0, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr);
+    pipeline_manager->set_pipeline_dsg(level.pipeline, level.descriptor_group);
+
+    levels_.push_back(std::move(level));
+  }
+}
+
+void ReductionPyramid::build(std::shared_ptr<CubeImages> target)
+{
+  if (levels_.empty()) return;
+
+  // recordings of released targets are dropped, so a new target at the same address gets a new one
+  for (auto it = recordings_.begin(); it != recordings_.end();) {
+    it = it->second.target.expired() ? recordings_.erase(it) : std::next(it);
+  }
+
+  auto &recording = recordings_[target.get()];
+  if (recording.command_buffer == nullptr) {
+    recording.target         = target;
+    recording.command_buffer = command_pool_->alloc_primary_level_command_buffer();
+    for (const auto &level : levels_) {
+      recording.descriptor_groups.push_back(Anvil::DescriptorSetGroup::create(level.descriptor_group, false /* releaseable_sets */));
+    }
+  }
+
+  // the commands only depend on the target and its layout
+  if (recording.layout_before == target->get_image_layout()) {
+    target->set_image_layout(recording.layout_after);
+  } else {
+    record(recording, target);
+  }
+  target->submit_after_writes(queue_, recording.command_buffer);
+}
+
+void ReductionPyramid::record(Recording &recording, std::shared_ptr<CubeImages> target)
+{
+  auto device{device_ptr_.lock()};
+  auto pipeline_manager{device->get_compute_pipeline_manager()};
+  auto command_buffer = recording.command_buffer;
+
+  recording.layout_before = target->get_image_layout();
+  command_buffer->start_recording(false, false);
+
+  auto source = target->get_storage_image_view(command_buffer, queue_);
+  for (size_t l = 0; l < levels_.size(); l++) {
+    auto &level          = levels_[l];
+    auto pipeline_layout = pipeline_manager->get_compute_pipeline_layout(level.pipeline);
+    auto bindings        = recording.descriptor_groups[l]->get_descriptor_set(0);
+    auto destination     = level.image->get_view_texture_array();
+
+    bindings->set_binding_item(0, Anvil::DescriptorSet::StorageImageBindingElement(VK_IMAGE_LAYOUT_GENERAL, source));
+    bindings->set_binding_item(1, Anvil::DescriptorSet::StorageImageBindingElement(VK_IMAGE_LAYOUT_GENERAL, destination));
+
+    command_buffer->record_bind_pipeline(VK_PIPELINE_BIND_POINT_COMPUTE, level.pipeline);
+    command_buffer->record_push_constants(pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(level.size), &level.size);
+    command_buffer->record_bind_descriptor_sets(VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1, &bindings, 0, nullptr);
+    command_buffer->record_dispatch((level.size.x + 7) / 8, (level.size.y + 7) / 8, layers_);
+
+    // the next level reads this one
+    const Anvil::MemoryBarrier barrier(VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+    command_buffer->record_pipeline_barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FALSE, 1, &barrier, 0,
+                                            nullptr, 0, nullptr);
+    source = destination;
+  }
+
+  command_buffer->stop_recording();
+  recording.layout_after = target->get_image_layout();
+}
+}  // namespace quavis
@@ -0,0 +1,62 @@
+#ifndef QUAVIS_RENDER_REDUCTION_PYRAMID
+#define QUAVIS_RENDER_REDUCTION_PYRAMID
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "./anvil.h"
+#include "./cube_images.h"
+
+namespace quavis {
+
+/// Coarser versions of the render target for compute stages that converge at a lower resolution. Level l has the render size divided by 2^l,
+/// each texel holds the covered fraction (r) and the mean cubed distance (g) of the 2^l x 2^l render target texels below it, so coverage and
+/// volume are kept exactly on average
+class ReductionPyramid {
+ public:
+  /// levels 1 to levels for a render target of render_size with layers, target_defines describe its layout (see Render::get_shader_defines)
+  ReductionPyramid(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const glm::ivec2 &render_size, uint32_t layers, uint32_t levels,
+                   const std::vector<std::string> &target_defines);
+
+  /// reduces the render target into all levels
+  void build(std::shared_ptr<CubeImages> target);
+
+  /// the image of level 1 to get_levels()
+  std::shared_ptr<CubeImages> get_level(uint32_t level) const { return levels_[level - 1].image; }
+  uint32_t get_levels() const { return static_cast<uint32_t>(levels_.size()); }
+
+ private:
+  struct Level {
+    glm::ivec2 size;
+    std::shared_ptr<CubeImages> image;
+
+    std::shared_ptr<Anvil::ShaderModuleStageEntryPoint> shader;
+    Anvil::ComputePipelineID pipeline;
+    std::shared_ptr<Anvil::DescriptorSetGroup> descriptor_group;  ///< 0: the next finer level, 1: this level
+  };
+
+  /// the commands reducing one render target, recorded once and submitted again while the target is in the same layout
+  struct Recording {
+    std::weak_ptr<CubeImages> target;
+    std::shared_ptr<Anvil::PrimaryCommandBuffer> command_buffer;
+    std::vector<std::shared_ptr<Anvil::DescriptorSetGroup>> descriptor_groups;  ///< per level, sharing the layout of its pipeline
+    VkImageLayout layout_before{VK_IMAGE_LAYOUT_MAX_ENUM};
+    VkImageLayout layout_after{VK_IMAGE_LAYOUT_MAX_ENUM};
+  };
+
+  void record(Recording &recording, std::shared_ptr<CubeImages> target);
+
+  std::weak_ptr<Anvil::SGPUDevice> device_ptr_;
+  std::shared_ptr<Anvil::Queue> queue_;
+  std::shared_ptr<Anvil::CommandPool> command_pool_;
+  uint32_t layers_;
+  std::vector<Level> levels_;
+  std::map<CubeImages *, Recording> recordings_;
+};
+}  // namespace quavis
+
+#endif
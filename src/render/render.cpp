@@ -1,7 +1,13 @@
 #include "render.h"
 
+#include <algorithm>
 #include <functional>
+#include <future>
+#include <map>
+#include <thread>
+#include <tuple>
 
+#include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "../app_config.h"
@@ -33,13 +39,55 @@ VkBool32 on_validation_callback(VkDebugReportFlagsEXT message_flags, VkDebugRepo
   return false;
 }
 
+/// smallest angle between the unit vector dir and the directions of cube face (layer order +x, -x, +y, -y, +z, -z)
+float angle_to_face(const glm::vec3 &dir, size_t face)
+{
+  static const glm::vec3 forward[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+  static const glm::vec3 right[6]   = {{0, 1, 0}, {0, -1, 0}, {-1, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, 1, 0}};
+  static const glm::vec3 down[6]    = {{0, 0, -1}, {0, 0, -1}, {0, 0, -1}, {0, 0, -1}, {1, 0, 0}, {-1, 0, 0}};
+
+  const glm::vec3 &f = forward[face];
+  const glm::vec3 &r = right[face];
+  const glm::vec3 &d = down[face];
+
+  // inside the pyramid of the face
+  const float df = glm::dot(dir, f);
+  if (df > 0.0f && glm::abs(glm::dot(dir, r)) <= df && glm::abs(glm::dot(dir, d)) <= df) return 0.0f;
+
+  // otherwise the closest direction is on one of the 4 edges (great circle arcs between the corners)
+  const glm::vec3 corners[4] = {glm::normalize(f - r - d), glm::normalize(f + r - d), glm::normalize(f + r + d), glm::normalize(f - r + d)};
+
+  float best = glm::pi<float>();
+  for (size_t e = 0; e < 4; e++) {
+    const glm::vec3 &a = corners[e];
+    const glm::vec3 &b = corners[(e + 1) % 4];
+    best               = glm::min(best, glm::acos(glm::clamp(glm::dot(dir, a), -1.0f, 1.0f)));
+
+    const glm::vec3 n = glm::normalize(glm::cross(a, b));
+    const glm::vec3 p = dir - glm::dot(dir, n) * n;
+    if (glm::length(p) < 1e-6f) continue;
+    if (glm::dot(glm::cross(a, p), n) >= 0.0f && glm::dot(glm::cross(p, b), n) >= 0.0f) {
+      best = glm::min(best, glm::acos(glm::clamp(glm::dot(dir, glm::normalize(p)), -1.0f, 1.0f)));
+    }
+  }
+  return best;
+}
+
 // Render function
 
-Render::Render(const glm::ivec2 &render_dim, uint32_t vulkan_device_idx)
+Render::Render(const glm::ivec2 &render_dim, uint32_t vulkan_device_idx, Projection projection)
 {
   render_size_ = render_dim;
+  projection_  = projection;
+  face_sizes_.fill(render_dim);
 
   init_vulkan(vulkan_device_idx);
+
+  // the octahedral projection clips each triangle to its octant
+  if (projection_ == Projection::OCTAHEDRAL && !device_ptr_.lock()->get_physical_device_features().shaderClipDistance) {
+    throw std::runtime_error("The octahedral projection needs a GPU supporting clip distances");
+  }
+
   create_framebuffer();
   create_render_pass();
   create_base_pipeline();
@@ -49,6 +97,12 @@ Render::Render(const glm::ivec2 &render_dim, uint32_t vulkan_device_idx)
   dirty_observations_ = true;
 }
 
+Render::~Render()
+{
+  // the buffers and images of the last draw are released with the renderer
+  wait_for_draw();
+}
+
 void Render::add_static_scene_object(std::shared_ptr<SceneObject> sceneObject)
 {
   dirty_scene_ = true;
@@ -72,32 +126,296 @@ std::shared_ptr<CubeImages> Render::get_depth_cube()
   return cube_images_depth_;
 }
 
-std::shared_ptr<CubeImages> Render::draw(size_t observation_idx)
+std::shared_ptr<CubeImages> Render::draw(size_t observation_idx, uint32_t level)
 {
   // create_framebuffer();
   // create_images();
 
+  // without impostors every observation draws all objects, which would keep every tile on the GPU
+  if (streamer_ != nullptr && impostor_radius_ <= 0.0f) {
+    throw std::runtime_error("Streaming needs impostors for the objects beyond the streaming radius");
+  }
+
+  // the buffers and pipelines below may be recreated, they are used by the submitted draw
+  wait_for_draw();
+
   if (dirty_scene_) {
     create_static_object_buffers();
     create_material_pipelines();
-    dirty_scene_ = false;
+    dirty_scene_     = false;
+    dirty_impostors_ = true;
   }
 
   if (dirty_observations_) {
+    create_impostor_anchors();
     create_observations_ubo();
     dirty_observations_ = false;
+    dirty_impostors_    = true;
   }
 
-  // select right observation
-  view_set_->set_binding_item(
-    0, Anvil::DescriptorSet::UniformBufferBindingElement(view_mat_ubo_, observation_idx * sizeof(SceneShaderData), sizeof(SceneShaderData)));
-  view_set_->bake();
+  // new pipelines or views, both are followed by the impostors
+  if (dirty_impostors_) {
+    bind_views();
+    bake_impostors();
+    dirty_impostors_ = false;
+  }
 
-  draw_static_objects();
+  // the previous target may still be read by the compute stages
+  target_idx_        = (target_idx_ + 1) % color_targets_.size();
+  cube_images_color_ = color_targets_[target_idx_];
+  framebuffer_       = framebuffers_[target_idx_];
+
+  const auto &eye = observations_[observation_idx].position;
+  if (impostors_.empty()) {
+    draw_static_objects(observation_idx, eye, get_view_objects(eye, nullptr, true), -1, level);
+  } else {
+    const auto impostor_idx = observation_impostor_[observation_idx];
+    draw_static_objects(observation_idx, eye, get_view_objects(eye, &impostors_[impostor_idx].near_objects, true), static_cast<int>(impostor_idx),
+                        level);
+  }
+
+  if (reduction_pyramid_ != nullptr && level == 0) {
+    reduction_pyramid_->build(get_color_cube());
+  }
 
   return get_color_cube();
 }
 
+void Render::set_impostors(float radius, float spacing)
+{
+  if (radius > 0.0f && projection_ != Projection::CUBE) {
+    throw std::runtime_error("Impostors need the cube projection");
+  }
+  if (radius > 0.0f && samples_ > 1) {
+    throw std::runtime_error("Impostors need a single sample per texel");
+  }
+
+  impostor_radius_    = radius;
+  impostor_spacing_   = spacing;
+  dirty_scene_        = true;
+  dirty_observations_ = true;
+}
+
+void Render::set_streaming(float tile_size, float radius, VkDeviceSize budget)
+{
+  streamer_    = tile_size > 0.0f ? std::make_shared<TileStreamer>(tile_size, radius, budget) : nullptr;
+  dirty_scene_ = true;
+}
+
+void Render::set_face_sizes(const std::array<glm::ivec2, 6> &face_sizes)
+{
+  if (projection_ != Projection::CUBE) {
+    throw std::runtime_error("Face sizes need the cube projection");
+  }
+  for (const auto &size : face_sizes) {
+    if (glm::any(glm::lessThanEqual(size, glm::ivec2(0))) || glm::any(glm::greaterThan(size, render_size_))) {
+      throw std::runtime_error("Face sizes must be positive and at most the render size");
+    }
+  }
+
+  if (reduction_levels_ > 0) {
+    throw std::runtime_error("Face sizes cannot be combined with reduction levels");
+  }
+
+  // the geometry shader selects a viewport per face
+  const bool differ = std::any_of(face_sizes.begin(), face_sizes.end(), [&](const glm::ivec2 &size) { return size != render_size_; });
+  if (differ && !device_ptr_.lock()->get_physical_device_features().multiViewport) {
+    throw std::runtime_error("Face sizes need a GPU supporting multiple viewports");
+  }
+
+  face_sizes_  = face_sizes;
+  dirty_scene_ = true;
+}
+
+void Render::set_samples(uint32_t samples)
+{
+  if (samples == 0 || (samples & (samples - 1)) != 0) {
+    throw std::runtime_error("Samples per texel must be a power of two");
+  }
+  if (samples == samples_) return;
+  if (samples > 1 && impostor_radius_ > 0.0f) {
+    throw std::runtime_error("Impostors need a single sample per texel");
+  }
+
+  // the compute stages read the samples of the color attachment as a storage image
+  auto device{device_ptr_.lock()};
+  const auto &limits              = device->get_physical_device_properties().limits;
+  const VkSampleCountFlags counts = limits.framebufferColorSampleCounts & limits.framebufferDepthSampleCounts & limits.storageImageSampleCounts;
+  if (samples > 1 && ((counts & samples) == 0 || !device->get_physical_device_features().shaderStorageImageMultisample)) {
+    throw std::runtime_error("The GPU does not support " + std::to_string(samples) + " samples per texel");
+  }
+
+  samples_ = samples;
+
+  // the attachments and pipelines depend on the sample count, the old ones may be used by the submitted draw
+  wait_for_draw();
+  create_framebuffer();
+  create_images();
+  dirty_scene_ = true;
+}
+
+void Render::set_target_layout(TargetLayout layout)
+{
+  auto device{device_ptr_.lock()};
+  if (layout == TargetLayout::RED_DISTANCE && !device->get_physical_device_features().shaderStorageImageExtendedFormats) {
+    layout = TargetLayout::COLOR_DISTANCE;
+  }
+  if (layout == target_layout_) return;
+
+  target_layout_ = layout;
+  logger_->info("Render target with {} bytes per texel", get_target_texel_size(layout));
+
+  // the attachments, pipelines and impostor cubes depend on the format, the old ones may be used by the submitted draw
+  wait_for_draw();
+  create_framebuffer();
+  create_images();
+  dirty_scene_        = true;
+  dirty_observations_ = true;
+}
+
+void Render::set_reduction_levels(uint32_t levels)
+{
+  if (levels == reduction_levels_) return;
+  if (levels > 0 && has_face_sizes()) {
+    throw std::runtime_error("Reduction levels cannot be combined with face sizes");
+  }
+  if (render_size_.x % (1 << levels) != 0 || render_size_.y % (1 << levels) != 0) {
+    throw std::runtime_error("The render size must be divisible by 2^" + std::to_string(levels) + " for " + std::to_string(levels) +
+                             " reduction levels");
+  }
+
+  reduction_levels_ = levels;
+  create_reduction_pyramid();
+}
+
+std::shared_ptr<CubeImages> Render::get_reduced_image(uint32_t level) const
+{
+  if (level == 0) return cube_images_color_;
+  if (level > reduction_levels_) {
+    throw std::out_of_range("Reduction level " + std::to_string(level) + " is not built");
+  }
+  return reduction_pyramid_->get_level(level);
+}
+
+glm::ivec2 Render::get_level_size(uint32_t level) const
+{
+  return render_size_ / (1 << level);
+}
+
+bool Render::has_face_sizes() const
+{
+  for (const auto &size : face_sizes_) {
+    if (size != render_size_) return true;
+  }
+  return false;
+}
+
+std::vector<std::string> Render::get_shader_defines(uint32_t reduction_level) const
+{
+  auto defines = get_projection_defines(projection_);
+  if (reduction_level > 0) {
+    // the reduced images hold the covered fraction and the mean cubed distance of single sampled texels
+    defines.push_back("QUAVIS_REDUCED");
+    defines.push_back("QUAVIS_TARGET_FORMAT rg32f");
+    return defines;
+  }
+  if (has_face_sizes()) {
+    std::string sizes;
+    for (const auto &size : face_sizes_) {
+      sizes += (sizes.empty() ? "" : ",") + std::string("ivec2(") + std::to_string(size.x) + "," + std::to_string(size.y) + ")";
+    }
+    defines.push_back("QUAVIS_FACE_SIZES ivec2[6](" + sizes + ")");
+  }
+  if (samples_ > 1) {
+    defines.push_back("QUAVIS_SAMPLES " + std::to_string(samples_));
+  }
+  for (const auto &define : get_target_defines(target_layout_)) {
+    defines.push_back(define);
+  }
+  return defines;
+}
+
+void Render::set_direction_domains(const std::vector<DirectionDomain> &domains)
+{
+  direction_domains_  = domains;
+  dirty_observations_ = true;
+}
+
+uint32_t Render::compute_face_mask(const Observation &observation) const
+{
+  const uint32_t all_faces = 0x3f;
+  // the octahedral map has a single layer
+  if (direction_domains_.empty() || projection_ != Projection::CUBE) return all_faces;
+
+  uint32_t mask = 0;
+  for (auto domain : direction_domains_) {
+    switch (domain) {
+      case DirectionDomain::FULL_SPHERE:
+        mask |= all_faces;
+        break;
+      case DirectionDomain::UPPER_HEMISPHERE:
+        // only the -z face lies completely below the horizon
+        mask |= all_faces & ~(1u << 5);
+        break;
+      case DirectionDomain::VIEW_CONE: {
+        const float half_angle = glm::radians(observation.field_of_view);
+        if (half_angle >= glm::pi<float>() || glm::length(observation.view_direction) == 0.0f) {
+          mask |= all_faces;
+          break;
+        }
+        const glm::vec3 dir = glm::normalize(observation.view_direction);
+        for (size_t f = 0; f < 6; f++) {
+          // small margin for the rounding of the angle
+          if (angle_to_face(dir, f) <= half_angle + 1e-4f) mask |= 1u << f;
+        }
+        break;
+      }
+    }
+  }
+  return mask;
+}
+
+std::vector<size_t> Render::get_observation_order() const
+{
+  if (streamer_ != nullptr) {
+    return streamer_->order_observations(observations_);
+  }
+
+  std::vector<size_t> order(observations_.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  return order;
+}
+
+const std::vector<bool> *Render::get_view_objects(const glm::vec3 &eye, const std::vector<bool> *object_mask, bool use_portals)
+{
+  const std::vector<bool> *view_mask = object_mask;
+  if (use_portals && portal_culling_ != nullptr) {
+    const auto &visible = portal_culling_->compute_visible_objects(eye, get_cube_view_projection(eye));
+    view_objects_.resize(scene_objects_.size());
+    for (size_t i = 0; i < view_objects_.size(); i++) {
+      view_objects_[i] = visible[i] && (object_mask == nullptr || (*object_mask)[i]);
+    }
+    view_mask = &view_objects_;
+  }
+
+  // streaming only bounds the geometry on the GPU, the tiles of all drawn objects are uploaded
+  if (streamer_ != nullptr) streamer_->make_resident(eye, view_mask, device_ptr_);
+
+  return view_mask;
+}
+
+void Render::bind_views()
+{
+  // the recorded commands reference the descriptor set, which must not be updated after recording
+  invalidate_command_chunks();
+
+  view_set_->set_binding_item(0, Anvil::DescriptorSet::UniformBufferBindingElement(face_mat_ubo_));
+  view_set_->set_binding_item(1, Anvil::DescriptorSet::StorageBufferBindingElement(view_ssbo_));
+  view_set_->bake();
+}
+
 void Render::init_vulkan(uint32_t vulkan_device_idx)
 {
   // decide if do validation
@@ -128,31 +446,77 @@ void Render::init_vulkan(uint32_t vulkan_device_idx)
 
   // std::string name1(physical_device_ptr1.lock()->get_device_properties().deviceName);
 
-  /* Create a Vulkan device */
+  /* Create a Vulkan device, Anvil enables all features of the physical device. Optional features are checked where they are needed */
   device_ptr_ = Anvil::SGPUDevice::create(physical_device_ptr, Anvil::DeviceExtensionConfiguration(), std::vector<std::string>(), /* layers */
                                           false, /* transient_command_buffer_allocs_only */
-                                          false);
+                                          true); /* support_resettable_command_buffer_allocs, the command buffers of the draws and compute
+                                                    stages are allocated once and recorded again */
 
   auto device = device_ptr_.lock();
 
   gfx_pipeline_manager_ptr_ = {device->get_graphics_pipeline_manager()};
+
+  queues_     = get_device_queues(device);
+  draw_fence_ = Anvil::Fence::create(device_ptr_, false);
+  logger_->info("Compute stages on {} queue, readbacks on {} queue", queues_.has_async_compute() ? "an async compute" : "the universal",
+                queues_.transfer != queues_.graphics ? "a transfer" : "the universal");
+}
+
+void Render::wait_for_draw()
+{
+  if (pending_draw_ == nullptr) return;
+
+  auto device{device_ptr_.lock()};
+  vkWaitForFences(device->get_device_vk(), 1, draw_fence_->get_fence_ptr(), VK_TRUE, UINT64_MAX);
+  draw_fence_->reset();
+  pending_draw_ = nullptr;
 }
 
 void Render::create_images()
 {
-  cube_images_color_ = std::make_shared<CubeImages>(device_ptr_, render_size_, CubeImages::USAGE_COLOR_ATTACHMENT);
-  cube_images_depth_ = std::make_shared<CubeImages>(device_ptr_, render_size_, CubeImages::USAGE_DEPTH_ATTACHMENT);
+  const auto layers  = get_projection_layers(projection_);
+  const auto samples = static_cast<VkSampleCountFlagBits>(samples_);
+  cube_images_depth_ = std::make_shared<CubeImages>(device_ptr_, render_size_, CubeImages::USAGE_DEPTH_ATTACHMENT, layers, samples);
 
   // cube_images_color_->clear_images( { 0.0f, 0.8f, 0.3f, 1.0f } );
   // cube_images_depth_->clear_images( {-1.0f, -1.0f, -1.0f, -1.0f });
-  framebuffer_->add_attachment(cube_images_color_->get_view_cubemap(), &framebuffer_color_attachment_id_);
-  framebuffer_->add_attachment(cube_images_depth_->get_view_cubemap(), nullptr);
+  // the depth is only used within a draw, so the targets share it
+  color_targets_.clear();
+  draw_commands_.clear();
+  draw_semaphores_.clear();
+  for (auto &framebuffer : framebuffers_) {
+    color_targets_.push_back(std::make_shared<CubeImages>(device_ptr_, render_size_, CubeImages::USAGE_COLOR_ATTACHMENT, layers, samples,
+                                                          get_target_format(target_layout_)));
+    framebuffer->add_attachment(color_targets_.back()->get_view_cubemap(), &framebuffer_color_attachment_id_);
+    framebuffer->add_attachment(cube_images_depth_->get_view_cubemap(), nullptr);
+    draw_commands_.push_back(queues_.graphics_pool->alloc_primary_level_command_buffer());
+    draw_semaphores_.push_back(nullptr);
+  }
+  target_idx_        = 0;
+  cube_images_color_ = color_targets_[target_idx_];
+  framebuffer_       = framebuffers_[target_idx_];
+
+  create_reduction_pyramid();
+}
+
+void Render::create_reduction_pyramid()
+{
+  // reads the render target, so it depends on its samples and format
+  reduction_pyramid_ = nullptr;
+  if (reduction_levels_ > 0) {
+    reduction_pyramid_ = std::make_shared<ReductionPyramid>(device_ptr_, render_size_, get_projection_layers(projection_), reduction_levels_,
+                                                            get_shader_defines());
+  }
 }
 
 void Render::create_framebuffer()
 {
-  framebuffer_ = Anvil::Framebuffer::create(device_ptr_, render_size_.x, render_size_.y, 6);
-  framebuffer_->set_name("Framebuffer cube map target");
+  // with async compute the next view is drawn into a second target while the compute stages read the first
+  framebuffers_.resize(queues_.has_async_compute() ? 2 : 1);
+  for (auto &framebuffer : framebuffers_) {
+    framebuffer = Anvil::Framebuffer::create(device_ptr_, render_size_.x, render_size_.y, get_projection_layers(projection_));
+    framebuffer->set_name("Framebuffer cube map target");
+  }
 }
 
 void Render::create_render_pass() {}
@@ -167,37 +531,190 @@ void Render::create_base_pipeline()
 void Render::create_material_pipelines()
 {
   material_cache.clear();
-  for (const auto &obj : scene_objects_) {
-    auto material = obj->get_material();
-    if (material_cache.find(material->get_name()) == material_cache.end()) {
+  create_material_textures();
+  for (size_t i = 0; i < scene_objects_.size(); i++) {
+    const auto &obj = scene_objects_[i];
+    auto material   = obj->get_material();
+    auto geometry = obj->get_geometry();
+    // materials without shaders of their own share one pipeline and differ only in the material index of the object. The vertex formats are part
+    // of the pipeline, so each layout needs its own
+    auto key = (material->has_own_pipeline() ? material->get_name() : std::string("shared")) + "/" + geometry->get_vertex_layout_name();
+    if (material_cache.find(key) == material_cache.end()) {
       // create a new Material
-      MaterialCache cache{create_pipeline_for_material(material)};
-      material_cache[material->get_name()] = cache;
+      MaterialCache cache{create_pipeline_for_material(material, geometry)};
+      material_cache[key] = cache;
+    }
+
+    material_cache[key].objects.push_back(obj);
+    material_cache[key].object_indices.push_back(i);
+  }
+
+  // the background of the impostors is a cube around the observation, drawn with its own pipeline
+  if (impostor_radius_ > 0.0f) {
+    if (impostor_material_ == nullptr) {
+      impostor_material_ = std::make_shared<MaterialImpostor>();
+      impostor_geometry_ = DrawableGeometry::create_unit_cube();
+      impostor_geometry_->prepare_for_draw(device_ptr_);
+    }
+    impostor_cache_ = create_pipeline_for_material(impostor_material_, impostor_geometry_);
+  }
+
+  // the pipelines are baked before the threads recording the command buffers use them
+  gfx_pipeline_manager_ptr_->bake();
+  create_command_chunks();
+}
+
+void Render::create_material_textures()
+{
+  auto device{device_ptr_.lock()};
+
+  // each distinct texture is bound once, the objects select it by their material index
+  material_textures_.clear();
+  std::map<CubeImages *, uint32_t> texture_indices;
+  for (const auto &obj : scene_objects_) {
+    const auto material = obj->get_material();
+    const auto texture  = material->get_texture();
+    if (material->has_own_pipeline() || texture == nullptr) {
+      obj->set_material_index(0);
+      continue;
+    }
+    auto it = texture_indices.find(texture.get());
+    if (it == texture_indices.end()) {
+      it = texture_indices.emplace(texture.get(), static_cast<uint32_t>(material_textures_.size())).first;
+      material_textures_.push_back(texture);
+    }
+    obj->set_material_index(it->second + 1);
+  }
+
+  const auto &limits = device->get_physical_device_properties().limits;
+  if (material_textures_.size() > std::min(limits.maxPerStageDescriptorSamplers, limits.maxPerStageDescriptorSampledImages)) {
+    throw std::runtime_error("The GPU cannot bind " + std::to_string(material_textures_.size()) + " material textures");
+  }
+  if (material_textures_.size() > 1 && !device->get_physical_device_features().shaderSampledImageArrayDynamicIndexing) {
+    throw std::runtime_error("The GPU cannot select one of several material textures in a shader");
+  }
+
+  if (!material_textures_.empty() && material_sampler_ == nullptr) {
+    material_sampler_ = Anvil::Sampler::create(device_ptr_, VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_MIPMAP_MODE_NEAREST,
+                                               VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_REPEAT, 0, 0, false,
+                                               VK_COMPARE_OP_NEVER, 0.0, 0.0, VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK, false);
+  }
+}
+
+void Render::create_command_chunks()
+{
+  auto device{device_ptr_.lock()};
+  const size_t workers = std::max(1u, std::thread::hardware_concurrency());
+  while (command_pools_.size() < workers + 1) {
+    command_pools_.push_back(Anvil::CommandPool::create(device_ptr_, false, true, /* in_support_per_cmdbuf_reset_ops */
+                                                        Anvil::QUEUE_FAMILY_TYPE_UNIVERSAL));
+  }
+
+  // chunks of about the same object count, so each thread records a similar share
+  size_t objects          = 0;
+  view_dependent_objects_ = false;
+  for (const auto &obj : scene_objects_) {
+    objects++;
+    view_dependent_objects_ = view_dependent_objects_ || obj->is_view_dependent();
+  }
+  const size_t chunk_size = std::max<size_t>(64, (objects + workers - 1) / workers);
+
+  command_chunks_.clear();
+  for (const auto &it : material_cache) {
+    for (size_t first = 0; first < it.second.objects.size(); first += chunk_size) {
+      CommandChunk chunk;
+      chunk.cache    = &it.second;
+      chunk.first    = first;
+      chunk.last     = std::min(first + chunk_size, it.second.objects.size());
+      chunk.worker   = command_chunks_.size() % workers;
+      chunk.commands = command_pools_[chunk.worker]->alloc_secondary_level_command_buffer();
+      command_chunks_.push_back(chunk);
+    }
+  }
+  impostor_commands_ = command_pools_[workers]->alloc_secondary_level_command_buffer();
+}
+
+void Render::record_viewports(std::shared_ptr<Anvil::CommandBufferBase> command_buffer, uint32_t level) const
+{
+  // lower resolution levels draw into the top left corner of the layers
+  const auto size            = get_level_size(level);
+  const uint32_t n_viewports = has_face_sizes() ? 6 : 1;
+  std::array<VkViewport, 6> viewports;
+  std::array<VkRect2D, 6> scissors;
+  for (uint32_t v = 0; v < n_viewports; v++) {
+    const glm::ivec2 view_size = n_viewports == 1 ? size : face_sizes_[v] / (1 << level);
+    viewports[v]               = {0.0f, 0.0f, static_cast<float>(view_size.x), static_cast<float>(view_size.y), 0.0f, 1.0f};
+    scissors[v].offset         = {0, 0};
+    scissors[v].extent         = {static_cast<uint32_t>(view_size.x), static_cast<uint32_t>(view_size.y)};
+  }
+  command_buffer->record_set_viewport(0, n_viewports, viewports.data());
+  command_buffer->record_set_scissor(0, n_viewports, scissors.data());
+}
+
+size_t Render::record_command_chunk(CommandChunk &chunk, const glm::vec3 &eye, const std::vector<bool> *object_mask, float lod_angle,
+                                    uint32_t level)
+{
+  const auto &pipeline = *chunk.cache;
+  auto pipeline_layout = gfx_pipeline_manager_ptr_->get_graphics_pipeline_layout(pipeline.pipeline);
+  size_t culled_meshlets = 0;
+
+  // secondary command buffers inherit nothing but the render pass, the framebuffer is left open as the color targets alternate
+  const std::shared_ptr<Anvil::CommandBufferBase> command_buffer = chunk.commands;
+  chunk.commands->start_recording(false, false, true, /* in_renderpass_usage_only */
+                                  nullptr, pipeline.render_pass, pipeline.subpass, Anvil::OCCLUSION_QUERY_SUPPORT_SCOPE_NOT_REQUIRED, false, 0);
+
+  record_viewports(command_buffer, level);
+  command_buffer->record_bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 1, 1, &view_set_, 0, nullptr);
+  command_buffer->record_bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+  // the textures of the shared pipeline are bound once, the objects select theirs by the material index of the push constants
+  if (pipeline.material_set != nullptr) {
+    auto material_set = pipeline.material_set;
+    command_buffer->record_bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 2, 1, &material_set, 0, nullptr);
+  }
+
+  // the per object commands are raw calls, the wrappers search all objects referenced by the command buffer on each call
+  const auto commands = command_buffer->get_command_buffer();
+  const auto layout   = pipeline_layout->get_pipeline_layout();
+  for (size_t o = chunk.first; o < chunk.last; o++) {
+    if (object_mask != nullptr && !(*object_mask)[pipeline.object_indices[o]]) continue;
+
+    const auto &obj = pipeline.objects[o];
+    if (pipeline.own_pipeline) {
+      obj->get_material()->set_material_properties(device_ptr_, command_buffer, pipeline_layout);
     }
 
-    material_cache[material->get_name()].objects.push_back(obj);
+    // object properties (model matrix, material index)
+    vkCmdPushConstants(commands, layout, VK_SHADER_STAGE_ALL_GRAPHICS, 0, sizeof(SceneObject::ObjectShaderData), &obj->get_shader_data());
+    culled_meshlets += obj->draw(device_ptr_, command_buffer, eye, lod_angle);
   }
+
+  chunk.commands->stop_recording();
+  return culled_meshlets;
 }
 
-Render::MaterialCache Render::create_pipeline_for_material(std::shared_ptr<MaterialBase> material)
+Render::MaterialCache Render::create_pipeline_for_material(std::shared_ptr<MaterialBase> material, std::shared_ptr<DrawableGeometry> geometry)
 {
   auto device{device_ptr_.lock()};
 
   MaterialCache res;
+  res.own_pipeline = material->has_own_pipeline();
 
   res.render_pass   = Anvil::RenderPass::create(device_ptr_, nullptr);
   auto &render_pass = res.render_pass;
 
+  const auto samples = cube_images_color_->get_samples();
+
   Anvil::RenderPassAttachmentID color_attachemnt_id;
-  render_pass->add_color_attachment(cube_images_color_->get_image_format(), VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR,
+  render_pass->add_color_attachment(cube_images_color_->get_image_format(), samples, VK_ATTACHMENT_LOAD_OP_CLEAR,
                                     VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
                                     false, /* may_alias */
                                     &color_attachemnt_id);
 
   Anvil::RenderPassAttachmentID depth_attachemnt_id;
 
-  render_pass->add_depth_stencil_attachment(cube_images_depth_->get_image_format(), VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR,
-                                            VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, /* stencil_load_op  */
+  // nothing reads the depth after rendering, so it does not need to be written back to memory
+  render_pass->add_depth_stencil_attachment(cube_images_depth_->get_image_format(), samples, VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                            VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, /* stencil_load_op  */
                                             VK_ATTACHMENT_STORE_OP_DONT_CARE,                              /* stencil_store_op */
                                             VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
                                             false, /* may_alias */
@@ -205,23 +722,34 @@ Render::MaterialCache Render::create_pipeline_for_material(std::shared_ptr<Mater
 
   // render_pass->add_depth_stencil_attachment()
 
-  res.shader_fragment = ShaderLoader::create_shader_entry(device_ptr_, material->get_shader_src_fragment(), Anvil::SHADER_STAGE_FRAGMENT);
-  res.shader_geometry = ShaderLoader::create_shader_entry(device_ptr_, material->get_shader_src_geometry(), Anvil::SHADER_STAGE_GEOMETRY);
+  auto defines = get_shader_defines();
+  if (!material->has_own_pipeline()) {
+    defines.push_back("QUAVIS_MATERIAL_TEXTURES " + std::to_string(material_textures_.size()));
+  }
+  res.shader_fragment = ShaderLoader::create_shader_entry(device_ptr_, material->get_shader_src_fragment(), Anvil::SHADER_STAGE_FRAGMENT, defines);
+  res.shader_geometry = ShaderLoader::create_shader_entry(device_ptr_, material->get_shader_src_geometry(), Anvil::SHADER_STAGE_GEOMETRY, defines);
   res.shader_tess_control =
     ShaderLoader::create_shader_entry(device_ptr_, material->get_shader_src_tess_control(), Anvil::SHADER_STAGE_TESSELLATION_CONTROL);
   res.shader_tess_evaluation_shader =
     ShaderLoader::create_shader_entry(device_ptr_, material->get_shader_src_tess_evaluation_shader(), Anvil::SHADER_STAGE_TESSELLATION_EVALUATION);
-  res.shader_vertex = ShaderLoader::create_shader_entry(device_ptr_, material->get_shader_src_vertex(), Anvil::SHADER_STAGE_VERTEX);
+  res.shader_vertex = ShaderLoader::create_shader_entry(
+    device_ptr_, geometry->has_vertex_data() ? material->get_shader_src_vertex() : material->get_shader_src_vertex_object_data(),
+    Anvil::SHADER_STAGE_VERTEX);
 
   render_pass->add_subpass(*res.shader_fragment, *res.shader_geometry, *res.shader_tess_control, *res.shader_tess_evaluation_shader,
                            *res.shader_vertex, &res.subpass);
 
   render_pass->get_subpass_graphics_pipeline_id(res.subpass, &res.pipeline);
 
-  // config this pipeline
-  gfx_pipeline_manager_ptr_->set_viewport_properties(res.pipeline, 0, 0.0f, 0.0f, static_cast<float>(render_size_.x),
-                                                     static_cast<float>(render_size_.y), 0.0f, 1.0f);
-  gfx_pipeline_manager_ptr_->set_scissor_box_properties(res.pipeline, 0, 0, 0, render_size_.x, render_size_.y);
+  // config this pipeline, the viewports depend on the resolution level and are set when drawing (with face sizes the geometry shader selects one
+  // viewport per layer)
+  const uint32_t viewports = has_face_sizes() ? 6 : 1;
+  gfx_pipeline_manager_ptr_->toggle_dynamic_states(
+    res.pipeline, true, Anvil::GraphicsPipelineManager::DYNAMIC_STATE_VIEWPORT_BIT | Anvil::GraphicsPipelineManager::DYNAMIC_STATE_SCISSOR_BIT);
+  gfx_pipeline_manager_ptr_->set_dynamic_viewport_state_properties(res.pipeline, viewports);
+  gfx_pipeline_manager_ptr_->set_dynamic_scissor_state_properties(res.pipeline, viewports);
+  // the fragment shader runs once per texel, its value is stored in all covered samples
+  gfx_pipeline_manager_ptr_->set_multisampling_properties(res.pipeline, samples, 0.0f, ~0u);
   gfx_pipeline_manager_ptr_->toggle_depth_test(res.pipeline, true, VK_COMPARE_OP_LESS_OR_EQUAL);
   gfx_pipeline_manager_ptr_->toggle_depth_writes(res.pipeline, true); /* should_enable */
   gfx_pipeline_manager_ptr_->set_rasterization_properties(res.pipeline, VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE,
@@ -229,17 +757,19 @@ Render::MaterialCache Render::create_pipeline_for_material(std::shared_ptr<Mater
 
   // vertex positions
   gfx_pipeline_manager_ptr_->add_vertex_attribute(res.pipeline,
-                                                  0,                           // vertex input location
-                                                  VK_FORMAT_R32G32B32_SFLOAT,  // format
-                                                  0,                           /* offset_in_bytes */
-                                                  sizeof(glm::vec3), VK_VERTEX_INPUT_RATE_VERTEX, 0);
-
-  // vertex data
-  gfx_pipeline_manager_ptr_->add_vertex_attribute(res.pipeline,
-                                                  1,                              // vertex input location
-                                                  VK_FORMAT_R32G32B32A32_SFLOAT,  // format
-                                                  0,                              /* offset_in_bytes */
-                                                  sizeof(glm::vec4), VK_VERTEX_INPUT_RATE_VERTEX, 1);
+                                                  0,                                // vertex input location
+                                                  geometry->get_position_format(),  // format
+                                                  0,                                /* offset_in_bytes */
+                                                  geometry->get_position_stride(), VK_VERTEX_INPUT_RATE_VERTEX, 0);
+
+  // vertex data, without it the object data of the push constants is used
+  if (geometry->has_vertex_data()) {
+    gfx_pipeline_manager_ptr_->add_vertex_attribute(res.pipeline,
+                                                    1,                                   // vertex input location
+                                                    geometry->get_vertex_data_format(),  // format
+                                                    0,                                   /* offset_in_bytes */
+                                                    geometry->get_vertex_data_stride(), VK_VERTEX_INPUT_RATE_VERTEX, 1);
+  }
 
   // add descriptor layouts
   add_descriptor_layouts(gfx_pipeline_manager_ptr_, res, material);
@@ -265,11 +795,25 @@ void Render::add_descriptor_layouts(std::shared_ptr<Anvil::GraphicsPipelineManag
   // SET: 0  World Static variables (lights,...)
   // not needed yet
 
-  // set 1 Per View Matrices
+  // set 1 Per View Data, the face matrices and the data of all views
   cache.descriptor_group->add_binding(1, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_ALL_GRAPHICS, nullptr);
-
-  // SET: 2  Shader Config (setting for this material for all objs)
-  material->add_per_material_description(device_ptr_, gfx_pipeline_manager_ptr_, cache.descriptor_group, cache.pipeline);
+  cache.descriptor_group->add_binding(1, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_ALL_GRAPHICS, nullptr);
+
+  // SET: 2  Shader Config, the textures of all materials of the shared pipeline or the setting of a material with a pipeline of its own
+  if (material->has_own_pipeline()) {
+    material->add_per_material_description(device_ptr_, gfx_pipeline_manager_ptr_, cache.descriptor_group, cache.pipeline);
+  } else if (!material_textures_.empty()) {
+    const auto n_textures = static_cast<uint32_t>(material_textures_.size());
+    cache.descriptor_group->add_binding(2, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, n_textures, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr);
+
+    std::vector<Anvil::DescriptorSet::CombinedImageSamplerBindingElement> textures;
+    for (const auto &texture : material_textures_) {
+      textures.emplace_back(texture->get_image_layout(), texture->get_view_cubemap(), material_sampler_);
+    }
+    cache.material_set = cache.descriptor_group->get_descriptor_set(2);
+    cache.material_set->set_binding_array_items(0, Anvil::BindingElementArrayRange(0, n_textures), textures.data());
+    cache.material_set->bake();
+  }
 
   // SET: 3  Per Object Material Parameters
   // material->add_per_objcet_descriptions(3, descriptor_group);
@@ -281,64 +825,257 @@ void Render::add_descriptor_layouts(std::shared_ptr<Anvil::GraphicsPipelineManag
   gfx_pipeline_manager_ptr_->set_pipeline_dsg(cache.pipeline, cache.descriptor_group);
 
   view_set_ = cache.descriptor_group->get_descriptor_set(1);
-
-  // view_set_->set_binding_item(0, Anvil::DescriptorSet::UniformBufferBindingElement(view_mat_ubo_));
 }
 
-void Render::create_observations_ubo()
+std::array<glm::mat4, 6> Render::get_cube_view_projection(const glm::vec3 &opos) const
 {
-  // observation point
-  std::vector<SceneShaderData> shader_data;
-  auto projection = glm::perspective<float>(3.14159f / 2.0f, static_cast<float>(render_size_.x) / static_cast<float>(render_size_.y), 0.01f, 100001.0f);
+  // each face covers 90 degrees in both directions whatever its resolution, so faces of different sizes share the matrices
+  auto projection = glm::perspective<float>(3.14159f / 2.0f, 1.0f, 0.01f, 100001.0f);
   const glm::mat4 clip{-1.0f, 0.0f, 0.0f, 0.0f, +0.0f, -1.0f, 0.0f, 0.0f, +0.0f, 0.0f, 0.5f, 0.0f, +0.0f, 0.0f, 0.5f, 1.0f};
 
   projection = clip * projection;
 
-  for (const auto &opoint : observations_) {
-    auto opos = opoint.position;
+  std::array<glm::mat4, 6> result;
+  result[0] = projection * glm::lookAt(opos, opos + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+  result[1] = projection * glm::lookAt(opos, opos + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+  result[2] = projection * glm::lookAt(opos, opos + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+  result[3] = projection * glm::lookAt(opos, opos + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+  result[4] = projection * glm::lookAt(opos, opos + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(-1.0f, 0.0f, 0.0f));
+  result[5] = projection * glm::lookAt(opos, opos + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+  return result;
+}
 
-    SceneShaderData sd;
+void Render::invalidate_command_chunks()
+{
+  for (auto &chunk : command_chunks_) {
+    chunk.recorded_level = -1;
+  }
+}
+
+void Render::create_observations_ubo()
+{
+  // the buffers of the views are recreated, recorded commands may reference the old ones
+  invalidate_command_chunks();
+
+  // observation point
+  std::vector<ViewShaderData> shader_data;
+
+  // impostor anchors are views behind the observations
+  std::vector<Observation> views(observations_);
+  for (const auto &impostor : impostors_) {
+    Observation anchor;
+    anchor.position       = impostor.anchor;
+    anchor.view_direction = glm::vec3(1.0f, 0.0f, 0.0f);
+    anchor.field_of_view  = 360.0f;
+    views.push_back(anchor);
+  }
 
-    sd.position = glm::vec4(opos, 1.0f);
+  face_masks_.clear();
+  size_t rendered_faces = 0;
+  for (size_t v = 0; v < views.size(); v++) {
+    const auto &opoint = views[v];
 
-    sd.projection_view_matrix[0] = projection * glm::lookAt(opos, opos + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    sd.projection_view_matrix[1] = projection * glm::lookAt(opos, opos + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    sd.projection_view_matrix[2] = projection * glm::lookAt(opos, opos + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    sd.projection_view_matrix[3] = projection * glm::lookAt(opos, opos + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    sd.projection_view_matrix[4] = projection * glm::lookAt(opos, opos + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(-1.0f, 0.0f, 0.0f));
-    sd.projection_view_matrix[5] = projection * glm::lookAt(opos, opos + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    ViewShaderData sd;
+
+    sd.position = opoint.position;
 
     sd.view_direction = opoint.view_direction;
     sd.field_of_view = opoint.field_of_view;
 
+    // impostors are baked for all directions
+    sd.face_mask = v < observations_.size() ? compute_face_mask(opoint) : 0x3f;
+    if (v < observations_.size()) {
+      face_masks_.push_back(sd.face_mask);
+      for (size_t f = 0; f < 6; f++) {
+        rendered_faces += (sd.face_mask >> f) & 1;
+      }
+    }
+
     shader_data.push_back(sd);
   }
 
+  if (!observations_.empty()) {
+    logger_->info("Rendering {:.2f} cube faces per observation", static_cast<float>(rendered_faces) / static_cast<float>(observations_.size()));
+  }
+
+  // all views are bound at once and selected by the view index of the push constants
+  auto device{device_ptr_.lock()};
+  const VkDeviceSize view_bytes = shader_data.size() * sizeof(shader_data[0]);
+  if (view_bytes > device->get_physical_device_properties().limits.maxStorageBufferRange) {
+    throw std::runtime_error("The GPU cannot bind the data of " + std::to_string(shader_data.size()) + " views");
+  }
+
+  // the face matrices only depend on the direction, the shaders subtract the view position
+  FaceShaderData face_data;
+  face_data.face_projection_matrix = get_cube_view_projection(glm::vec3(0.0f));
+  face_data.view_index             = 0;
+
   auto allocator{Anvil::MemoryAllocator::create_oneshot(device_ptr_)};
 
-  view_mat_ubo_ = Anvil::Buffer::create_nonsparse(device_ptr_, shader_data.size() * sizeof(shader_data[0]), Anvil::QUEUE_FAMILY_GRAPHICS_BIT,
-                                                  VK_SHARING_MODE_EXCLUSIVE, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+  face_mat_ubo_ = Anvil::Buffer::create_nonsparse(device_ptr_, sizeof(face_data), Anvil::QUEUE_FAMILY_GRAPHICS_BIT, VK_SHARING_MODE_EXCLUSIVE,
+                                                  VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  view_ssbo_    = Anvil::Buffer::create_nonsparse(device_ptr_, view_bytes, Anvil::QUEUE_FAMILY_GRAPHICS_BIT, VK_SHARING_MODE_EXCLUSIVE,
+                                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 
-  allocator->add_buffer(view_mat_ubo_, 0);
+  allocator->add_buffer(face_mat_ubo_, 0);
+  allocator->add_buffer(view_ssbo_, 0);
 
-  view_mat_ubo_->write(0, /* start_offset */
-                       shader_data.size() * sizeof(shader_data[0]), shader_data.data());
+  face_mat_ubo_->write(0, sizeof(face_data), &face_data);
+  view_ssbo_->write(0, /* start_offset */
+                    view_bytes, shader_data.data());
 }
 
 void Render::create_static_object_buffers()
 {
+  // tiles are uploaded on demand
+  if (streamer_ != nullptr) {
+    streamer_->set_objects(scene_objects_);
+    return;
+  }
+
+  VkDeviceSize geometry_bytes = 0;
   for (auto &obj : scene_objects_) {
     obj->prepare_for_draw(device_ptr_);
+    geometry_bytes += obj->get_geometry()->get_gpu_byte_size();
   }
+
+  logger_->info("Uploaded {} scene objects with {} kB of geometry", scene_objects_.size(), geometry_bytes / 1024);
 }
 
-void Render::draw_static_objects()
+void Render::create_impostor_anchors()
 {
-  auto device{device_ptr_.lock()};
-  auto command_pool{device->get_command_pool(Anvil::QUEUE_FAMILY_TYPE_UNIVERSAL)};
-  auto queue = device->get_universal_queue(0);
+  impostors_.clear();
+  observation_impostor_.clear();
+
+  if (impostor_radius_ <= 0.0f) return;
+
+  // mean of the observations per grid cell
+  std::map<std::tuple<int64_t, int64_t, int64_t>, size_t> cells;
+  std::vector<size_t> counts;
+  for (const auto &obs : observations_) {
+    const glm::vec3 c = glm::floor(obs.position / impostor_spacing_);
+    const auto key    = std::make_tuple(static_cast<int64_t>(c.x), static_cast<int64_t>(c.y), static_cast<int64_t>(c.z));
+
+    auto it = cells.find(key);
+    if (it == cells.end()) {
+      it = cells.emplace(key, impostors_.size()).first;
+      impostors_.push_back(Impostor{});
+      impostors_.back().anchor = glm::vec3(0);
+      counts.push_back(0);
+    }
+
+    impostors_[it->second].anchor += obs.position;
+    counts[it->second]++;
+    observation_impostor_.push_back(it->second);
+  }
 
-  auto command_buffer{command_pool->alloc_primary_level_command_buffer()};
+  for (size_t i = 0; i < impostors_.size(); i++) {
+    impostors_[i].anchor /= static_cast<float>(counts[i]);
+  }
+
+  logger_->info("Created {} impostor anchors for {} observations, {} MB of impostor cubes", impostors_.size(), observations_.size(),
+                impostors_.size() * 6 * render_size_.x * render_size_.y * get_target_texel_size(target_layout_) / (1024 * 1024));
+}
+
+void Render::bake_impostors()
+{
+  size_t far_count = 0;
+
+  for (size_t i = 0; i < impostors_.size(); i++) {
+    auto &impostor = impostors_[i];
+
+    // objects completely outside of the radius are far field
+    impostor.far_objects.resize(scene_objects_.size());
+    impostor.near_objects.resize(scene_objects_.size());
+    for (size_t o = 0; o < scene_objects_.size(); o++) {
+      const auto &obj = scene_objects_[o];
+      const bool far  = glm::distance(impostor.anchor, obj->get_world_bounds_center()) - obj->get_world_bounds_radius() > impostor_radius_;
+
+      impostor.far_objects[o]  = far;
+      impostor.near_objects[o] = !far;
+      far_count += far ? 1 : 0;
+    }
+
+    const size_t view_idx = observations_.size() + i;
+    draw_static_objects(view_idx, impostor.anchor, get_view_objects(impostor.anchor, &impostor.far_objects, false), -1, 0);
+
+    if (impostor.cube == nullptr) {
+      impostor.cube = std::make_shared<CubeImages>(device_ptr_, render_size_, CubeImages::USAGE_COLOR_TEXTURE, 6, VK_SAMPLE_COUNT_1_BIT,
+                                                   cube_images_color_->get_image_format());
+    }
+    impostor.cube->copy_from(cube_images_color_);
+  }
+
+  if (!impostors_.empty()) {
+    logger_->info("Baked impostors, {:.1f} far field objects per anchor", static_cast<float>(far_count) / static_cast<float>(impostors_.size()));
+  }
+}
+
+void Render::draw_static_objects(size_t view_idx, const glm::vec3 &eye, const std::vector<bool> *object_mask, int impostor_idx, uint32_t level)
+{
+  // the command buffers and the view index are reused once the previous draw is done
+  wait_for_draw();
+
+  size_t culled_meshlets    = 0;
+  const auto size           = get_level_size(level);
+  const uint32_t view_index = static_cast<uint32_t>(view_idx);  // selects the view data in the shaders
+
+  // the smallest texel of a cube face (in its corner) covers 2/width * sqrt(2)/3 radians, of the octahedral map (in the center of an octahedron
+  // face) 2/width * 3^(-3/4) radians
+  const float texel_angle = projection_ == Projection::CUBE ? glm::sqrt(2.0f) / 3.0f : glm::pow(3.0f, -0.75f);
+  const float lod_angle = lod_tolerance_ * 2.0f / static_cast<float>(size.x) * texel_angle;
+
+  // the objects are recorded in parallel, one thread per worker. Without masks or view dependent objects the commands only depend on the
+  // level and are reused for all views
+  const bool reusable = object_mask == nullptr && !view_dependent_objects_;
+  std::vector<std::vector<CommandChunk *>> work(command_pools_.size() - 1);
+  for (auto &chunk : command_chunks_) {
+    if (!reusable || chunk.recorded_level != static_cast<int>(level)) work[chunk.worker].push_back(&chunk);
+  }
+
+  std::vector<std::future<size_t>> recordings;
+  for (auto &chunks : work) {
+    if (chunks.empty()) continue;
+    recordings.push_back(std::async(std::launch::async, [&, chunks]() {
+      size_t culled = 0;
+      for (auto chunk : chunks) {
+        culled += record_command_chunk(*chunk, eye, object_mask, lod_angle, level);
+        chunk->recorded_level = reusable ? static_cast<int>(level) : -1;
+      }
+      return culled;
+    }));
+  }
+
+  // far field background, its depth is at the far plane
+  if (impostor_idx >= 0) {
+    const auto &impostor = impostors_[impostor_idx];
+    auto pipeline_layout = gfx_pipeline_manager_ptr_->get_graphics_pipeline_layout(impostor_cache_.pipeline);
+
+    impostor_commands_->start_recording(false, false, true, /* in_renderpass_usage_only */
+                                        nullptr, impostor_cache_.render_pass, impostor_cache_.subpass,
+                                        Anvil::OCCLUSION_QUERY_SUPPORT_SCOPE_NOT_REQUIRED, false, 0);
+    record_viewports(impostor_commands_, level);
+    impostor_commands_->record_bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 1, 1, &view_set_, 0, nullptr);
+    impostor_commands_->record_bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, impostor_cache_.pipeline);
+
+    impostor_material_->set_impostor(impostor.cube);
+    impostor_material_->set_material_properties(device_ptr_, impostor_commands_, pipeline_layout);
+
+    SceneObject::ObjectShaderData background{};
+    background.model_matrix = glm::translate(glm::mat4(1), eye);
+    background.object_data  = glm::vec4(impostor.anchor, 1.0f);
+    impostor_commands_->record_push_constants(pipeline_layout, VK_SHADER_STAGE_ALL_GRAPHICS, 0, sizeof(background), &background);
+    impostor_geometry_->draw(device_ptr_, impostor_commands_);
+    impostor_commands_->stop_recording();
+  }
+
+  for (auto &recording : recordings) {
+    culled_meshlets += recording.get();
+  }
+
+  // the command buffer of the target was allocated with it, its previous draw is done
+  auto queue          = queues_.graphics;
+  auto command_buffer = draw_commands_[target_idx_];
 
   // todo remove!
   // vkDeviceWaitIdle(device->get_device_vk());
@@ -347,9 +1084,15 @@ void Render::draw_static_objects()
 
   cube_images_color_->prepare_for_render(command_buffer, queue);
 
+  // the view of this draw, the previous draw has finished reading it
+  command_buffer->record_update_buffer(face_mat_ubo_, sizeof(FaceShaderData::face_projection_matrix), sizeof(view_index), &view_index);
+  const Anvil::MemoryBarrier barrier(VK_ACCESS_UNIFORM_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+  command_buffer->record_pipeline_barrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT, VK_FALSE, 1, &barrier, 0, nullptr, 0,
+                                          nullptr);
+
   VkRect2D render_area;
-  render_area.extent.height = render_size_.x;
-  render_area.extent.width  = render_size_.y;
+  render_area.extent.height = size.y;
+  render_area.extent.width  = size.x;
   render_area.offset.x      = 0;
   render_area.offset.y      = 0;
 
@@ -366,36 +1109,35 @@ void Render::draw_static_objects()
 
   command_buffer->record_begin_render_pass(static_cast<uint32_t>(cv.size()), /* in_n_clear_values */
                                            cv.data(), framebuffer_, render_area, material_cache.begin()->second.render_pass,
-                                           VK_SUBPASS_CONTENTS_INLINE);
-
-  // set_material_properties_world(command_buffer);
-
-  for (const auto &it : material_cache) {
-    const auto &pipeline = it.second;
-    auto pipeline_layout = gfx_pipeline_manager_ptr_->get_graphics_pipeline_layout(pipeline.pipeline);
-
-    command_buffer->record_bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 1, 1, &view_set_, 0, nullptr);
-
-    command_buffer->record_bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+                                           VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-    //
-    for (const auto &obj : pipeline.objects) {
-      const auto &material = obj->get_material();
-
-      assert(material->get_name() == it.first);  // make sure there was no material obj mess up
-      material->set_material_properties(device_ptr_, command_buffer, pipeline_layout);
-
-      // object properties (model matrix)
-      command_buffer->record_push_constants(pipeline_layout, VK_SHADER_STAGE_ALL_GRAPHICS, 0, sizeof(obj->get_shader_data()),
-                                            &obj->get_shader_data());
-      obj->draw(device_ptr_, command_buffer);
-    }
+  std::vector<std::shared_ptr<Anvil::SecondaryCommandBuffer>> commands;
+  for (const auto &chunk : command_chunks_) {
+    commands.push_back(chunk.commands);
+  }
+  if (impostor_idx >= 0) commands.push_back(impostor_commands_);
+  if (!commands.empty()) {
+    command_buffer->record_execute_commands(static_cast<uint32_t>(commands.size()), commands.data());
   }
 
   command_buffer->record_end_render_pass();
   command_buffer->stop_recording();
 
-  queue->submit_command_buffer(command_buffer, true, nullptr);
+  // the draw runs while the previous view is computed. Other queues wait for the semaphore before reading the target, the same queue is ordered
+  if (queues_.is_shared()) {
+    // the semaphore of the target is signalled again if its last signal was waited for, otherwise it is replaced
+    auto &semaphore = draw_semaphores_[target_idx_];
+    if (semaphore == nullptr || cube_images_color_->has_write_semaphore()) {
+      semaphore = Anvil::Semaphore::create(device_ptr_);
+    }
+    queue->submit_command_buffer_with_signal_semaphores(command_buffer, 1, &semaphore, false, draw_fence_);
+    cube_images_color_->set_write_semaphore(semaphore);
+  } else {
+    queue->submit_command_buffer(command_buffer, false, draw_fence_);
+  }
+  pending_draw_ = command_buffer;
+
+  logger_->trace("View {}: {} back facing meshlets culled", view_idx, culled_meshlets);
 
   // vkDeviceWaitIdle(device->get_device_vk());
 }
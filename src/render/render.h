@@ -4,6 +4,8 @@
 #include <array>
 #include <future>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include <wrappers/device.h>
 #include <glm/glm.hpp>
@@ -11,8 +13,15 @@
 #include "../logger.h"
 #include "./anvil.h"
 #include "./cube_images.h"
+#include "./device_queues.h"
+#include "./materials/material_impostor.h"
 #include "./observation.h"
+#include "./portal_culling.h"
+#include "./projection.h"
+#include "./reduction_pyramid.h"
 #include "./scene_object.h"
+#include "./target_layout.h"
+#include "./tile_streamer.h"
 
 namespace quavis {
 
@@ -21,8 +30,61 @@ namespace quavis {
 class Render : UseLogger {
  public:
   /// creates a renderer that randers each cube map size with the given resolution (x=width, y=height). It creates the inits the vulkan device with
-  /// number (vulkan_device_idx).
-  Render(const glm::ivec2 &render_dim, uint32_t vulkan_device_idx = 0);
+  /// number (vulkan_device_idx). With the octahedral projection the whole sphere is rendered in one pass into a single layer of render_dim.
+  Render(const glm::ivec2 &render_dim, uint32_t vulkan_device_idx = 0, Projection projection = Projection::CUBE);
+  ~Render();
+
+  /// level of detail tolerance in texels of the cube map, 0 always draws the full detail
+  void set_lod_tolerance(float texels) { lod_tolerance_ = texels; }
+
+  /// far field impostors: geometry further than radius from an anchor is baked once into an impostor cube and drawn as background for all
+  /// observations of the anchor. Anchors are the mean of the observations in a grid cell of size spacing. A radius of 0 disables impostors
+  void set_impostors(float radius, float spacing);
+
+  /// streams the scene in tiles of tile_size, tiles closer than radius to the observation point and the tiles of the near field of its impostor
+  /// are on the GPU. Old tiles are released when more than budget bytes of geometry are uploaded. Needs impostors for the far field, which would
+  /// otherwise be drawn from all tiles. A tile_size of 0 uploads everything at once
+  void set_streaming(float tile_size, float radius, VkDeviceSize budget);
+
+  /// the order in which the observations should be drawn, along a space filling curve of the tiles when streaming
+  std::vector<size_t> get_observation_order() const;
+
+  /// draws only the objects of cells visible through portals from the observation point, nullptr draws everything
+  void set_portal_culling(std::shared_ptr<PortalCulling> portal_culling) { portal_culling_ = portal_culling; }
+
+  /// the direction domains of all computations, faces of the cube outside of their union are skipped. Empty renders the full sphere
+  void set_direction_domains(const std::vector<DirectionDomain> &domains);
+
+  /// resolution of each cube face (in layer order +x, -x, +y, -y, +z, -z), each at most the render size. A face is rendered into the top left
+  /// corner of its layer, so faces whose content matters less can be rendered coarser
+  void set_face_sizes(const std::array<glm::ivec2, 6> &face_sizes);
+  const std::array<glm::ivec2, 6> &get_face_sizes() const { return face_sizes_; }
+  /// true if any face has a resolution other than the render size
+  bool has_face_sizes() const;
+
+  /// samples per texel, a power of two. With more than one sample the compute stages resolve the fractional coverage of each texel, so edges are
+  /// as accurate as with a higher resolution. Not available with impostors, throws if the GPU cannot store images with that many samples
+  void set_samples(uint32_t samples);
+  uint32_t get_samples() const { return samples_; }
+
+  /// the channels stored in the color render target, the smallest layout with the channels all compute stages read. RED_DISTANCE falls back
+  /// to COLOR_DISTANCE on GPUs that cannot bind 2 channel storage images
+  void set_target_layout(TargetLayout layout);
+  TargetLayout get_target_layout() const { return target_layout_; }
+
+  /// reduces every drawn view into levels coarser images (see ReductionPyramid), so compute stages can read the render size divided by 2^l.
+  /// Not available with face sizes, throws if the render size is not divisible by 2^levels
+  void set_reduction_levels(uint32_t levels);
+  uint32_t get_reduction_levels() const { return reduction_levels_; }
+  /// the image of reduction level level of the last drawn view, level 0 is the color render target
+  std::shared_ptr<CubeImages> get_reduced_image(uint32_t level) const;
+
+  /// preprocessor definitions describing the render target layout for shaders that read it (projection, face sizes, samples and channels), or
+  /// the layout of reduction level reduction_level
+  std::vector<std::string> get_shader_defines(uint32_t reduction_level = 0) const;
+
+  /// the faces (bit i for layer i) rendered for observation observation_idx
+  uint32_t get_face_mask(size_t observation_idx) const { return face_masks_[observation_idx]; }
 
   /// adds a new scene object to the world.
   void add_static_scene_object(std::shared_ptr<SceneObject> sceneObject);
@@ -34,20 +96,33 @@ class Render : UseLogger {
   /// the depth and stencil buffer
   std::shared_ptr<CubeImages> get_depth_cube();
 
-  /// draws the scene from the observation point observation_idx
-  std::shared_ptr<CubeImages> draw(size_t observation_idx);
+  /// draws the scene from the observation point observation_idx. Resolution level l > 0 draws get_level_size(l) texels into the top left corner of
+  /// each layer, for a quick coarse result. The draw is submitted to the graphics queue without waiting for it, reading the returned target on
+  /// another queue waits for it (see CubeImages::submit_after_writes)
+  std::shared_ptr<CubeImages> draw(size_t observation_idx, uint32_t level = 0);
+
+  /// true if the compute stages run on their own queue. Two color targets then alternate, so the next view can be drawn while the returned
+  /// target of the previous one is still computed (not its reduction levels, which are rebuilt by each draw)
+  bool has_async_compute() const { return queues_.has_async_compute(); }
+
+  /// the render size divided by 2^level
+  glm::ivec2 get_level_size(uint32_t level) const;
 
   /// returns the used vulkan device
   std::weak_ptr<Anvil::SGPUDevice> get_device() { return device_ptr_; }
 
   const glm::vec2 get_render_size() const { return render_size_; }
+  Projection get_projection() const { return projection_; }
   /// number of observations
   const size_t observations_size() const { return observations_.size(); }
+  /// the static scene objects, in the order they were added
+  const std::vector<std::shared_ptr<SceneObject>> &get_scene_objects() const { return scene_objects_; }
 
  private:
   /// Holds all the information needed for one kind of material (all material instances share the same pipeline)
   struct MaterialCache {
     std::vector<std::shared_ptr<SceneObject>> objects;
+    std::vector<size_t> object_indices;  ///< index of the objects in scene_objects_
     Anvil::PipelineID pipeline;
     Anvil::SubPassID subpass;
     std::shared_ptr<Anvil::RenderPass> render_pass;
@@ -59,11 +134,27 @@ class Render : UseLogger {
     std::shared_ptr<Anvil::ShaderModuleStageEntryPoint> shader_vertex;
 
     std::shared_ptr<Anvil::DescriptorSetGroup> descriptor_group;
+    std::shared_ptr<Anvil::DescriptorSet> material_set;  ///< the material textures of the shared pipeline, nullptr if it has none
+    bool own_pipeline{false};  ///< the materials have a pipeline of their own and set their properties for each object
+  };
+
+  /// a range of the objects of one material, recorded into a secondary command buffer. The view index is read from a uniform, so the commands
+  /// of view independent draws are recorded once and executed for all views
+  struct CommandChunk {
+    const MaterialCache *cache;
+    size_t first;  ///< object range of the material
+    size_t last;
+    size_t worker;  ///< recording thread, the command buffer is allocated from its pool
+    std::shared_ptr<Anvil::SecondaryCommandBuffer> commands;
+    int recorded_level{-1};  ///< resolution level the commands can be reused for, -1 if they depend on the view
   };
 
   void init_vulkan(uint32_t vulkan_device_idx);
+  /// waits until the submitted draw is done, its command buffers and the view index can then be changed
+  void wait_for_draw();
 
   void create_images();
+  void create_reduction_pyramid();
   void create_framebuffer();
   void create_render_pass();
   void create_base_pipeline();
@@ -71,58 +162,135 @@ class Render : UseLogger {
   void create_world_ubo();
 
   void create_material_pipelines();
-  MaterialCache create_pipeline_for_material(std::shared_ptr<MaterialBase> material);
+  /// collects the textures of the materials drawn by the shared pipelines and sets the material index of each object
+  void create_material_textures();
+  MaterialCache create_pipeline_for_material(std::shared_ptr<MaterialBase> material, std::shared_ptr<DrawableGeometry> geometry);
 
   void create_static_object_buffers();
-  void draw_static_objects();
+  /// draws the objects (all if object_mask is nullptr) seen from view view_idx at eye with the background of impostor_idx (none if negative) at
+  /// resolution level
+  void draw_static_objects(size_t view_idx, const glm::vec3 &eye, const std::vector<bool> *object_mask, int impostor_idx, uint32_t level);
+  /// splits the objects of each material into chunks recorded in parallel into their own secondary command buffers
+  void create_command_chunks();
+  /// records the draws of the objects of chunk (all if object_mask is nullptr) seen from eye, returns the number of culled meshlets
+  size_t record_command_chunk(CommandChunk &chunk, const glm::vec3 &eye, const std::vector<bool> *object_mask, float lod_angle, uint32_t level);
+  /// sets the viewports and scissors of resolution level
+  void record_viewports(std::shared_ptr<Anvil::CommandBufferBase> command_buffer, uint32_t level) const;
+  /// combines object_mask (nullptr for all objects) with the cells visible through portals, and uploads the tiles of the result when streaming
+  const std::vector<bool> *get_view_objects(const glm::vec3 &eye, const std::vector<bool> *object_mask, bool use_portals);
+
+  /// view projection matrices of the 6 cube faces seen from eye
+  std::array<glm::mat4, 6> get_cube_view_projection(const glm::vec3 &eye) const;
+  /// the faces of the cube needed by the union of the direction domains at observation
+  uint32_t compute_face_mask(const Observation &observation) const;
+  /// points the view descriptors to the face matrices and the view data of all views, once after the pipelines or the views changed
+  void bind_views();
+
+  /// places the impostor anchors and assigns the observations to them
+  void create_impostor_anchors();
+  /// splits the objects into near and far field for each anchor and renders the far field into the impostor cubes
+  void bake_impostors();
 
   // void create_descriptors();
 
   void add_descriptor_layouts(std::shared_ptr<Anvil::GraphicsPipelineManager> gfx_pipeline_manager_ptr_, MaterialCache &pipeline,
                               std::shared_ptr<MaterialBase> material);
   void create_observations_ubo();
-  std::shared_ptr<Anvil::Buffer> view_mat_ubo_;
+  /// the command chunks are recorded again by the next draw
+  void invalidate_command_chunks();
+  std::shared_ptr<Anvil::Buffer> face_mat_ubo_;  ///< FaceShaderData
+  std::shared_ptr<Anvil::Buffer> view_ssbo_;     ///< ViewShaderData of all views, observations followed by impostor anchors
   std::shared_ptr<Anvil::DescriptorSet> view_set_;
   std::vector<Observation> observations_;
 
  private:
-  /// the data availble to the shader for each observation point
-  struct SceneShaderData_data {
-    std::array<glm::mat4, 6> projection_view_matrix;
-    glm::vec4 position;
-    glm::vec3 view_direction;
-    float field_of_view;
+  /// the projections of the cube faces, relative to the view position and shared by all views, and the index of the drawn view. The index is
+  /// updated by the primary command buffer of each draw, secondary command buffers do not inherit push constants
+  struct FaceShaderData {
+    std::array<glm::mat4, 6> face_projection_matrix;
+    uint32_t view_index;
   };
 
-  /// create a data structure that is large enough to support the min offset of the device (minUniformBufferOffsetAlignment). \todo get from actual
-  /// device
-  template <class T, size_t padding>
-  struct DataPadding : public T {
-   public:
-    static constexpr size_t get_padding_size() { return (padding - (sizeof(T) % padding)) % padding; }
-
-   private:
-    std::array<uint8_t, DataPadding::get_padding_size()> padding_;
+  /// the data availble to the shader for each view (std430 layout), drawn views are selected by index so it is bound once for all
+  struct ViewShaderData {
+    glm::vec3 position;
+    uint32_t face_mask;  ///< layers that are rendered
+    glm::vec3 view_direction;
+    float field_of_view;
   };
-
-  typedef DataPadding<SceneShaderData_data, 256> SceneShaderData;
+  static_assert(sizeof(ViewShaderData) == 32, "ViewShaderData must match the std430 layout of the shaders");
 
   // member values
   glm::ivec2 render_size_;
+  Projection projection_;
+  std::array<glm::ivec2, 6> face_sizes_;
+  uint32_t samples_{1};
+  TargetLayout target_layout_{TargetLayout::COLOR_DISTANCE};
+  uint32_t reduction_levels_{0};
+  float lod_tolerance_{0.0f};
+
+  std::vector<DirectionDomain> direction_domains_;
+  std::vector<uint32_t> face_masks_;  ///< per observation
 
   bool dirty_scene_{true};
   bool dirty_observations_{true};
+  bool dirty_impostors_{true};
+
+  /// far field baked at an anchor point
+  struct Impostor {
+    glm::vec3 anchor;
+    std::vector<bool> far_objects;  ///< per scene object, true if the object is baked into the cube
+    std::vector<bool> near_objects;
+    std::shared_ptr<CubeImages> cube;
+  };
+
+  float impostor_radius_{0.0f};
+  float impostor_spacing_{0.0f};
+  std::vector<Impostor> impostors_;
+  std::vector<size_t> observation_impostor_;  ///< impostor index of each observation
+  std::shared_ptr<MaterialImpostor> impostor_material_;
+  std::shared_ptr<DrawableGeometry> impostor_geometry_;
+  MaterialCache impostor_cache_;
+
+  std::shared_ptr<TileStreamer> streamer_;
+  std::shared_ptr<PortalCulling> portal_culling_;
+  /// mask of the objects drawn for one view, combination of impostor and streaming masks
+  std::vector<bool> view_objects_;
 
   std::vector<std::shared_ptr<SceneObject>> scene_objects_;
   // rendering
-  std::shared_ptr<CubeImages> cube_images_color_;
+  DeviceQueues queues_;
+  /// the color targets and their framebuffers, two with async compute so one is drawn while the other is computed
+  std::vector<std::shared_ptr<CubeImages>> color_targets_;
+  std::vector<std::shared_ptr<Anvil::Framebuffer>> framebuffers_;
+  size_t target_idx_{0};
+  /// the primary command buffers and the semaphores signalled by their draws, one per color target. Allocated with the targets and recorded again
+  /// for each draw
+  std::vector<std::shared_ptr<Anvil::PrimaryCommandBuffer>> draw_commands_;
+  std::vector<std::shared_ptr<Anvil::Semaphore>> draw_semaphores_;
+  /// the submitted draw, kept until its fence is signalled
+  std::shared_ptr<Anvil::PrimaryCommandBuffer> pending_draw_;
+  std::shared_ptr<Anvil::Fence> draw_fence_;
+
+  std::shared_ptr<CubeImages> cube_images_color_;  ///< the current color target
   std::shared_ptr<CubeImages> cube_images_depth_;
+  std::shared_ptr<ReductionPyramid> reduction_pyramid_;
+
+  /// one command pool per recording thread, the last one records the impostor background on the calling thread
+  std::vector<std::shared_ptr<Anvil::CommandPool>> command_pools_;
+  std::vector<CommandChunk> command_chunks_;
+  std::shared_ptr<Anvil::SecondaryCommandBuffer> impostor_commands_;
+  bool view_dependent_objects_{false};  ///< true if some object is drawn differently depending on the eye
 
-  std::shared_ptr<Anvil::Framebuffer> framebuffer_;
+  std::shared_ptr<Anvil::Framebuffer> framebuffer_;  ///< the framebuffer of the current color target
   Anvil::FramebufferAttachmentID framebuffer_color_attachment_id_;
 
   // helper structures, need to be recomputed when dirty
+  /// one pipeline for each vertex layout shared by all materials without a pipeline of their own, and one for each other material name and layout
   std::map<std::string, MaterialCache> material_cache;
+  /// the distinct textures of the materials drawn by the shared pipelines, the material index of an object is its index plus one
+  std::vector<std::shared_ptr<CubeImages>> material_textures_;
+  std::shared_ptr<Anvil::Sampler> material_sampler_;
 
   // Vulkan stuff
   std::weak_ptr<Anvil::SGPUDevice> device_ptr_;
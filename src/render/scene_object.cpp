@@ -3,10 +3,14 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 
-quavis::SceneObject::SceneObject(std::shared_ptr<DrawableGeometry> geometry, std::shared_ptr<MaterialBase> material, const glm::mat4 &mx)
+quavis::SceneObject::SceneObject(std::shared_ptr<DrawableGeometry> geometry, std::shared_ptr<MaterialBase> material, const glm::mat4 &mx,
+                                  const glm::vec4 &object_data, bool closed_solid)
   : material_{material}
   , geometry_{geometry}
-  , shader_data_{mx}
+  , model_matrix_{mx}
+  , inverse_model_matrix_{glm::inverse(mx)}
+  , closed_solid_{closed_solid}
+  , shader_data_{mx, object_data}
 {
 }
 
@@ -14,12 +18,36 @@ void quavis::SceneObject::prepare_for_draw(std::weak_ptr<Anvil::SGPUDevice> devi
 {
   geometry_->prepare_for_draw(device_pt);
   material_->prepare_for_draw(device_pt);
+
+  // quantized positions are mapped back to object space by the model matrix
+  shader_data_.model_matrix = model_matrix_ * geometry_->get_dequantization_matrix();
+}
+
+void quavis::SceneObject::release_gpu()
+{
+  geometry_->release_gpu();
 }
 
-void quavis::SceneObject::draw(std::weak_ptr<Anvil::SGPUDevice> device_ptr, std::shared_ptr<Anvil::PrimaryCommandBuffer> command_buffer)
+size_t quavis::SceneObject::draw(const std::weak_ptr<Anvil::SGPUDevice> &device_ptr,
+                                 const std::shared_ptr<Anvil::CommandBufferBase> &command_buffer, const glm::vec3 &eye, float lod_angle)
 {
   material_->use(device_ptr, command_buffer);
-  geometry_->draw(device_ptr, command_buffer);
+
+  // meshlet and level of detail bounds are in object space (before dequantization), the angles are exact for uniform scaling
+  const glm::vec3 object_eye = glm::vec3(inverse_model_matrix_ * glm::vec4(eye, 1.0f));
+
+  const size_t lod = geometry_->select_lod(glm::distance(object_eye, geometry_->get_bounds_center()), lod_angle);
+  if (!closed_solid_ || lod > 0) {
+    geometry_->draw(device_ptr, command_buffer, lod);
+    return 0;
+  }
+
+  return geometry_->draw_culled(device_ptr, command_buffer, object_eye);
+}
+
+bool quavis::SceneObject::is_view_dependent() const
+{
+  return (closed_solid_ && !geometry_->get_meshlets().empty()) || geometry_->get_lod_levels().size() > 1;
 }
 
 std::shared_ptr<quavis::MaterialBase> quavis::SceneObject::get_material() const
@@ -36,3 +64,15 @@ const quavis::SceneObject::ObjectShaderData &quavis::SceneObject::get_shader_dat
 {
   return shader_data_;
 }
+
+glm::vec3 quavis::SceneObject::get_world_bounds_center() const
+{
+  return glm::vec3(model_matrix_ * glm::vec4(geometry_->get_bounds_center(), 1.0f));
+}
+
+float quavis::SceneObject::get_world_bounds_radius() const
+{
+  const float scale =
+    glm::max(glm::length(glm::vec3(model_matrix_[0])), glm::max(glm::length(glm::vec3(model_matrix_[1])), glm::length(glm::vec3(model_matrix_[2]))));
+  return geometry_->get_bounds_radius() * scale;
+}
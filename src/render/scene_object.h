@@ -14,27 +14,55 @@ class SceneObject {
  public:
   struct ObjectShaderData {
     glm::mat4 model_matrix;
+    /// per object attributes (color, group id,...) used by the material if the geometry has no per vertex data
+    glm::vec4 object_data;
+    /// texture of the material in the texture array of the shared pipeline plus one, 0 if the material has no texture
+    uint32_t material_index{0};
   };
 
-  /// Creates a Scene object with one drawable geometry, one material and one model matrix.
-  SceneObject(std::shared_ptr<DrawableGeometry> geometry, std::shared_ptr<MaterialBase> material, const glm::mat4 &model_matrix = glm::mat4(1));
+  /// Creates a Scene object with one drawable geometry, one material, one model matrix and the per object data. A closed solid is a closed mesh
+  /// with counter clockwise triangles seen from outside and no observation inside, meshlets facing away from the observation are culled
+  SceneObject(std::shared_ptr<DrawableGeometry> geometry, std::shared_ptr<MaterialBase> material, const glm::mat4 &model_matrix = glm::mat4(1),
+              const glm::vec4 &object_data = glm::vec4(0), bool closed_solid = false);
 
   /// called only ones before any draw happens. Use it to init GPU data structures (VBO, textures,...)
   void prepare_for_draw(std::weak_ptr<Anvil::SGPUDevice> device_pt);
 
-  /// draws that scene object
-  void draw(std::weak_ptr<Anvil::SGPUDevice> device_ptr, std::shared_ptr<Anvil::PrimaryCommandBuffer> command_buffer);
+  /// frees the GPU data of the geometry, prepare_for_draw uploads it again
+  void release_gpu();
+
+  /// draws that scene object seen from eye (world space) with the coarsest level of detail that has an error below lod_angle (radians), returns
+  /// the number of culled meshlets
+  size_t draw(const std::weak_ptr<Anvil::SGPUDevice> &device_ptr, const std::shared_ptr<Anvil::CommandBufferBase> &command_buffer,
+              const glm::vec3 &eye, float lod_angle);
+
+  /// true if draw records different commands depending on the eye (meshlet culling or levels of detail)
+  bool is_view_dependent() const;
 
   std::shared_ptr<MaterialBase> get_material() const;
   std::shared_ptr<DrawableGeometry> get_geometry() const;
 
-  /// returns the ShaderData (model matrix) that should be pushed by the renderer.
+  /// returns the ShaderData (model matrix, object data) that should be pushed by the renderer.
   const ObjectShaderData &get_shader_data() const;
 
+  /// sets the texture of the material drawn by the shared pipeline (index into its texture array plus one, 0 for none)
+  void set_material_index(uint32_t material_index) { shader_data_.material_index = material_index; }
+
+  /// bounding sphere of the geometry in world space (radius scaled by the largest axis scale), valid after prepare_for_draw
+  glm::vec3 get_world_bounds_center() const;
+  float get_world_bounds_radius() const;
+
+  /// the model matrix as given, without the dequantization of the geometry
+  const glm::mat4 &get_model_matrix() const { return model_matrix_; }
+
  private:
   std::shared_ptr<DrawableGeometry> geometry_;
   std::shared_ptr<MaterialBase> material_;
 
+  glm::mat4 model_matrix_;
+  glm::mat4 inverse_model_matrix_;
+  bool closed_solid_;
+
   ObjectShaderData shader_data_;
 };
 }  // namespace quavis
@@ -0,0 +1,58 @@
+#ifndef QUAVIS_RENDER_TARGET_LAYOUT
+#define QUAVIS_RENDER_TARGET_LAYOUT
+
+#include <string>
+#include <vector>
+
+#include "./anvil.h"
+
+namespace quavis {
+/// the channels of the color render target, only the channels read by the compute stages are rendered and stored. Ordered by size, so the
+/// layout serving several stages is the largest of theirs
+enum class TargetLayout {
+  DISTANCE,       ///< 4 bytes per texel, the distance to the observation point
+  RED_DISTANCE,   ///< 8 bytes per texel, the red channel of the color (e.g. a group index) and the distance
+  COLOR_DISTANCE  ///< 16 bytes per texel, the color and the distance
+};
+
+/// format of the color render target
+inline VkFormat get_target_format(TargetLayout layout)
+{
+  switch (layout) {
+    case TargetLayout::DISTANCE:
+      return VK_FORMAT_R32_SFLOAT;
+    case TargetLayout::RED_DISTANCE:
+      return VK_FORMAT_R32G32_SFLOAT;
+    default:
+      return VK_FORMAT_R32G32B32A32_SFLOAT;
+  }
+}
+
+/// bytes per texel of the color render target
+inline uint32_t get_target_texel_size(TargetLayout layout)
+{
+  switch (layout) {
+    case TargetLayout::DISTANCE:
+      return 4;
+    case TargetLayout::RED_DISTANCE:
+      return 8;
+    default:
+      return 16;
+  }
+}
+
+/// preprocessor definitions of the storage image format and of the channel holding the distance, the shaders default to color and distance
+inline std::vector<std::string> get_target_defines(TargetLayout layout)
+{
+  switch (layout) {
+    case TargetLayout::DISTANCE:
+      return {"QUAVIS_TARGET_FORMAT r32f", "QUAVIS_TARGET_DISTANCE r"};
+    case TargetLayout::RED_DISTANCE:
+      return {"QUAVIS_TARGET_FORMAT rg32f", "QUAVIS_TARGET_DISTANCE g"};
+    default:
+      return {};
+  }
+}
+}  // namespace quavis
+
+#endif
@@ -0,0 +1,153 @@
+#include "tile_streamer.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+quavis::TileStreamer::TileStreamer(float tile_size, float radius, VkDeviceSize budget)
+  : tile_size_{tile_size}
+  , radius_{radius}
+  , budget_{budget}
+{
+  assert(tile_size_ > 0.0f);
+}
+
+void quavis::TileStreamer::set_objects(const std::vector<std::shared_ptr<SceneObject>> &objects)
+{
+  for (auto &tile : tiles_) {
+    release(tile);
+  }
+
+  objects_ = objects;
+  tiles_.clear();
+  tile_index_.clear();
+
+  for (size_t i = 0; i < objects_.size(); i++) {
+    const glm::vec3 center = objects_[i]->get_world_bounds_center();
+    const float radius     = objects_[i]->get_world_bounds_radius();
+
+    const auto key = get_key(center);
+    auto it        = tile_index_.find(key);
+    if (it == tile_index_.end()) {
+      it = tile_index_.emplace(key, tiles_.size()).first;
+      Tile tile;
+      tile.min = glm::vec3(std::numeric_limits<float>::max());
+      tile.max = glm::vec3(std::numeric_limits<float>::lowest());
+      tiles_.push_back(tile);
+    }
+
+    auto &tile = tiles_[it->second];
+    tile.objects.push_back(i);
+    tile.min = glm::min(tile.min, center - radius);
+    tile.max = glm::max(tile.max, center + radius);
+  }
+
+  logger_->info("Streaming {} scene objects in {} tiles", objects_.size(), tiles_.size());
+}
+
+std::vector<size_t> quavis::TileStreamer::order_observations(const std::vector<Observation> &observations) const
+{
+  // spreads 21 bits so that there are two zero bits between each
+  auto spread_bits = [](uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | (v << 32)) & 0x1f00000000ffffull;
+    v = (v | (v << 16)) & 0x1f0000ff0000ffull;
+    v = (v | (v << 8)) & 0x100f00f00f00f00full;
+    v = (v | (v << 4)) & 0x10c30c30c30c30c3ull;
+    v = (v | (v << 2)) & 0x1249249249249249ull;
+    return v;
+  };
+
+  // tile coordinates are made positive relative to the smallest tile
+  std::vector<TileKey> keys;
+  TileKey min_key{std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::max()};
+  for (const auto &obs : observations) {
+    keys.push_back(get_key(obs.position));
+    std::get<0>(min_key) = std::min(std::get<0>(min_key), std::get<0>(keys.back()));
+    std::get<1>(min_key) = std::min(std::get<1>(min_key), std::get<1>(keys.back()));
+    std::get<2>(min_key) = std::min(std::get<2>(min_key), std::get<2>(keys.back()));
+  }
+
+  std::vector<uint64_t> codes;
+  for (const auto &key : keys) {
+    codes.push_back(spread_bits(static_cast<uint64_t>(std::get<0>(key) - std::get<0>(min_key))) |
+                    (spread_bits(static_cast<uint64_t>(std::get<1>(key) - std::get<1>(min_key))) << 1) |
+                    (spread_bits(static_cast<uint64_t>(std::get<2>(key) - std::get<2>(min_key))) << 2));
+  }
+
+  std::vector<size_t> order(observations.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return codes[a] < codes[b]; });
+
+  return order;
+}
+
+void quavis::TileStreamer::make_resident(const glm::vec3 &eye, const std::vector<bool> *draw_mask, std::weak_ptr<Anvil::SGPUDevice> device_ptr)
+{
+  use_counter_++;
+
+  size_t beyond_radius = 0;
+  for (auto &tile : tiles_) {
+    // distance to the bounding box of the tile
+    const glm::vec3 nearest = glm::clamp(eye, tile.min, tile.max);
+    const bool near         = glm::distance(nearest, eye) <= radius_;
+    const bool drawn =
+      draw_mask == nullptr || std::any_of(tile.objects.begin(), tile.objects.end(), [&](size_t o) { return (*draw_mask)[o]; });
+    if (!near && !drawn) continue;
+    if (!near) beyond_radius++;
+
+    if (!tile.resident) {
+      tile.bytes = 0;
+      for (auto o : tile.objects) {
+        objects_[o]->prepare_for_draw(device_ptr);
+        tile.bytes += objects_[o]->get_geometry()->get_gpu_byte_size();
+      }
+      tile.resident = true;
+      resident_bytes_ += tile.bytes;
+    }
+
+    tile.last_use = use_counter_;
+  }
+
+  if (beyond_radius > 0 && !warned_beyond_radius_) {
+    logger_->warn("Streaming: {} tiles beyond the radius are drawn and uploaded on demand, use impostors or a larger radius", beyond_radius);
+    warned_beyond_radius_ = true;
+  }
+
+  // release the least recently used tiles that are not needed now
+  if (resident_bytes_ > budget_) {
+    std::vector<size_t> candidates;
+    for (size_t t = 0; t < tiles_.size(); t++) {
+      if (tiles_[t].resident && tiles_[t].last_use != use_counter_) candidates.push_back(t);
+    }
+    std::sort(candidates.begin(), candidates.end(), [&](size_t a, size_t b) { return tiles_[a].last_use < tiles_[b].last_use; });
+
+    for (auto t : candidates) {
+      if (resident_bytes_ <= budget_) break;
+      release(tiles_[t]);
+    }
+  }
+
+  if (resident_bytes_ > budget_ && !warned_over_budget_) {
+    logger_->warn("Streaming: {} MB of tiles within the radius or drawn from this observation exceed the budget of {} MB",
+                  resident_bytes_ / (1024 * 1024), budget_ / (1024 * 1024));
+    warned_over_budget_ = true;
+  }
+}
+
+quavis::TileStreamer::TileKey quavis::TileStreamer::get_key(const glm::vec3 &position) const
+{
+  const glm::vec3 c = glm::floor(position / tile_size_);
+  return std::make_tuple(static_cast<int64_t>(c.x), static_cast<int64_t>(c.y), static_cast<int64_t>(c.z));
+}
+
+void quavis::TileStreamer::release(Tile &tile)
+{
+  if (!tile.resident) return;
+
+  for (auto o : tile.objects) {
+    objects_[o]->release_gpu();
+  }
+  resident_bytes_ -= tile.bytes;
+  tile.resident = false;
+}
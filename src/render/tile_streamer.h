@@ -0,0 +1,67 @@
+#ifndef QUAVIS_RENDER_TILE_STREAMER
+#define QUAVIS_RENDER_TILE_STREAMER
+
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "../logger.h"
+#include "./anvil.h"
+#include "./observation.h"
+#include "./scene_object.h"
+
+namespace quavis {
+/// Splits the scene objects into a grid of tiles and keeps only the tiles near the current observation point and the tiles of the drawn objects on
+/// the GPU. When the memory budget is exceeded the least recently used tiles are released first. Streaming never changes what is drawn.
+class TileStreamer : UseLogger {
+ public:
+  /// tiles of size tile_size, tiles closer than radius to the observation point are kept on the GPU, budget in bytes of geometry on the GPU
+  TileStreamer(float tile_size, float radius, VkDeviceSize budget);
+
+  /// assigns the objects to tiles by the center of their bounding sphere, nothing is uploaded yet
+  void set_objects(const std::vector<std::shared_ptr<SceneObject>> &objects);
+
+  /// order of the observations along a morton curve of their tiles, so each tile is loaded as few times as possible
+  std::vector<size_t> order_observations(const std::vector<Observation> &observations) const;
+
+  /// uploads all tiles within the radius of eye and all tiles with an object of draw_mask (nullptr for all objects), then releases old tiles if
+  /// over budget. Tiles of drawn objects beyond the radius are uploaded on demand
+  void make_resident(const glm::vec3 &eye, const std::vector<bool> *draw_mask, std::weak_ptr<Anvil::SGPUDevice> device_ptr);
+
+  /// number of tiles
+  size_t size() const { return tiles_.size(); }
+
+ private:
+  struct Tile {
+    std::vector<size_t> objects;
+    glm::vec3 min;  ///< bounding box of the bounding spheres of the objects
+    glm::vec3 max;
+    bool resident{false};
+    uint64_t last_use{0};
+    VkDeviceSize bytes{0};
+  };
+
+  typedef std::tuple<int64_t, int64_t, int64_t> TileKey;
+
+  TileKey get_key(const glm::vec3 &position) const;
+  void release(Tile &tile);
+
+  float tile_size_;
+  float radius_;
+  VkDeviceSize budget_;
+
+  std::vector<std::shared_ptr<SceneObject>> objects_;
+  std::vector<Tile> tiles_;
+  std::map<TileKey, size_t> tile_index_;
+
+  VkDeviceSize resident_bytes_{0};
+  uint64_t use_counter_{0};
+  bool warned_over_budget_{false};
+  bool warned_beyond_radius_{false};
+};
+}  // namespace quavis
+
+#endif
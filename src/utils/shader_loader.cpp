@@ -4,6 +4,7 @@
 #include <misc/glsl_to_spirv.h>
 
 #include "../render/anvil.h"
+#include "shader_snippets.h"
 
 using namespace std;
 
@@ -17,13 +18,40 @@ std::vector<std::string> Split(const std::string& subject) {
 }
 
 std::shared_ptr<Anvil::ShaderModuleStageEntryPoint> quavis::ShaderLoader::create_shader_entry(std::weak_ptr<Anvil::SGPUDevice> device_ptr,
-                                                                                              const char* source, const Anvil::ShaderStage& stage)
+                                                                                              const char* source, const Anvil::ShaderStage& stage,
+                                                                                              const std::vector<std::string>& defines)
 {
   if (source == nullptr) {
     return make_shared<Anvil::ShaderModuleStageEntryPoint>();
   }
 
-  auto shader = Anvil::GLSLShaderToSPIRVGenerator::create(device_ptr, Anvil::GLSLShaderToSPIRVGenerator::MODE_USE_SPECIFIED_SOURCE, source, stage);
+  // the shared snippets (see get_shader_snippet) replace their include lines
+  std::string full_source(source);
+  const std::string include = "#include \"";
+  for (auto pos = full_source.find(include); pos != std::string::npos; pos = full_source.find(include, pos)) {
+    const auto name_end = full_source.find('"', pos + include.size());
+    if (name_end == std::string::npos) throw std::runtime_error("Shader include without closing quote");
+    const std::string name = full_source.substr(pos + include.size(), name_end - pos - include.size());
+    const char *snippet    = get_shader_snippet(name);
+    if (snippet == nullptr) throw std::runtime_error("Shader includes unknown snippet " + name);
+    full_source.replace(pos, name_end + 1 - pos, snippet);
+  }
+
+  // anvil puts its definitions after the first line, which is empty in our sources, so they are added here
+  if (!defines.empty()) {
+    auto version = full_source.find("#version");
+    if (version == std::string::npos) throw std::runtime_error("Shader without #version");
+    auto line_end = full_source.find('\n', version);
+    if (line_end == std::string::npos) line_end = full_source.size();
+
+    std::string lines;
+    for (const auto &define : defines) {
+      lines += "\n#define " + define;
+    }
+    full_source.insert(line_end, lines);
+  }
+
+  auto shader = Anvil::GLSLShaderToSPIRVGenerator::create(device_ptr, Anvil::GLSLShaderToSPIRVGenerator::MODE_USE_SPECIFIED_SOURCE, full_source, stage);
 
   try {
     shader->bake_spirv_blob();
@@ -35,7 +63,7 @@ std::shared_ptr<Anvil::ShaderModuleStageEntryPoint> quavis::ShaderLoader::create
   }
   catch (std::exception &e) {
     logger_->error("Shader compile Error: {}", e.what());
-    auto splitSource = Split(std::string(source));
+    auto splitSource = Split(full_source);
     auto i = 0;
     for (auto &line : splitSource) {
       logger_->info("{0:>4}: {1}", ++i, line);
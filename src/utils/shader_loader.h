@@ -2,6 +2,8 @@
 #define QUAVIS_UTILS_SHADER_LOADER
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "../render/anvil.h"
 #include "../logger.h"
@@ -10,8 +12,11 @@ namespace quavis {
 /// Used whenever a shader is needed. One place that can maybe used later to more smartly cache compile results or load SPIV instead
 class ShaderLoader: public UseLogger {
  public:
+  /// compiles source, each of defines is added as "#define <name>" right after the #version line and each line #include "<name>" is replaced by
+  /// the snippet get_shader_snippet(name)
   static std::shared_ptr<Anvil::ShaderModuleStageEntryPoint> create_shader_entry(std::weak_ptr<Anvil::SGPUDevice> device_ptr, const char *source,
-                                                                                 const Anvil::ShaderStage &stage);
+                                                                                 const Anvil::ShaderStage &stage,
+                                                                                 const std::vector<std::string> &defines = {});
 };
 }  // namespace quavis
 
@@ -0,0 +1,45 @@
+#include "shader_snippets.h"
+
+namespace {
+/// the texels of the cube faces, see Render::get_shader_defines
+const char *cube_faces = R"(
+#ifdef QUAVIS_FACE_SIZES
+		// resolution of each cube face, faces are rendered into the top left corner of their layer
+		const ivec2 face_size[6] = QUAVIS_FACE_SIZES;
+#endif
+
+		// exact solid angle of the triangle a, a + e1, a + e2 seen from the origin (Van Oosterom and Strackee), the edges are passed directly so that
+		// small texels do not lose precision
+		float triangle_solid_angle(vec3 a, vec3 e1, vec3 e2) {
+			vec3 b = a + e1;
+			vec3 c = a + e2;
+			float la = length(a);
+			float lb = length(b);
+			float lc = length(c);
+			return 2.0f*atan(abs(dot(a, cross(e1, e2))), la*lb*lc + dot(a, b)*lc + dot(a, c)*lb + dot(b, c)*la);
+		}
+
+		// exact solid angle of the texel (i, j) of an n x m cube face
+		float cube_weight(float i, float j, float n, float m) {
+			vec3 a = vec3(2.0f*i/n - 1.0f, 2.0f*j/m - 1.0f, 1.0f);
+			vec3 du = vec3(2.0f/n, 0.0f, 0.0f);
+			vec3 dv = vec3(0.0f, 2.0f/m, 0.0f);
+			return triangle_solid_angle(a, du, du + dv) + triangle_solid_angle(a, du + dv, dv);
+		}
+
+		// direction of the point (v, u) in [-1, 1]^2 of face f, as set up by the face matrices of Render::get_cube_view_projection
+		vec3 face_direction(int f, float v, float u) {
+			if (f == 0) return vec3(1, v, -u);
+			if (f == 1) return vec3(-1, -v, -u);
+			if (f == 2) return vec3(-v, 1, -u);
+			if (f == 3) return vec3(v, -1, -u);
+			return vec3(u, v, 1);
+		}
+)";
+}  // namespace
+
+const char *quavis::get_shader_snippet(const std::string &name)
+{
+  if (name == "cube_faces.glsl") return cube_faces;
+  return nullptr;
+}
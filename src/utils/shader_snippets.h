@@ -0,0 +1,12 @@
+#ifndef QUAVIS_UTILS_SHADER_SNIPPETS
+#define QUAVIS_UTILS_SHADER_SNIPPETS
+
+#include <string>
+
+namespace quavis {
+/// GLSL shared by several shaders. ShaderLoader replaces a line #include "<name>" of a shader by the snippet of that name. Returns nullptr for
+/// unknown names
+const char *get_shader_snippet(const std::string &name);
+}  // namespace quavis
+
+#endif